@@ -0,0 +1,322 @@
+// Microbenchmarks for the native CPU paths that do not need a model:
+// sampling kernels, the fallback tokenizer, pattern responses, basic math,
+// retrieval kernels and capsule JSON parsing. All inputs are synthetic.
+//
+//   micro_bench [--filter SUBSTRING] [--min-time-ms 200] [--out report.json]
+
+#include "microbench.h"
+#include "sampling.h"
+#include "retrieval_kernels.h"
+#include "tokenizer.h"
+#include "text_generator.h"
+#include "capsule_ingest.h"
+#include "json_reader.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<float> random_floats(size_t count, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<float> values(count);
+    for (float& v : values) {
+        v = normal(rng);
+    }
+    return values;
+}
+
+// Words from the fallback vocabulary mixed with unknown ones
+std::string random_text(size_t words, uint32_t seed) {
+    static const char* kWords[] = {
+        "the", "water", "is", "safe", "after", "boiling", "for", "three", "minutes",
+        "emergency", "shelter", "medical", "help", "bandage", "clean", "cloth,", "wound.",
+    };
+    std::mt19937 rng(seed);
+    std::string text;
+    for (size_t i = 0; i < words; ++i) {
+        text += (i ? " " : "") + std::string(kWords[rng() % (sizeof(kWords) / sizeof(kWords[0]))]);
+    }
+    return text;
+}
+
+// Capsule file as the embedding pipeline writes it
+std::string synthetic_capsule_json(size_t sentences, int dim) {
+    std::vector<float> values = random_floats(sentences * dim, 7);
+    std::ostringstream json;
+    json << "{\"embeddings\":[";
+    for (size_t s = 0; s < sentences; ++s) {
+        json << (s ? ",[" : "[");
+        for (int d = 0; d < dim; ++d) {
+            json << (d ? "," : "") << values[s * dim + d];
+        }
+        json << "]";
+    }
+    json << "],\"sentences\":[";
+    for (size_t s = 0; s < sentences; ++s) {
+        json << (s ? ",\"" : "\"") << random_text(12, static_cast<uint32_t>(s)) << "\"";
+    }
+    json << "]}";
+    return json.str();
+}
+
+TextGenerator& pattern_generator() {
+    // No model file: every prompt takes the pattern fallback path
+    static TextGenerator generator;
+    static bool loaded = generator.load_model("");
+    (void)loaded;
+    return generator;
+}
+
+} // namespace
+
+MICROBENCH(sample_argmax, {32000, 151936, 256000}) {
+    std::vector<float> logits = random_floats(state.arg(), 1);
+    while (state.keep_running()) {
+        microbench::do_not_optimize(sampling::argmax(logits.data(), static_cast<int>(logits.size())));
+    }
+    state.set_items_processed(state.iterations() * state.arg());
+    state.set_bytes_processed(state.iterations() * state.arg() * sizeof(float));
+}
+
+MICROBENCH(log_softmax_at, {32000, 151936, 256000}) {
+    std::vector<float> logits = random_floats(state.arg(), 2);
+    while (state.keep_running()) {
+        microbench::do_not_optimize(sampling::log_softmax_at(logits.data(), static_cast<int>(logits.size()), 42));
+    }
+    state.set_items_processed(state.iterations() * state.arg());
+    state.set_bytes_processed(state.iterations() * state.arg() * sizeof(float));
+}
+
+MICROBENCH(tokenizer_encode, {16, 256, 4096}) {
+    Tokenizer tokenizer;
+    tokenizer.load_vocabulary("");
+    const std::string text = random_text(state.arg(), 3);
+    while (state.keep_running()) {
+        std::vector<int> tokens = tokenizer.encode(text);
+        microbench::do_not_optimize(tokens.data());
+    }
+    state.set_bytes_processed(state.iterations() * text.size());
+    state.set_items_processed(state.iterations() * state.arg());
+}
+
+MICROBENCH(tokenizer_decode, {16, 256, 4096}) {
+    Tokenizer tokenizer;
+    tokenizer.load_vocabulary("");
+    const std::vector<int> tokens = tokenizer.encode(random_text(state.arg(), 4));
+    size_t bytes = 0;
+    while (state.keep_running()) {
+        std::string text = tokenizer.decode(tokens);
+        bytes += text.size();
+        microbench::do_not_optimize(text.data());
+    }
+    state.set_bytes_processed(static_cast<int64_t>(bytes));
+    state.set_items_processed(state.iterations() * tokens.size());
+}
+
+MICROBENCH(pattern_response, {32, 512, 4096}) {
+    TextGenerator& generator = pattern_generator();
+    // Filler first so every keyword check scans the whole prompt
+    const std::string prompt = random_text(state.arg() / 6, 5).substr(0, state.arg()) + " how do I find shelter";
+    while (state.keep_running()) {
+        std::string response = generator.generate(prompt, 64);
+        microbench::do_not_optimize(response.data());
+    }
+    state.set_bytes_processed(state.iterations() * prompt.size());
+    state.set_items_processed(state.iterations());
+}
+
+MICROBENCH(basic_math, {}) {
+    TextGenerator& generator = pattern_generator();
+    const std::vector<std::string> prompts = {"1234+5678", "98765-4321", "calculate 17 + 25", "400 - 1",
+                                              "(3 + 4) * 2^10", "what is 15% of 80?", "sqrt(2) / 3",
+                                              "12 times 3 plus 4"};
+    size_t bytes = 0;
+    size_t next = 0;
+    while (state.keep_running()) {
+        const std::string& prompt = prompts[next++ % prompts.size()];
+        std::string response = generator.generate(prompt, 16);
+        bytes += prompt.size();
+        microbench::do_not_optimize(response.data());
+    }
+    state.set_bytes_processed(static_cast<int64_t>(bytes));
+    state.set_items_processed(state.iterations());
+}
+
+MICROBENCH(dot_product, {384, 768}) {
+    const int dim = static_cast<int>(state.arg());
+    std::vector<float> a = random_floats(dim, 6), b = random_floats(dim, 7);
+    while (state.keep_running()) {
+        microbench::do_not_optimize(retrieval::dot_product(a.data(), b.data(), dim));
+    }
+    state.set_items_processed(state.iterations());
+    state.set_bytes_processed(state.iterations() * 2 * dim * sizeof(float));
+}
+
+MICROBENCH(normalize, {384, 768}) {
+    const int dim = static_cast<int>(state.arg());
+    std::vector<float> vec = random_floats(dim, 8);
+    while (state.keep_running()) {
+        retrieval::normalize(vec.data(), dim);
+        microbench::do_not_optimize(vec[0]);
+    }
+    state.set_items_processed(state.iterations());
+    state.set_bytes_processed(state.iterations() * dim * sizeof(float));
+}
+
+MICROBENCH(sign_quantize, {384, 768}) {
+    const int dim = static_cast<int>(state.arg());
+    std::vector<float> vec = random_floats(dim, 9);
+    std::vector<uint64_t> code(retrieval::code_words(dim));
+    while (state.keep_running()) {
+        retrieval::sign_quantize(vec.data(), dim, code.data());
+        microbench::do_not_optimize(code[0]);
+    }
+    state.set_items_processed(state.iterations());
+    state.set_bytes_processed(state.iterations() * dim * sizeof(float));
+}
+
+// Prefilter scan: one query code against a block of passage codes
+MICROBENCH(hamming_scan, {384, 768}) {
+    const int dim = static_cast<int>(state.arg());
+    const int words = retrieval::code_words(dim);
+    const size_t rows = 4096;
+    std::mt19937_64 rng(10);
+    std::vector<uint64_t> codes(rows * words), query(words);
+    for (auto& word : codes) {
+        word = rng();
+    }
+    for (auto& word : query) {
+        word = rng();
+    }
+    while (state.keep_running()) {
+        int total = 0;
+        for (size_t r = 0; r < rows; ++r) {
+            total += retrieval::hamming_distance(query.data(), codes.data() + r * words, words);
+        }
+        microbench::do_not_optimize(total);
+    }
+    state.set_items_processed(state.iterations() * rows);
+    state.set_bytes_processed(state.iterations() * rows * words * sizeof(uint64_t));
+}
+
+MICROBENCH(json_skip_capsule, {100, 1000}) {
+    const std::string json = synthetic_capsule_json(state.arg(), 384);
+    while (state.keep_running()) {
+        JsonReader reader(json.data(), json.size());
+        microbench::do_not_optimize(reader.skip_value());
+    }
+    state.set_bytes_processed(state.iterations() * json.size());
+    state.set_items_processed(state.iterations() * state.arg());
+}
+
+MICROBENCH(capsule_ingest, {100, 1000}) {
+    const std::string json = synthetic_capsule_json(state.arg(), 384);
+    while (state.keep_running()) {
+        IngestedCapsule capsule;
+        CapsuleIngestor ingestor;
+        microbench::do_not_optimize(ingestor.ingest_buffer(json.data(), json.size(), capsule));
+    }
+    state.set_bytes_processed(state.iterations() * json.size());
+    state.set_items_processed(state.iterations() * state.arg());
+}
+
+namespace {
+
+struct Options {
+    std::string filter;
+    double min_time_ms = 200.0;
+    std::string out_path;
+};
+
+bool parse_args(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--min-time-ms") {
+            options.min_time_ms = std::atof(value.c_str());
+        } else if (arg == "--out") {
+            options.out_path = value;
+        } else {
+            return false;
+        }
+    }
+    return options.min_time_ms > 0.0;
+}
+
+// Doubles the iteration count (or more, judging by the last run) until a
+// run lasts min_time_ms
+microbench::State run(const microbench::Benchmark& benchmark, int64_t arg, double min_time_ms) {
+    int64_t iterations = 1;
+    while (true) {
+        microbench::State state(arg, iterations);
+        benchmark.fn(state);
+        const double elapsed_ms = state.elapsed_ns() / 1e6;
+        if (elapsed_ms >= min_time_ms || iterations >= (int64_t(1) << 40)) {
+            return state;
+        }
+        double scale = elapsed_ms > 0.0 ? 1.4 * min_time_ms / elapsed_ms : 100.0;
+        iterations = static_cast<int64_t>(iterations * std::min(100.0, std::max(2.0, scale)));
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_args(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [--filter SUBSTRING] [--min-time-ms MS] [--out FILE]\n", argv[0]);
+        return 1;
+    }
+
+    std::ostringstream json;
+    json << "{\n  \"benchmarks\": [";
+    bool first_report = true;
+
+    std::fprintf(stderr, "%-32s %14s %12s %14s %14s\n", "benchmark", "ns/iter", "iterations", "MB/s", "items/s");
+    for (const auto& benchmark : microbench::registry()) {
+        std::vector<int64_t> args = benchmark.args.empty() ? std::vector<int64_t>{0} : benchmark.args;
+        for (int64_t arg : args) {
+            std::string name = benchmark.name + (benchmark.args.empty() ? "" : "/" + std::to_string(arg));
+            if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+                continue;
+            }
+            microbench::State state = run(benchmark, arg, options.min_time_ms);
+            const double seconds = state.elapsed_ns() / 1e9;
+            const double ns_per_iter = state.elapsed_ns() / state.iterations();
+            const double bytes_per_sec = seconds > 0.0 ? state.bytes_processed() / seconds : 0.0;
+            const double items_per_sec = seconds > 0.0 ? state.items_processed() / seconds : 0.0;
+
+            char line[512];
+            std::snprintf(line, sizeof(line),
+                          "%s\n    {\"name\": \"%s\", \"iterations\": %lld, \"ns_per_iter\": %.2f, "
+                          "\"bytes_per_sec\": %.0f, \"items_per_sec\": %.0f}",
+                          first_report ? "" : ",", name.c_str(), static_cast<long long>(state.iterations()),
+                          ns_per_iter, bytes_per_sec, items_per_sec);
+            json << line;
+            first_report = false;
+            std::fprintf(stderr, "%-32s %14.1f %12lld %14.1f %14.0f\n", name.c_str(), ns_per_iter,
+                         static_cast<long long>(state.iterations()), bytes_per_sec / 1e6, items_per_sec);
+        }
+    }
+
+    json << "\n  ]\n}\n";
+    if (options.out_path.empty()) {
+        std::fputs(json.str().c_str(), stdout);
+    } else {
+        std::ofstream out(options.out_path);
+        out << json.str();
+    }
+    return 0;
+}
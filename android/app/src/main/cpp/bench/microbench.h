@@ -0,0 +1,87 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+// A small Google Benchmark-style harness. Each benchmark loops while
+// state.keep_running() and reports how many bytes or items it processed;
+// the runner grows the iteration count until a run takes min_time_ms.
+//
+//   MICROBENCH(argmax, {1000, 32000}) {
+//       std::vector<float> logits(state.arg());
+//       while (state.keep_running()) { ... }
+//       state.set_items_processed(state.iterations() * state.arg());
+//   }
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace microbench {
+
+class State {
+public:
+    State(int64_t arg, int64_t iterations) : m_arg(arg), m_iterations(iterations) {}
+
+    bool keep_running() {
+        if (m_remaining == m_iterations) {
+            m_start = std::chrono::steady_clock::now();
+        }
+        if (m_remaining-- > 0) {
+            return true;
+        }
+        m_elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - m_start).count();
+        return false;
+    }
+
+    int64_t arg() const { return m_arg; }
+    int64_t iterations() const { return m_iterations; }
+    double elapsed_ns() const { return m_elapsed_ns; }
+
+    void set_bytes_processed(int64_t bytes) { m_bytes = bytes; }
+    void set_items_processed(int64_t items) { m_items = items; }
+    int64_t bytes_processed() const { return m_bytes; }
+    int64_t items_processed() const { return m_items; }
+
+private:
+    int64_t m_arg;
+    int64_t m_iterations;
+    int64_t m_remaining = m_iterations;
+    int64_t m_bytes = 0;
+    int64_t m_items = 0;
+    double m_elapsed_ns = 0.0;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Defeats dead-code elimination of a computed value
+template <typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Benchmark {
+    std::string name;
+    std::vector<int64_t> args; // one run per argument; empty runs once with 0
+    std::function<void(State&)> fn;
+};
+
+inline std::vector<Benchmark>& registry() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+struct Registrar {
+    Registrar(const char* name, std::vector<int64_t> args, void (*fn)(State&)) {
+        registry().push_back({name, std::move(args), fn});
+    }
+};
+
+} // namespace microbench
+
+#define MICROBENCH(name, ...)                                                              \
+    static void microbench_##name(microbench::State& state);                               \
+    static microbench::Registrar microbench_registrar_##name(#name, __VA_ARGS__,           \
+                                                             microbench_##name);           \
+    static void microbench_##name(microbench::State& state)
+
+#endif // MICROBENCH_H
@@ -0,0 +1,620 @@
+// Host benchmark for the generation path the app uses: load time, time to
+// first token, prefill and decode throughput and peak RSS for a fixed prompt
+// suite, across thread counts and context sizes.
+//
+//   naseer_bench --model model.gguf [--threads 2,4] [--ctx 1024,2048]
+//                [--max-tokens 64] [--capsules DIR] [--perf-counters 1]
+//                [--op-profile 1] [--out report.json]
+//   naseer_bench --model model.gguf --soak-minutes 10 [--sample-seconds 10]
+//                [--cooldown-seconds 120] [--threads 2,4,6]
+//
+// Every configuration loads the model afresh into a new TextGenerator. Peak
+// RSS is the process high-water mark, so it never decreases across
+// configurations; run one configuration per process to compare it.
+//
+// Without a downloaded model, `tiny_gguf --out tiny.gguf` writes a small
+// random model that runs the whole suite in seconds. Its output is noise,
+// but the loader, KV reuse and batching paths are the real ones.
+//
+// --op-profile needs a Debug build configured with
+// -DNASEER_OP_PROFILER=ON. It adds per-op and per-layer time to each
+// report and prints the tables; throughput in that mode is not comparable.
+//
+// Soak mode replaces the scenarios with back-to-back generation for the
+// given time. Each sample window records decode throughput together with
+// /sys/class/thermal zone temperatures and CPU frequencies. The report gives
+// burst throughput (best of the first windows), steady-state throughput
+// (median of the last third), and throttling onset: the first window after
+// which throughput stays below 90% of burst. Phones reach steady state
+// after a few minutes, so soak for at least five. Use --cooldown-seconds
+// between configurations so each thread count starts from a cool device.
+
+#include "text_generator.h"
+#include "capsule_ingest.h"
+#include "memory_stats.h"
+#include "perf_counters.h"
+#include "op_profiler.h"
+#include "thermal_probe.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Kept in line with the prompt ChatService builds
+const char* kSystemPrompt =
+    "You are NaseerAI, an expert offline medical and emergency assistant.\n\n"
+    "CRITICAL INSTRUCTIONS:\n"
+    "1. Always give direct, practical answers\n"
+    "2. Use numbered steps for clarity\n"
+    "3. Be specific and actionable\n"
+    "4. Stay focused on the question asked\n"
+    "5. Never mention internet or online resources";
+
+const std::vector<std::string> kSingleShot = {
+    "How do I purify water without electricity?",
+    "What should I do for a deep cut on the arm?",
+    "How can I signal for help if the phone network is down?",
+};
+
+const std::vector<std::string> kChatTurns = {
+    "Someone has a burn on their hand from boiling water.",
+    "The skin is blistering. Should I pop the blisters?",
+    "How often should I change the dressing?",
+};
+
+const std::vector<std::string> kRagQuestions = {
+    "How should I treat a burn?",
+    "How do I clean a scrape?",
+};
+
+struct Options {
+    std::string model_path;
+    std::vector<int> threads = {4};
+    std::vector<int> contexts = {2048};
+    int max_tokens = 64;
+    std::string capsules_dir = "sample_capsules";
+    bool perf_counters = false;
+    bool op_profile = false;
+    double soak_minutes = 0.0;
+    int sample_seconds = 10;
+    int cooldown_seconds = 0;
+    std::string out_path;
+};
+
+struct ScenarioStats {
+    int requests = 0;
+    int prompt_tokens = 0;
+    int prefill_tokens = 0;
+    int reused_tokens = 0;
+    int generated_tokens = 0;
+    double prefill_ms = 0.0;
+    double decode_ms = 0.0;
+    std::vector<double> ttft_ms;
+    // Decode-phase hardware counters, summed where recorded
+    int64_t decode_cycles = 0;
+    int64_t decode_instructions = 0;
+    int64_t decode_llc_loads = 0;
+    int64_t decode_cache_misses = 0;
+
+    void add(const RequestMetrics& m) {
+        requests++;
+        prompt_tokens += m.prompt_tokens;
+        prefill_tokens += m.prefill_tokens;
+        reused_tokens += m.reused_tokens;
+        generated_tokens += m.generated_tokens;
+        prefill_ms += m.prefill_ms;
+        decode_ms += m.decode_ms;
+        ttft_ms.push_back(m.ttft_ms);
+        decode_cycles += std::max<int64_t>(0, m.decode_counters.cycles);
+        decode_instructions += std::max<int64_t>(0, m.decode_counters.instructions);
+        decode_llc_loads += std::max<int64_t>(0, m.decode_counters.llc_loads);
+        decode_cache_misses += std::max<int64_t>(0, m.decode_counters.cache_misses);
+    }
+
+    double decode_ipc() const {
+        return decode_cycles > 0 ? static_cast<double>(decode_instructions) / decode_cycles : 0.0;
+    }
+    double per_generated_token(int64_t count) const {
+        return generated_tokens > 0 ? static_cast<double>(count) / generated_tokens : 0.0;
+    }
+
+    double prefill_tokens_per_sec() const {
+        return prefill_ms > 0.0 ? prefill_tokens * 1000.0 / prefill_ms : 0.0;
+    }
+    double decode_tokens_per_sec() const {
+        return decode_ms > 0.0 ? generated_tokens * 1000.0 / decode_ms : 0.0;
+    }
+};
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+}
+
+std::string user_turn(const std::string& message) {
+    return "User: " + message + "\n\nNaseerAI: ";
+}
+
+// Runs one prompt and folds the request's metrics into stats
+std::string run_prompt(TextGenerator& generator, const std::string& prompt, int max_tokens, ScenarioStats& stats) {
+    std::string response = generator.generate(prompt, max_tokens);
+    std::vector<RequestMetrics> last = generator.metrics().last(1);
+    if (!last.empty()) {
+        stats.add(last.front());
+    }
+    return response;
+}
+
+ScenarioStats run_single_shot(TextGenerator& generator, const Options& options) {
+    ScenarioStats stats;
+    for (const auto& question : kSingleShot) {
+        run_prompt(generator, std::string(kSystemPrompt) + "\n\n" + user_turn(question), options.max_tokens, stats);
+    }
+    return stats;
+}
+
+// Each turn extends the previous prompt, so the shared prefix is served
+// from the KV cache as it is in the app
+ScenarioStats run_multi_turn(TextGenerator& generator, const Options& options) {
+    ScenarioStats stats;
+    std::string history;
+    for (const auto& message : kChatTurns) {
+        std::string response = run_prompt(generator, std::string(kSystemPrompt) + "\n\n" + history + user_turn(message),
+                                           options.max_tokens, stats);
+        history += "User: " + message + "\nNaseerAI: " + response + "\n\n";
+    }
+    return stats;
+}
+
+ScenarioStats run_rag(TextGenerator& generator, const Options& options, const std::vector<std::string>& passages) {
+    ScenarioStats stats;
+    if (passages.empty()) {
+        return stats;
+    }
+    std::vector<PackCandidate> candidates(passages.size());
+    for (size_t i = 0; i < passages.size(); ++i) {
+        candidates[i].text = passages[i];
+        candidates[i].score = static_cast<float>(passages.size() - i);
+    }
+    for (const auto& question : kRagQuestions) {
+        const std::string system = std::string(kSystemPrompt) + "\n\n";
+        const std::string turn = user_turn(question);
+        PackedContext packed;
+        std::string prompt = system;
+        if (generator.pack_context(system, "", turn, candidates, options.max_tokens, DedupPolicy::Near, packed) &&
+            !packed.text.empty()) {
+            prompt += "CONTEXT: " + packed.text + "\n\n";
+        }
+        run_prompt(generator, prompt + turn, options.max_tokens, stats);
+    }
+    return stats;
+}
+
+std::vector<std::string> load_passages(const Options& options) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> passages;
+    std::error_code error;
+    if (!fs::is_directory(options.capsules_dir, error)) {
+        return passages;
+    }
+    for (const auto& entry : fs::directory_iterator(options.capsules_dir)) {
+        if (entry.path().extension() != ".json") {
+            continue;
+        }
+        IngestedCapsule capsule;
+        CapsuleIngestor ingestor;
+        if (ingestor.ingest_file(entry.path().string(), capsule)) {
+            passages.insert(passages.end(), capsule.passages.begin(), capsule.passages.end());
+        }
+    }
+    return passages;
+}
+
+void report_scenario(const char* name, const ScenarioStats& stats, int threads, int n_ctx,
+                     double load_ms, std::ostringstream& json, bool& first_report) {
+    if (stats.requests == 0) {
+        return;
+    }
+    const uint64_t peak_rss = memory_probe::peak_resident_bytes();
+    char line[1024];
+    std::snprintf(line, sizeof(line),
+                  "%s\n    {\"scenario\": \"%s\", \"threads\": %d, \"n_ctx\": %d, \"load_ms\": %.1f, "
+                  "\"requests\": %d, \"prompt_tokens\": %d, \"reused_tokens\": %d, \"prefill_tokens\": %d, "
+                  "\"generated_tokens\": %d, \"ttft_p50_ms\": %.2f, \"ttft_max_ms\": %.2f, "
+                  "\"prefill_tokens_per_sec\": %.2f, \"decode_tokens_per_sec\": %.2f, \"peak_rss_bytes\": %llu, "
+                  "\"decode_ipc\": %.3f, \"decode_llc_loads_per_token\": %.0f, \"decode_cache_misses_per_token\": %.0f",
+                  first_report ? "" : ",", name, threads, n_ctx, load_ms, stats.requests, stats.prompt_tokens,
+                  stats.reused_tokens, stats.prefill_tokens, stats.generated_tokens,
+                  percentile(stats.ttft_ms, 0.50), percentile(stats.ttft_ms, 1.0),
+                  stats.prefill_tokens_per_sec(), stats.decode_tokens_per_sec(),
+                  static_cast<unsigned long long>(peak_rss), stats.decode_ipc(),
+                  stats.per_generated_token(stats.decode_llc_loads),
+                  stats.per_generated_token(stats.decode_cache_misses));
+    json << line;
+#if NASEER_OP_PROFILER
+    if (OpProfiler::enabled()) {
+        json << ", \"op_profile\": " << OpProfiler::json();
+    }
+#endif
+    json << "}";
+    first_report = false;
+    std::fprintf(stderr, "t=%-2d ctx=%-5d %-12s ttft p50=%8.1fms prefill=%8.1f tok/s decode=%6.2f tok/s rss peak=%lluMB\n",
+                 threads, n_ctx, name, percentile(stats.ttft_ms, 0.50), stats.prefill_tokens_per_sec(),
+                 stats.decode_tokens_per_sec(), static_cast<unsigned long long>(peak_rss >> 20));
+#if NASEER_OP_PROFILER
+    if (OpProfiler::enabled()) {
+        std::fputs(OpProfiler::table().c_str(), stderr);
+    }
+    // The next scenario starts from empty totals
+    OpProfiler::reset();
+#endif
+}
+
+// Throughput below this share of burst counts as throttled
+constexpr double kThrottleRatio = 0.9;
+
+struct SoakSample {
+    double t_s = 0.0;             // end of the window since soak start
+    int generated_tokens = 0;
+    double tokens_per_sec = 0.0;  // wall clock, prefill included
+    double decode_tokens_per_sec = 0.0;
+    std::vector<double> temps_c;  // per thermal zone
+    std::vector<double> cpu_mhz;  // per CPU
+};
+
+struct SoakSummary {
+    double burst_tokens_per_sec = 0.0;
+    double steady_tokens_per_sec = 0.0;
+    double throttle_onset_s = -1.0; // -1 when throughput never dropped
+    double peak_temp_c = std::nan("");
+};
+
+std::vector<SoakSample> run_soak(TextGenerator& generator, const Options& options,
+                                 const std::vector<thermal_probe::Zone>& zones,
+                                 const std::vector<thermal_probe::Cpu>& cpus) {
+    std::vector<SoakSample> samples;
+    const double soak_ms = options.soak_minutes * 60000.0;
+    const double window_ms = options.sample_seconds * 1000.0;
+    const auto soak_start = Clock::now();
+    auto window_start = soak_start;
+    ScenarioStats window;
+    size_t next_prompt = 0;
+
+    while (elapsed_ms(soak_start) < soak_ms) {
+        const std::string& question = kSingleShot[next_prompt++ % kSingleShot.size()];
+        run_prompt(generator, std::string(kSystemPrompt) + "\n\n" + user_turn(question), options.max_tokens, window);
+
+        const double window_elapsed_ms = elapsed_ms(window_start);
+        if (window_elapsed_ms < window_ms && elapsed_ms(soak_start) < soak_ms) {
+            continue;
+        }
+        SoakSample sample;
+        sample.t_s = elapsed_ms(soak_start) / 1000.0;
+        sample.generated_tokens = window.generated_tokens;
+        sample.tokens_per_sec = window.generated_tokens * 1000.0 / window_elapsed_ms;
+        sample.decode_tokens_per_sec = window.decode_tokens_per_sec();
+        for (const auto& zone : zones) {
+            sample.temps_c.push_back(thermal_probe::temperature_c(zone));
+        }
+        for (const auto& cpu : cpus) {
+            sample.cpu_mhz.push_back(thermal_probe::frequency_mhz(cpu));
+        }
+        samples.push_back(std::move(sample));
+        window = ScenarioStats();
+        window_start = Clock::now();
+    }
+    return samples;
+}
+
+SoakSummary summarize_soak(const std::vector<SoakSample>& samples) {
+    SoakSummary summary;
+    if (samples.empty()) {
+        return summary;
+    }
+    const size_t burst_windows = std::min<size_t>(3, samples.size());
+    for (size_t i = 0; i < burst_windows; ++i) {
+        summary.burst_tokens_per_sec = std::max(summary.burst_tokens_per_sec, samples[i].decode_tokens_per_sec);
+    }
+
+    std::vector<double> tail;
+    for (size_t i = samples.size() - std::max<size_t>(1, samples.size() / 3); i < samples.size(); ++i) {
+        tail.push_back(samples[i].decode_tokens_per_sec);
+    }
+    summary.steady_tokens_per_sec = percentile(tail, 0.5);
+
+    // Walk back from the end to the last window that still ran at burst speed
+    const double threshold = kThrottleRatio * summary.burst_tokens_per_sec;
+    for (size_t i = samples.size(); i-- > 0;) {
+        if (samples[i].decode_tokens_per_sec >= threshold) {
+            if (i + 1 < samples.size()) {
+                summary.throttle_onset_s = samples[i].t_s;
+            }
+            break;
+        }
+    }
+
+    for (const auto& sample : samples) {
+        for (double temp : sample.temps_c) {
+            if (!std::isnan(temp) && (std::isnan(summary.peak_temp_c) || temp > summary.peak_temp_c)) {
+                summary.peak_temp_c = temp;
+            }
+        }
+    }
+    return summary;
+}
+
+// Quoted JSON string, escaped the same way as NativeLog's JSON sink
+void append_string(std::ostringstream& json, const std::string& text) {
+    json << '"';
+    for (char c : text) {
+        unsigned char ch = static_cast<unsigned char>(c);
+        if (ch == '"' || ch == '\\') {
+            json << '\\' << c;
+        } else if (ch == '\n') {
+            json << "\\n";
+        } else if (ch == '\t') {
+            json << "\\t";
+        } else if (ch < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+            json << escaped;
+        } else {
+            json << c;
+        }
+    }
+    json << '"';
+}
+
+void append_numbers(std::ostringstream& json, const std::vector<double>& values, const char* format) {
+    char number[32];
+    json << "[";
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (std::isnan(values[i])) {
+            std::snprintf(number, sizeof(number), "null");
+        } else {
+            std::snprintf(number, sizeof(number), format, values[i]);
+        }
+        json << (i ? ", " : "") << number;
+    }
+    json << "]";
+}
+
+void report_soak(const std::vector<SoakSample>& samples, const std::vector<thermal_probe::Zone>& zones,
+                 const std::vector<thermal_probe::Cpu>& cpus, int threads, int n_ctx, double load_ms,
+                 std::ostringstream& json, bool& first_report) {
+    const SoakSummary summary = summarize_soak(samples);
+    char line[1024];
+    std::snprintf(line, sizeof(line),
+                  "%s\n    {\"scenario\": \"soak\", \"threads\": %d, \"n_ctx\": %d, \"load_ms\": %.1f, "
+                  "\"duration_s\": %.1f, \"burst_tokens_per_sec\": %.2f, \"steady_tokens_per_sec\": %.2f, "
+                  "\"sustained_ratio\": %.3f, \"throttle_onset_s\": ",
+                  first_report ? "" : ",", threads, n_ctx, load_ms, samples.empty() ? 0.0 : samples.back().t_s,
+                  summary.burst_tokens_per_sec, summary.steady_tokens_per_sec,
+                  summary.burst_tokens_per_sec > 0.0 ? summary.steady_tokens_per_sec / summary.burst_tokens_per_sec : 0.0);
+    json << line;
+    if (summary.throttle_onset_s >= 0.0) {
+        std::snprintf(line, sizeof(line), "%.1f", summary.throttle_onset_s);
+        json << line;
+    } else {
+        json << "null";
+    }
+    json << ", \"peak_temp_c\": ";
+    append_numbers(json, {summary.peak_temp_c}, "%.1f");
+
+    json << ",\n     \"thermal_zones\": [";
+    for (size_t i = 0; i < zones.size(); ++i) {
+        json << (i ? ", " : "");
+        append_string(json, zones[i].type);
+    }
+    std::vector<double> max_mhz;
+    for (const auto& cpu : cpus) {
+        max_mhz.push_back(cpu.max_mhz > 0.0 ? cpu.max_mhz : std::nan(""));
+    }
+    json << "], \"cpu_max_mhz\": ";
+    append_numbers(json, max_mhz, "%.0f");
+    json << ",\n     \"samples\": [";
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const SoakSample& sample = samples[i];
+        std::snprintf(line, sizeof(line),
+                      "%s\n       {\"t_s\": %.1f, \"generated_tokens\": %d, \"tokens_per_sec\": %.2f, "
+                      "\"decode_tokens_per_sec\": %.2f, \"temps_c\": ",
+                      i ? "," : "", sample.t_s, sample.generated_tokens, sample.tokens_per_sec,
+                      sample.decode_tokens_per_sec);
+        json << line;
+        append_numbers(json, sample.temps_c, "%.1f");
+        json << ", \"cpu_mhz\": ";
+        append_numbers(json, sample.cpu_mhz, "%.0f");
+        json << "}";
+    }
+    json << "]}";
+    first_report = false;
+
+    for (const auto& sample : samples) {
+        double max_temp = std::nan("");
+        for (double temp : sample.temps_c) {
+            if (!std::isnan(temp) && (std::isnan(max_temp) || temp > max_temp)) {
+                max_temp = temp;
+            }
+        }
+        double mhz_sum = 0.0;
+        int mhz_count = 0;
+        for (double mhz : sample.cpu_mhz) {
+            if (!std::isnan(mhz)) {
+                mhz_sum += mhz;
+                mhz_count++;
+            }
+        }
+        std::fprintf(stderr, "t=%-2d ctx=%-5d soak %6.0fs decode=%6.2f tok/s max temp=%5.1fC cpu avg=%5.0fMHz\n",
+                     threads, n_ctx, sample.t_s, sample.decode_tokens_per_sec, max_temp,
+                     mhz_count ? mhz_sum / mhz_count : 0.0);
+    }
+    std::fprintf(stderr, "t=%-2d ctx=%-5d soak burst=%.2f tok/s steady=%.2f tok/s (%.0f%%), throttling ",
+                 threads, n_ctx, summary.burst_tokens_per_sec, summary.steady_tokens_per_sec,
+                 summary.burst_tokens_per_sec > 0.0 ? 100.0 * summary.steady_tokens_per_sec / summary.burst_tokens_per_sec : 0.0);
+    if (summary.throttle_onset_s >= 0.0) {
+        std::fprintf(stderr, "from %.0fs\n", summary.throttle_onset_s);
+    } else {
+        std::fprintf(stderr, "not observed\n");
+    }
+}
+
+std::vector<int> parse_list(const std::string& value) {
+    std::vector<int> items;
+    std::stringstream list(value);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        int parsed = std::atoi(item.c_str());
+        if (parsed > 0) {
+            items.push_back(parsed);
+        }
+    }
+    return items;
+}
+
+bool parse_args(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--model") {
+            options.model_path = value;
+        } else if (arg == "--threads") {
+            options.threads = parse_list(value);
+        } else if (arg == "--ctx") {
+            options.contexts = parse_list(value);
+        } else if (arg == "--max-tokens") {
+            options.max_tokens = std::atoi(value.c_str());
+        } else if (arg == "--perf-counters") {
+            options.perf_counters = std::atoi(value.c_str()) != 0;
+        } else if (arg == "--op-profile") {
+            options.op_profile = std::atoi(value.c_str()) != 0;
+        } else if (arg == "--soak-minutes") {
+            options.soak_minutes = std::atof(value.c_str());
+        } else if (arg == "--sample-seconds") {
+            options.sample_seconds = std::atoi(value.c_str());
+        } else if (arg == "--cooldown-seconds") {
+            options.cooldown_seconds = std::atoi(value.c_str());
+        } else if (arg == "--capsules") {
+            options.capsules_dir = value;
+        } else if (arg == "--out") {
+            options.out_path = value;
+        } else {
+            return false;
+        }
+    }
+    return !options.model_path.empty() && !options.threads.empty() && !options.contexts.empty() &&
+           options.max_tokens > 0 && options.sample_seconds > 0 && options.cooldown_seconds >= 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_args(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s --model FILE.gguf [--threads N,N,...] [--ctx N,N,...] "
+                             "[--max-tokens N] [--capsules DIR] [--perf-counters 0|1] [--op-profile 0|1] "
+                             "[--soak-minutes M] [--sample-seconds N] [--cooldown-seconds N] [--out FILE]\n", argv[0]);
+        return 1;
+    }
+
+    if (options.perf_counters) {
+        PerfCounters::set_enabled(true);
+        if (!PerfCounters::enabled()) {
+            std::fprintf(stderr, "perf_event_open is not permitted, counters are reported as 0\n");
+        }
+    }
+
+    if (options.op_profile) {
+#if NASEER_OP_PROFILER
+        OpProfiler::set_enabled(true);
+#else
+        std::fprintf(stderr, "--op-profile needs a Debug build with -DNASEER_OP_PROFILER=ON\n");
+        return 1;
+#endif
+    }
+
+    const std::vector<std::string> passages = load_passages(options);
+    if (passages.empty()) {
+        std::fprintf(stderr, "no capsules found in %s, skipping the RAG scenario\n", options.capsules_dir.c_str());
+    }
+
+    const std::vector<thermal_probe::Zone> zones = thermal_probe::zones();
+    const std::vector<thermal_probe::Cpu> cpus = thermal_probe::cpus();
+    if (options.soak_minutes > 0.0 && zones.empty()) {
+        std::fprintf(stderr, "no readable thermal zones, soak reports throughput only\n");
+    }
+
+    std::ostringstream json;
+    json << "{\n  \"model\": ";
+    append_string(json, options.model_path);
+    json << ",\n  \"reports\": [";
+    bool first_report = true;
+    bool first_config = true;
+
+    for (int n_ctx : options.contexts) {
+        for (int threads : options.threads) {
+            if (!first_config && options.cooldown_seconds > 0) {
+                std::fprintf(stderr, "cooling down for %ds\n", options.cooldown_seconds);
+                std::this_thread::sleep_for(std::chrono::seconds(options.cooldown_seconds));
+            }
+            first_config = false;
+
+            TextGenerator generator;
+            generator.set_context_size(n_ctx);
+            generator.set_threads(threads);
+
+            auto load_start = Clock::now();
+            generator.load_model(options.model_path);
+            double load_ms = elapsed_ms(load_start);
+            if (!generator.has_llama_model()) {
+                std::fprintf(stderr, "failed to load %s\n", options.model_path.c_str());
+                return 1;
+            }
+#if NASEER_OP_PROFILER
+            OpProfiler::reset();
+#endif
+
+            if (options.soak_minutes > 0.0) {
+                report_soak(run_soak(generator, options, zones, cpus), zones, cpus, threads, n_ctx, load_ms,
+                            json, first_report);
+                continue;
+            }
+            report_scenario("single_shot", run_single_shot(generator, options), threads, n_ctx, load_ms,
+                            json, first_report);
+            report_scenario("multi_turn", run_multi_turn(generator, options), threads, n_ctx, load_ms,
+                            json, first_report);
+            report_scenario("rag", run_rag(generator, options, passages), threads, n_ctx, load_ms,
+                            json, first_report);
+        }
+    }
+
+    json << "\n  ]\n}\n";
+    if (options.out_path.empty()) {
+        std::fputs(json.str().c_str(), stdout);
+    } else {
+        std::ofstream out(options.out_path);
+        out << json.str();
+    }
+    return 0;
+}
@@ -0,0 +1,319 @@
+// Host benchmark for the capsule index: recall@k against the exact float
+// scan, latency percentiles, build time and memory for each configuration.
+//
+//   retrieval_bench [--capsules DIR] [--sizes 10000,100000] [--dim 384]
+//                   [--queries 200] [--k 5] [--out report.json]
+
+#include "capsule_index.h"
+#include "capsule_ingest.h"
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+struct Corpus {
+    std::string name;
+    int dim = 0;
+    size_t passages = 0;
+    std::vector<std::string> query_texts;
+    std::vector<float> query_vectors;
+};
+
+struct Config {
+    std::string name;
+    size_t prefilter_min_passages;
+    size_t prefilter_candidates;
+};
+
+struct Options {
+    std::string capsules_dir = "sample_capsules";
+    std::vector<size_t> sizes = {10000, 100000};
+    int dim = 384;
+    int queries = 200;
+    int k = 5;
+    std::string out_path;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Resident set size in bytes, from /proc on Linux hosts
+size_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) {
+        return 0;
+    }
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+}
+
+// Queries are perturbed copies of indexed passages, with a couple of their
+// words as query text, so both the semantic and keyword paths are exercised
+void add_query(Corpus& corpus, std::mt19937& rng, const std::string& text, const float* vector) {
+    std::normal_distribution<float> noise(0.0f, 0.3f);
+    for (int d = 0; d < corpus.dim; ++d) {
+        corpus.query_vectors.push_back(vector[d] + noise(rng) / std::sqrt(static_cast<float>(corpus.dim)));
+    }
+    std::vector<std::string> words = CapsuleIndex::extract_keywords(text);
+    std::string query;
+    for (size_t i = 0; i < words.size() && i < 2; ++i) {
+        query += (i ? " " : "") + words[rng() % words.size()];
+    }
+    corpus.query_texts.push_back(query);
+}
+
+bool load_sample_capsules(const Options& options, CapsuleIndex& index, Corpus& corpus, std::mt19937& rng) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    if (!fs::is_directory(options.capsules_dir, error)) {
+        return false;
+    }
+
+    std::vector<IngestedCapsule> capsules;
+    for (const auto& entry : fs::directory_iterator(options.capsules_dir)) {
+        if (entry.path().extension() != ".json") {
+            continue;
+        }
+        IngestedCapsule capsule;
+        CapsuleIngestor ingestor;
+        if (!ingestor.ingest_file(entry.path().string(), capsule) || capsule.passages.empty()) {
+            continue;
+        }
+        if (corpus.dim == 0) {
+            corpus.dim = capsule.dim;
+        }
+        if (capsule.dim != corpus.dim) {
+            continue;
+        }
+        index.add_capsule(entry.path().stem().string(), capsule.passages, capsule.sentence_indices,
+                          capsule.embeddings, capsule.dim, &capsule.source_refs);
+        corpus.passages += capsule.passages.size();
+        capsules.push_back(std::move(capsule));
+    }
+    if (capsules.empty()) {
+        return false;
+    }
+
+    for (int q = 0; q < 50; ++q) {
+        const IngestedCapsule& capsule = capsules[rng() % capsules.size()];
+        size_t row = rng() % capsule.passages.size();
+        add_query(corpus, rng, capsule.passages[row], capsule.embeddings.data() + row * capsule.dim);
+    }
+    return true;
+}
+
+// Clustered vectors: real embedding collections are far from uniform, and
+// uniform data would make every prefilter look equally bad
+// Returns the time spent inside add_capsule, excluding data generation
+double build_synthetic(const Options& options, size_t size, CapsuleIndex& index, Corpus& corpus, std::mt19937& rng) {
+    const int dim = options.dim;
+    const size_t clusters = 256;
+    const size_t chunk = 10000; // one capsule per chunk, as installs would arrive
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::uniform_int_distribution<int> vocabulary(0, 4999);
+
+    std::vector<float> centroids(clusters * dim);
+    for (float& v : centroids) {
+        v = normal(rng);
+    }
+
+    corpus.dim = dim;
+    double build_ms = 0.0;
+    for (size_t start = 0; start < size; start += chunk) {
+        size_t rows = std::min(chunk, size - start);
+        std::vector<std::string> texts(rows);
+        std::vector<int> indices(rows);
+        std::vector<float> vectors(rows * dim);
+        for (size_t r = 0; r < rows; ++r) {
+            const float* centroid = centroids.data() + (rng() % clusters) * dim;
+            for (int d = 0; d < dim; ++d) {
+                vectors[r * dim + d] = centroid[d] + 0.6f * normal(rng);
+            }
+            for (int w = 0; w < 8; ++w) {
+                texts[r] += (w ? " word" : "word") + std::to_string(vocabulary(rng));
+            }
+            indices[r] = static_cast<int>(r);
+        }
+        auto add_start = Clock::now();
+        index.add_capsule("synthetic_" + std::to_string(start / chunk), texts, indices, vectors, dim);
+        build_ms += elapsed_ms(add_start);
+
+        // Draw queries proportionally from every chunk
+        int chunk_queries = static_cast<int>((options.queries * rows + size - 1) / size);
+        for (int q = 0; q < chunk_queries && static_cast<int>(corpus.query_texts.size()) < options.queries; ++q) {
+            size_t row = rng() % rows;
+            add_query(corpus, rng, texts[row], vectors.data() + row * dim);
+        }
+    }
+    corpus.passages = size;
+    return build_ms;
+}
+
+void run_corpus(const Options& options, const Corpus& corpus, CapsuleIndex& index,
+                double build_ms, size_t build_bytes, std::ostringstream& json, bool& first_report) {
+    // Exact float scan is the ground truth; int8 and HNSW configurations do
+    // not exist in this index and are not reported
+    const std::vector<Config> configs = {
+        {"brute_force_float", std::numeric_limits<size_t>::max(), 1},
+        {"binary_prefilter_256", 0, 256},
+        {"binary_prefilter_512", 0, 512},
+        {"binary_prefilter_2048", 0, 2048},
+    };
+
+    index.set_query_cache_capacity(0);
+    index.set_diversity(1.0f);
+
+    const size_t query_count = corpus.query_texts.size();
+    std::vector<std::vector<uint32_t>> truth(query_count);
+
+    for (const auto& config : configs) {
+        index.set_prefilter(config.prefilter_min_passages, config.prefilter_candidates);
+        std::vector<double> latencies;
+        latencies.reserve(query_count);
+        double recall_sum = 0.0;
+
+        for (size_t q = 0; q < query_count; ++q) {
+            const float* vector = corpus.query_vectors.data() + q * corpus.dim;
+            auto start = Clock::now();
+            std::vector<SearchHit> hits = index.search(corpus.query_texts[q], vector, corpus.dim, options.k);
+            latencies.push_back(elapsed_ms(start));
+
+            std::vector<uint32_t> ids;
+            for (const auto& hit : hits) {
+                ids.push_back(hit.passage_id);
+            }
+            if (&config == &configs.front()) {
+                truth[q] = ids;
+            }
+            if (truth[q].empty()) {
+                recall_sum += 1.0;
+                continue;
+            }
+            std::unordered_set<uint32_t> expected(truth[q].begin(), truth[q].end());
+            size_t found = 0;
+            for (uint32_t id : ids) {
+                found += expected.count(id);
+            }
+            recall_sum += static_cast<double>(found) / expected.size();
+        }
+
+        char line[512];
+        std::snprintf(line, sizeof(line),
+                      "%s\n    {\"corpus\": \"%s\", \"passages\": %zu, \"dim\": %d, \"config\": \"%s\", "
+                      "\"queries\": %zu, \"k\": %d, \"recall_at_k\": %.4f, \"p50_ms\": %.4f, \"p99_ms\": %.4f, "
+                      "\"build_ms\": %.1f, \"memory_bytes\": %zu}",
+                      first_report ? "" : ",", corpus.name.c_str(), corpus.passages, corpus.dim,
+                      config.name.c_str(), query_count, options.k,
+                      query_count ? recall_sum / query_count : 0.0,
+                      percentile(latencies, 0.50), percentile(latencies, 0.99), build_ms, build_bytes);
+        json << line;
+        first_report = false;
+        std::fprintf(stderr, "%-24s %-22s recall@%d=%.3f p50=%.3fms p99=%.3fms\n", corpus.name.c_str(),
+                     config.name.c_str(), options.k, query_count ? recall_sum / query_count : 0.0,
+                     percentile(latencies, 0.50), percentile(latencies, 0.99));
+    }
+}
+
+bool parse_args(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--capsules") {
+            options.capsules_dir = value;
+        } else if (arg == "--sizes") {
+            options.sizes.clear();
+            std::stringstream list(value);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                options.sizes.push_back(std::strtoull(item.c_str(), nullptr, 10));
+            }
+        } else if (arg == "--dim") {
+            options.dim = std::atoi(value.c_str());
+        } else if (arg == "--queries") {
+            options.queries = std::atoi(value.c_str());
+        } else if (arg == "--k") {
+            options.k = std::atoi(value.c_str());
+        } else if (arg == "--out") {
+            options.out_path = value;
+        } else {
+            return false;
+        }
+    }
+    return options.dim > 0 && options.queries > 0 && options.k > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_args(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [--capsules DIR] [--sizes N,N,...] [--dim D] "
+                             "[--queries Q] [--k K] [--out FILE]\n", argv[0]);
+        return 1;
+    }
+
+    std::mt19937 rng(42);
+    std::ostringstream json;
+    json << "{\n  \"reports\": [";
+    bool first_report = true;
+
+    {
+        CapsuleIndex index;
+        Corpus corpus;
+        corpus.name = "sample_capsules";
+        size_t rss_before = resident_bytes();
+        auto start = Clock::now();
+        if (load_sample_capsules(options, index, corpus, rng)) {
+            double build_ms = elapsed_ms(start);
+            run_corpus(options, corpus, index, build_ms, resident_bytes() - rss_before, json, first_report);
+        } else {
+            std::fprintf(stderr, "no capsules found in %s, skipping\n", options.capsules_dir.c_str());
+        }
+    }
+
+    for (size_t size : options.sizes) {
+        CapsuleIndex index;
+        Corpus corpus;
+        corpus.name = "synthetic_" + std::to_string(size);
+        size_t rss_before = resident_bytes();
+        double build_ms = build_synthetic(options, size, index, corpus, rng);
+        run_corpus(options, corpus, index, build_ms, resident_bytes() - rss_before, json, first_report);
+    }
+
+    json << "\n  ]\n}\n";
+    if (options.out_path.empty()) {
+        std::fputs(json.str().c_str(), stdout);
+    } else {
+        std::ofstream out(options.out_path);
+        out << json.str();
+    }
+    return 0;
+}
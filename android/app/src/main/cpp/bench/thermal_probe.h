@@ -0,0 +1,107 @@
+#ifndef THERMAL_PROBE_H
+#define THERMAL_PROBE_H
+
+// Reads thermal zone temperatures and current CPU frequencies from sysfs.
+// Zones and CPUs the process may not read (common on Android without root)
+// are left out rather than reported as zero.
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace thermal_probe {
+
+struct Zone {
+    std::string type;   // e.g. "cpu-0-0-usr", "battery", "x86_pkg_temp"
+    std::string temp_path;
+};
+
+struct Cpu {
+    int index = 0;
+    std::string cur_freq_path;
+    double max_mhz = 0.0;
+};
+
+inline bool read_number(const std::string& path, double& value) {
+    std::ifstream file(path);
+    return static_cast<bool>(file >> value);
+}
+
+inline std::string read_line(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+// Numeric suffix of names like thermal_zone12 or cpu3, or -1
+inline int index_after(const std::string& name, const std::string& prefix) {
+    if (name.compare(0, prefix.size(), prefix) != 0 || name.size() == prefix.size()) {
+        return -1;
+    }
+    for (size_t i = prefix.size(); i < name.size(); ++i) {
+        if (name[i] < '0' || name[i] > '9') {
+            return -1;
+        }
+    }
+    return std::stoi(name.substr(prefix.size()));
+}
+
+inline std::vector<Zone> zones() {
+    namespace fs = std::filesystem;
+    std::vector<std::pair<int, Zone>> found;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator("/sys/class/thermal", error)) {
+        int index = index_after(entry.path().filename().string(), "thermal_zone");
+        double temp;
+        Zone zone{read_line((entry.path() / "type").string()), (entry.path() / "temp").string()};
+        if (index >= 0 && read_number(zone.temp_path, temp)) {
+            found.emplace_back(index, zone);
+        }
+    }
+    std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::vector<Zone> result;
+    for (auto& item : found) {
+        result.push_back(std::move(item.second));
+    }
+    return result;
+}
+
+inline std::vector<Cpu> cpus() {
+    namespace fs = std::filesystem;
+    std::vector<Cpu> result;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator("/sys/devices/system/cpu", error)) {
+        Cpu cpu;
+        cpu.index = index_after(entry.path().filename().string(), "cpu");
+        cpu.cur_freq_path = (entry.path() / "cpufreq" / "scaling_cur_freq").string();
+        double khz;
+        if (cpu.index < 0 || !read_number(cpu.cur_freq_path, khz)) {
+            continue;
+        }
+        if (read_number((entry.path() / "cpufreq" / "cpuinfo_max_freq").string(), khz)) {
+            cpu.max_mhz = khz / 1000.0;
+        }
+        result.push_back(cpu);
+    }
+    std::sort(result.begin(), result.end(), [](const Cpu& a, const Cpu& b) { return a.index < b.index; });
+    return result;
+}
+
+// Degrees Celsius; sysfs reports millidegrees. NaN when the read fails.
+inline double temperature_c(const Zone& zone) {
+    double milli;
+    return read_number(zone.temp_path, milli) ? milli / 1000.0 : std::nan("");
+}
+
+inline double frequency_mhz(const Cpu& cpu) {
+    double khz;
+    return read_number(cpu.cur_freq_path, khz) ? khz / 1000.0 : std::nan("");
+}
+
+} // namespace thermal_probe
+
+#endif // THERMAL_PROBE_H
@@ -1,6 +1,8 @@
 #ifndef MODEL_INTERFACE_H
 #define MODEL_INTERFACE_H
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -21,6 +23,168 @@ const char* get_model_info();
 void set_temperature(float temperature);
 void set_top_k(int top_k);
 void set_top_p(float top_p);
+// Reuse of the KV prefix shared with the previous prompt; on by default
+void set_prefix_reuse(int enabled);
+
+// Replaces the offline fallback answers with a JSON table (see
+// fallback_table.h); it also applies to models loaded later. Returns the
+// number of intents, or -1 and keeps the current table on error.
+int load_fallback_responses(const char* path);
+
+// Answers a math question ("what is 15% of 80?") without the model. Returns
+// the result or an error sentence (free with free_string), or NULL when the
+// text is not a math question. With require_cue nonzero, text that only
+// parses as arithmetic ("24/7") but does not ask for it also gives NULL.
+// Needs no loaded model.
+char* evaluate_math(const char* text, int require_cue);
+
+// The offline table's answer for prompt (free with free_string), or NULL
+// when no intent in the table matches it. Works with or without a model.
+char* curated_response(const char* prompt);
+
+// Prompt routing by nearest intent centroid over the loaded model's
+// sentence embeddings; see intent_classifier.h for the centroid file.
+// Intents: 0 emergency, 1 medical, 2 math, 3 greeting, 4 capsule lookup,
+// 5 open-ended (needs generation). load_intent_centroids() returns the
+// centroid count, or -1 and keeps the current centroids on error.
+// classify_intent() returns -1 without centroids or a model, or when the
+// centroids were built for another embedding size; similarity may be NULL.
+int load_intent_centroids(const char* path);
+int classify_intent(const char* text, float* similarity);
+
+// Persistent exact-match cache of model answers, keyed by the prompt,
+// model, sampling settings and capsule set (see response_cache.h). Once
+// open, generate_text() answers repeated prompts from it and stores every
+// answer that ended normally. Returns the cached entry count, or -1.
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t entries;
+    uint64_t live_bytes;
+    uint64_t file_bytes;
+} response_cache_stats;
+
+int response_cache_open(const char* path, int64_t max_bytes);
+void response_cache_close();
+void response_cache_clear();
+int response_cache_get_stats(response_cache_stats* stats); // 0, or -1
+
+// Per-request inference metrics
+typedef struct {
+    uint64_t request_id;
+    double tokenize_ms;
+    int32_t prompt_tokens;
+    int32_t reused_tokens;      // prompt prefix served from the KV cache
+    int32_t prefill_tokens;
+    double prefill_ms;
+    double ttft_ms;             // request start to first sampled token
+    int32_t generated_tokens;
+    double decode_ms;
+    double decode_tokens_per_sec;
+    double sample_ms;
+    double total_ms;
+    int32_t stop_reason;        // 1 end of sequence, 2 max tokens, 3 context full, 4 decode error,
+                                // 5 response cache hit (only total_ms is set)
+    // User-space hardware counters summed over all threads; -1 when not
+    // recorded (counters disabled, or not provided by the kernel or PMU)
+    int64_t prefill_cycles;
+    int64_t prefill_instructions;
+    int64_t prefill_cache_misses;
+    int64_t prefill_llc_loads;
+    double prefill_task_clock_ms;
+    int64_t decode_cycles;
+    int64_t decode_instructions;
+    int64_t decode_cache_misses;
+    int64_t decode_llc_loads;
+    double decode_task_clock_ms;
+} inference_metrics;
+
+// Copies up to max_records of the most recent requests, newest first;
+// returns how many were written
+int get_last_metrics(inference_metrics* records, int max_records);
+// metric: 0 time to first token, 1 prefill, 2 decode per token, 3 total.
+// Fills bucket counts and upper bounds in ms (the last bucket is open-ended)
+// and returns the bucket count, or -1
+int get_latency_histogram(int metric, uint64_t* counts, double* upper_bounds_ms, int max_buckets);
+void reset_metrics();
+// Records perf_event counters around prefill and decode (Linux/Android).
+// Returns 1 if counters will be recorded, 0 if the platform refuses them
+int perf_counters_set_enabled(int enabled);
+
+// Native memory accounting, in bytes
+typedef struct {
+    uint64_t model_file_bytes;      // mmapped model weights
+    uint64_t model_resident_bytes;  // part of the mapping resident in RAM (mincore)
+    uint64_t kv_cache_bytes;
+    int32_t kv_cells_used;
+    int32_t kv_cells_total;
+    uint64_t compute_buffer_bytes;
+    uint64_t index_bytes;           // capsule retrieval index
+    uint64_t tokenizer_bytes;       // vocabulary tables
+    uint64_t rss_bytes;
+    uint64_t peak_rss_bytes;
+} memory_stats;
+
+// Fills stats; model fields stay zero without a loaded model. Returns 0, or -1
+int get_memory_stats(memory_stats* stats);
+
+// Chrome/Perfetto trace spans of the native hot path
+void trace_set_enabled(int enabled);
+int trace_is_enabled();
+void trace_clear();
+char* trace_dump_json();                 // free with free_string
+int trace_dump_to_file(const char* path); // 0 on success, -1 on error
+
+// Structured native log kept in a ring buffer. Levels: 0 debug, 1 info,
+// 2 warn, 3 error, 4 off. log_drain_json() returns and removes up to
+// max_events pending events as {"dropped":N,"events":[...]}.
+void log_set_level(int level);
+void log_set_logcat(int enabled);
+char* log_drain_json(int max_events);   // free with free_string
+uint64_t log_dropped_count();
+
+// Retrieval reranking with the loaded model; returns how many leading
+// passages were scored within the time budget, or -1
+int rerank_passages(const char* query, const char** passages, int count,
+                    float* scores, int time_budget_ms);
+
+// Packs passages into the context left after the fixed prompt parts and
+// reserved_tokens of generation. dedup_policy: 0 none, 1 exact, 2 near.
+// Returns the packed text (free with free_string) or NULL without a model.
+char* pack_context(const char* system_prompt, const char* history, const char* user_message,
+                   const char** passages, const float* scores, int count,
+                   int reserved_tokens, int dedup_policy, int* tokens_used);
+
+// Capsule index functions
+typedef struct {
+    uint32_t passage_id;
+    int32_t sentence_index;
+    float score;
+    float semantic_score;
+    float keyword_score;
+} capsule_search_hit;
+
+int capsule_index_add(const char* name, const char** sentences, const int32_t* sentence_indices,
+                      const float* embeddings, int count, int dim);
+int capsule_index_add_file(const char* file_path, int max_passage_tokens);
+// Writes a JSON capsule as a compressed .ncap archive; returns its size in
+// bytes, or -1. capsule_index_add_file() accepts either format.
+int64_t capsule_compress_file(const char* json_path, const char* archive_path, int max_passage_tokens);
+int capsule_index_remove(const char* name);
+void capsule_index_clear();
+int capsule_index_search(const char* query, const float* query_embedding, int dim,
+                         capsule_search_hit* hits, int max_results, int* total_results);
+int capsule_index_search_filtered(const char* query, const float* query_embedding, int dim,
+                                  const char** capsules, int capsule_count,
+                                  capsule_search_hit* hits, int max_results, int* total_results);
+char* capsule_index_passage_text(uint32_t passage_id);
+char* capsule_index_passage_source(uint32_t passage_id);
+// Source sentence indices a passage stands for (near duplicates collapse
+// into one passage); fills up to max_refs and returns the total, or -1
+int capsule_index_passage_refs(uint32_t passage_id, int32_t* refs, int max_refs);
+uint64_t capsule_index_version();
+void capsule_index_set_cache_capacity(int capacity);
+void capsule_index_set_prefilter(int min_passages, int candidates);
 
 #ifdef __cplusplus
 }
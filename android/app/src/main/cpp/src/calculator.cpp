@@ -0,0 +1,698 @@
+#include "calculator.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace calculator {
+
+namespace {
+
+enum class Kind {
+    Number,
+    Plus,
+    Minus,
+    Star,
+    Slash,
+    Caret,
+    Percent,  // modulo between operands, percent after one
+    Mod,      // the word "mod", always modulo
+    Of,       // "20% of 50"
+    Bang,
+    LParen,
+    RParen,
+    Comma,
+    Function,
+    End
+};
+
+struct Value {
+    bool is_integer = true;
+    int64_t integer = 0;
+    double real = 0.0;
+    bool percent = false;  // a bare percentage, for 200 + 10%
+
+    double as_real() const { return is_integer ? static_cast<double>(integer) : real; }
+};
+
+Value make_integer(int64_t value) {
+    Value v;
+    v.integer = value;
+    return v;
+}
+
+Value make_real(double value) {
+    Value v;
+    v.is_integer = false;
+    v.real = value;
+    return v;
+}
+
+struct Function {
+    const char* name;
+    int arity;
+    double (*apply)(double, double);
+};
+
+const Function kFunctions[] = {
+    {"sqrt", 1, [](double x, double) { return std::sqrt(x); }},
+    {"cbrt", 1, [](double x, double) { return std::cbrt(x); }},
+    {"abs", 1, [](double x, double) { return std::fabs(x); }},
+    {"ln", 1, [](double x, double) { return std::log(x); }},
+    {"log", 1, [](double x, double) { return std::log10(x); }},
+    {"log2", 1, [](double x, double) { return std::log2(x); }},
+    {"exp", 1, [](double x, double) { return std::exp(x); }},
+    {"sin", 1, [](double x, double) { return std::sin(x); }},
+    {"cos", 1, [](double x, double) { return std::cos(x); }},
+    {"tan", 1, [](double x, double) { return std::tan(x); }},
+    {"asin", 1, [](double x, double) { return std::asin(x); }},
+    {"acos", 1, [](double x, double) { return std::acos(x); }},
+    {"atan", 1, [](double x, double) { return std::atan(x); }},
+    {"floor", 1, [](double x, double) { return std::floor(x); }},
+    {"ceil", 1, [](double x, double) { return std::ceil(x); }},
+    {"round", 1, [](double x, double) { return std::round(x); }},
+    {"min", 2, [](double x, double y) { return std::fmin(x, y); }},
+    {"max", 2, [](double x, double y) { return std::fmax(x, y); }},
+    {"pow", 2, [](double x, double y) { return std::pow(x, y); }},
+};
+
+// Words around the expression that do not change its meaning
+const char* const kFillerWords[] = {
+    "what", "whats", "what's", "is", "are", "the", "calculate", "compute", "evaluate", "solve",
+    "how", "much", "equals", "equal", "to", "please", "result", "value", "answer", "tell", "me",
+    "can", "you", "find", "give", "by",
+    "احسب", "كم", "ما", "هو", "هي", "يساوي", "ناتج", "قيمة",
+};
+
+// Filler words that ask for a computation outright
+const char* const kCueWords[] = {
+    "what", "whats", "what's", "calculate", "compute", "evaluate", "solve", "how", "equals", "equal",
+    "احسب", "كم", "ما", "يساوي", "ناتج",
+};
+
+struct Token {
+    Kind kind = Kind::End;
+    Value number;
+    const Function* function = nullptr;
+    bool spaced = false;  // whitespace right before it
+};
+
+bool is_word_in(const std::string& word, const char* const* words, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (word == words[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool is_filler(const std::string& word) {
+    return is_word_in(word, kFillerWords, sizeof(kFillerWords) / sizeof(kFillerWords[0]));
+}
+
+bool is_cue(const std::string& word) {
+    return is_word_in(word, kCueWords, sizeof(kCueWords) / sizeof(kCueWords[0]));
+}
+
+// Arabic-Indic digit (U+0660-U+0669, UTF-8 D9 A0-A9) at pos, or -1
+int arabic_digit(const std::string& text, size_t pos) {
+    if (pos + 1 < text.size() && static_cast<unsigned char>(text[pos]) == 0xD9) {
+        unsigned char second = static_cast<unsigned char>(text[pos + 1]);
+        if (second >= 0xA0 && second <= 0xA9) {
+            return second - 0xA0;
+        }
+    }
+    return -1;
+}
+
+int digit_at(const std::string& text, size_t pos, size_t& length) {
+    if (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+        length = 1;
+        return text[pos] - '0';
+    }
+    length = 2;
+    return arabic_digit(text, pos);
+}
+
+bool starts_with(const std::string& text, size_t pos, const char* prefix) {
+    return text.compare(pos, std::strlen(prefix), prefix) == 0;
+}
+
+// Reads a number: digits, optional fraction (. or Arabic ٫), optional
+// exponent. Integers without fraction or exponent stay exact when they fit.
+bool read_number(const std::string& text, size_t& pos, Value& value) {
+    std::string ascii;
+    size_t length;
+    int digit;
+    bool integral = true;
+    while ((digit = digit_at(text, pos, length)) >= 0) {
+        ascii.push_back(static_cast<char>('0' + digit));
+        pos += length;
+    }
+    if (pos < text.size() && (text[pos] == '.' || starts_with(text, pos, "\xD9\xAB")) &&
+        digit_at(text, pos + (text[pos] == '.' ? 1 : 2), length) >= 0) {
+        pos += text[pos] == '.' ? 1 : 2;
+        ascii.push_back('.');
+        integral = false;
+        while ((digit = digit_at(text, pos, length)) >= 0) {
+            ascii.push_back(static_cast<char>('0' + digit));
+            pos += length;
+        }
+    }
+    if (ascii.empty() || ascii == ".") {
+        return false;
+    }
+    // Exponent only when digits follow directly, so "2e" stays 2 * e
+    if (pos + 1 < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+        size_t exp_pos = pos + 1;
+        if (exp_pos < text.size() && (text[exp_pos] == '+' || text[exp_pos] == '-')) {
+            exp_pos++;
+        }
+        if (exp_pos < text.size() && text[exp_pos] >= '0' && text[exp_pos] <= '9') {
+            ascii.append(text, pos, exp_pos - pos);
+            pos = exp_pos;
+            while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+                ascii.push_back(text[pos++]);
+            }
+            integral = false;
+        }
+    }
+
+    if (integral) {
+        int64_t result = 0;
+        bool overflow = false;
+        for (char c : ascii) {
+            overflow = overflow || __builtin_mul_overflow(result, 10, &result) ||
+                       __builtin_add_overflow(result, c - '0', &result);
+        }
+        if (!overflow) {
+            value = make_integer(result);
+            return true;
+        }
+    }
+    value = make_real(std::strtod(ascii.c_str(), nullptr));
+    return true;
+}
+
+// Splits text into tokens, dropping filler words. Returns false when the
+// text contains anything that is neither math nor filler. cued is set when
+// a word, "=", a word operator or a function asks for a computation.
+bool tokenize(const std::string& text, std::vector<Token>& tokens, bool& cued) {
+    size_t pos = 0;
+    bool space = false;
+    cued = false;
+    while (pos < text.size()) {
+        const unsigned char c = static_cast<unsigned char>(text[pos]);
+        size_t length;
+        Token token;
+
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            pos++;
+            space = true;
+            continue;
+        }
+        token.spaced = space;
+        space = false;
+        if (c == '?' || c == '=' || c == ':') {
+            cued = cued || c == '=';
+            pos++;
+            continue;
+        }
+        if (digit_at(text, pos, length) >= 0 || (c == '.' && digit_at(text, pos + 1, length) >= 0)) {
+            token.kind = Kind::Number;
+            read_number(text, pos, token.number);
+            tokens.push_back(token);
+            continue;
+        }
+
+        struct Symbol {
+            const char* text;
+            Kind kind;
+        };
+        static const Symbol kSymbols[] = {
+            {"**", Kind::Caret}, {"+", Kind::Plus}, {"-", Kind::Minus}, {"*", Kind::Star},
+            {"/", Kind::Slash}, {"^", Kind::Caret}, {"%", Kind::Percent}, {"!", Kind::Bang},
+            {"(", Kind::LParen}, {")", Kind::RParen}, {",", Kind::Comma},
+            {"\xC3\x97", Kind::Star},       // ×
+            {"\xC3\xB7", Kind::Slash},      // ÷
+            {"\xE2\x88\x92", Kind::Minus},  // − (minus sign)
+            {"\xD9\xAA", Kind::Percent},    // ٪ (Arabic percent)
+            {"\xD8\x9F", Kind::End},        // ؟ (Arabic question mark), skipped
+        };
+        bool matched = false;
+        for (const Symbol& symbol : kSymbols) {
+            if (starts_with(text, pos, symbol.text)) {
+                pos += std::strlen(symbol.text);
+                if (symbol.kind != Kind::End) {
+                    token.kind = symbol.kind;
+                    tokens.push_back(token);
+                }
+                matched = true;
+                break;
+            }
+        }
+        if (matched) {
+            continue;
+        }
+
+        // A word: ASCII letters (folded) or any run of non-ASCII letters
+        size_t end = pos;
+        while (end < text.size()) {
+            unsigned char w = static_cast<unsigned char>(text[end]);
+            bool ascii_letter = (w >= 'a' && w <= 'z') || (w >= 'A' && w <= 'Z') || w == '\'' ||
+                                (end > pos && w >= '0' && w <= '9');
+            if (!ascii_letter && (w < 0x80 || arabic_digit(text, end) >= 0 || starts_with(text, end, "\xD8\x9F") ||
+                                  starts_with(text, end, "\xD9\xAA"))) {
+                break;
+            }
+            end++;
+        }
+        if (end == pos) {
+            return false; // stray punctuation
+        }
+        std::string word = text.substr(pos, end - pos);
+        for (char& ch : word) {
+            if (ch >= 'A' && ch <= 'Z') {
+                ch = static_cast<char>(ch - 'A' + 'a');
+            }
+        }
+        pos = end;
+
+        if (word == "plus") {
+            token.kind = Kind::Plus;
+            cued = true;
+        } else if (word == "minus") {
+            token.kind = Kind::Minus;
+            cued = true;
+        } else if (word == "times" || word == "x" || word == "multiplied") {
+            token.kind = Kind::Star;
+            cued = cued || word != "x";
+        } else if (word == "divided" || word == "over") {
+            token.kind = Kind::Slash;
+            cued = true;
+        } else if (word == "mod" || word == "modulo") {
+            token.kind = Kind::Mod;
+            cued = true;
+        } else if (word == "of") {
+            token.kind = Kind::Of;
+        } else if (word == "pi" || word == "e") {
+            token.kind = Kind::Number;
+            token.number = make_real(word == "pi" ? M_PI : M_E);
+        } else {
+            for (const Function& function : kFunctions) {
+                if (word == function.name) {
+                    token.kind = Kind::Function;
+                    token.function = &function;
+                }
+            }
+            if (token.kind != Kind::Function) {
+                if (is_filler(word)) {
+                    cued = cued || is_cue(word);
+                    continue;
+                }
+                return false;
+            }
+            cued = true;
+        }
+        tokens.push_back(token);
+    }
+    tokens.push_back(Token());
+    return true;
+}
+
+bool is_binary(Kind kind) {
+    return kind == Kind::Plus || kind == Kind::Minus || kind == Kind::Star || kind == Kind::Slash ||
+           kind == Kind::Caret || kind == Kind::Percent || kind == Kind::Mod;
+}
+
+// Numbers joined by unspaced - or / are a range ("3-5") or a date
+// ("2024-01-01", "12/25/2024"), not a difference or a quotient
+bool is_range_or_date(const std::vector<Token>& tokens) {
+    const size_t count = tokens.size() - 1; // without End
+    if (count != 3 && count != 5) {
+        return false;
+    }
+    const Kind separator = tokens[1].kind;
+    if (separator != Kind::Minus && !(separator == Kind::Slash && count == 5)) {
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const Kind expected = i % 2 ? separator : Kind::Number;
+        if (tokens[i].kind != expected || (i > 0 && tokens[i].spaced)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+class Parser {
+public:
+    explicit Parser(const std::vector<Token>& tokens) : m_tokens(tokens) {}
+
+    Status parse(Value& out) {
+        out = expression(0);
+        if (m_status == Status::Ok && peek().kind != Kind::End) {
+            m_status = Status::NoExpression;
+        }
+        if (m_status == Status::Ok && !m_operations) {
+            m_status = Status::NoExpression;
+        }
+        return m_status;
+    }
+
+private:
+    static constexpr int kMaxDepth = 64;
+
+    const std::vector<Token>& m_tokens;
+    size_t m_pos = 0;
+    int m_depth = 0;
+    int m_operations = 0;
+    Status m_status = Status::Ok;
+
+    const Token& peek(size_t ahead = 0) const {
+        return m_tokens[std::min(m_pos + ahead, m_tokens.size() - 1)];
+    }
+    const Token& advance() { return m_tokens[std::min(m_pos++, m_tokens.size() - 1)]; }
+
+    Value fail(Status status) {
+        if (m_status == Status::Ok) {
+            m_status = status;
+        }
+        return Value();
+    }
+
+    // A sign after % reads as "10% + 5", never as modulo by a signed operand
+    static bool starts_operand(Kind kind) {
+        return kind == Kind::Number || kind == Kind::LParen || kind == Kind::Function;
+    }
+
+    // Left and right binding power of an infix operator; 0 when not infix
+    static void infix_power(Kind kind, int& left, int& right) {
+        switch (kind) {
+            case Kind::Plus:
+            case Kind::Minus:
+                left = 10; right = 11; return;
+            case Kind::Star:
+            case Kind::Slash:
+            case Kind::Percent:
+            case Kind::Mod:
+            case Kind::Of:
+                left = 20; right = 21; return;
+            case Kind::Caret:
+                left = 40; right = 40; return; // right-associative
+            default:
+                left = 0; right = 0; return;
+        }
+    }
+
+    static constexpr int kPrefixPower = 30;   // -2^2 is -(2^2)
+    static constexpr int kPostfixPower = 50;
+
+    Value expression(int min_power) {
+        if (++m_depth > kMaxDepth) {
+            return fail(Status::NoExpression);
+        }
+        Value lhs = prefix();
+        while (m_status == Status::Ok) {
+            const Kind kind = peek().kind;
+            // % between operands is modulo, otherwise it closes a percentage
+            const bool postfix = kind == Kind::Bang || (kind == Kind::Percent && !starts_operand(peek(1).kind));
+            if (postfix) {
+                if (kPostfixPower < min_power) {
+                    break;
+                }
+                advance();
+                lhs = kind == Kind::Bang ? factorial(lhs) : percent(lhs);
+                continue;
+            }
+            int left, right;
+            infix_power(kind, left, right);
+            if (left == 0 || left < min_power) {
+                break;
+            }
+            advance();
+            Value rhs = expression(right);
+            if (m_status != Status::Ok) {
+                break;
+            }
+            lhs = binary(kind, lhs, rhs);
+        }
+        --m_depth;
+        return lhs;
+    }
+
+    Value prefix() {
+        const Token& token = advance();
+        switch (token.kind) {
+            case Kind::Number:
+                return token.number;
+            case Kind::Minus: {
+                Value operand = expression(kPrefixPower);
+                m_operations++;
+                return negate(operand);
+            }
+            case Kind::Plus:
+                return expression(kPrefixPower);
+            case Kind::LParen: {
+                Value inner = expression(0);
+                if (advance().kind != Kind::RParen) {
+                    return fail(Status::NoExpression);
+                }
+                inner.percent = false;
+                return inner;
+            }
+            case Kind::Function:
+                return call(*token.function);
+            default:
+                return fail(Status::NoExpression);
+        }
+    }
+
+    Value call(const Function& function) {
+        m_operations++;
+        double args[2] = {0.0, 0.0};
+        Value first;
+        if (peek().kind == Kind::LParen) {
+            advance();
+            for (int i = 0; i < function.arity; ++i) {
+                if (i > 0 && advance().kind != Kind::Comma) {
+                    return fail(Status::NoExpression);
+                }
+                Value arg = expression(0);
+                if (i == 0) {
+                    first = arg;
+                }
+                args[i] = arg.as_real();
+            }
+            if (advance().kind != Kind::RParen) {
+                return fail(Status::NoExpression);
+            }
+        } else if (function.arity == 1) {
+            // "sqrt 16", "sqrt of 16"
+            if (peek().kind == Kind::Of) {
+                advance();
+            }
+            first = expression(kPrefixPower);
+            args[0] = first.as_real();
+        } else {
+            return fail(Status::NoExpression);
+        }
+        if (m_status != Status::Ok) {
+            return Value();
+        }
+
+        const std::string name = function.name;
+        if (first.is_integer && (name == "abs" || name == "floor" || name == "ceil" || name == "round")) {
+            if (name == "abs" && first.integer == std::numeric_limits<int64_t>::min()) {
+                return make_real(-static_cast<double>(first.integer));
+            }
+            return make_integer(name == "abs" ? std::llabs(first.integer) : first.integer);
+        }
+        const double result = function.apply(args[0], args[1]);
+        return checked_real(result);
+    }
+
+    Value checked_real(double result) {
+        if (std::isnan(result)) {
+            return fail(Status::Domain);
+        }
+        if (std::isinf(result)) {
+            return fail(Status::Overflow);
+        }
+        // Integral results that fit stay exact integers, e.g. sqrt(16)
+        if (std::fabs(result) < 9007199254740992.0 && result == std::floor(result)) {
+            return make_integer(static_cast<int64_t>(result));
+        }
+        return make_real(result);
+    }
+
+    Value negate(const Value& v) {
+        if (v.is_integer && v.integer != std::numeric_limits<int64_t>::min()) {
+            Value result = make_integer(-v.integer);
+            result.percent = v.percent;
+            return result;
+        }
+        Value result = make_real(-v.as_real());
+        result.percent = v.percent;
+        return result;
+    }
+
+    Value percent(const Value& v) {
+        m_operations++;
+        Value result = v.is_integer && v.integer % 100 == 0 ? make_integer(v.integer / 100)
+                                                            : make_real(v.as_real() / 100.0);
+        result.percent = true;
+        return result;
+    }
+
+    Value factorial(const Value& v) {
+        m_operations++;
+        if (!v.is_integer || v.integer < 0) {
+            return fail(Status::Domain);
+        }
+        if (v.integer > 20) {
+            return v.integer > 170 ? fail(Status::Overflow) : make_real(std::tgamma(v.integer + 1.0));
+        }
+        int64_t result = 1;
+        for (int64_t i = 2; i <= v.integer; ++i) {
+            result *= i;
+        }
+        return make_integer(result);
+    }
+
+    Value binary(Kind kind, Value lhs, Value rhs) {
+        m_operations++;
+        // 200 + 10% adds ten percent of 200
+        if ((kind == Kind::Plus || kind == Kind::Minus) && rhs.percent && !lhs.percent) {
+            rhs = binary(Kind::Star, lhs, rhs);
+        }
+        const bool integers = lhs.is_integer && rhs.is_integer;
+        int64_t result;
+        switch (kind) {
+            case Kind::Plus:
+                if (integers && !__builtin_add_overflow(lhs.integer, rhs.integer, &result)) {
+                    return make_integer(result);
+                }
+                return checked_real(lhs.as_real() + rhs.as_real());
+            case Kind::Minus:
+                if (integers && !__builtin_sub_overflow(lhs.integer, rhs.integer, &result)) {
+                    return make_integer(result);
+                }
+                return checked_real(lhs.as_real() - rhs.as_real());
+            case Kind::Star:
+            case Kind::Of:
+                if (integers && !__builtin_mul_overflow(lhs.integer, rhs.integer, &result)) {
+                    return make_integer(result);
+                }
+                return checked_real(lhs.as_real() * rhs.as_real());
+            case Kind::Slash:
+                if (rhs.as_real() == 0.0) {
+                    return fail(Status::DivisionByZero);
+                }
+                if (integers && !(lhs.integer == std::numeric_limits<int64_t>::min() && rhs.integer == -1) &&
+                    lhs.integer % rhs.integer == 0) {
+                    return make_integer(lhs.integer / rhs.integer);
+                }
+                return checked_real(lhs.as_real() / rhs.as_real());
+            case Kind::Percent:
+            case Kind::Mod:
+                if (rhs.as_real() == 0.0) {
+                    return fail(Status::DivisionByZero);
+                }
+                if (integers) {
+                    return make_integer(rhs.integer == -1 ? 0 : lhs.integer % rhs.integer);
+                }
+                return checked_real(std::fmod(lhs.as_real(), rhs.as_real()));
+            case Kind::Caret:
+                return power(lhs, rhs);
+            default:
+                return fail(Status::NoExpression);
+        }
+    }
+
+    Value power(const Value& base, const Value& exponent) {
+        if (base.is_integer && exponent.is_integer && exponent.integer >= 0) {
+            int64_t result = 1;
+            int64_t factor = base.integer;
+            int64_t remaining = exponent.integer;
+            bool overflow = false;
+            while (remaining > 0 && !overflow) {
+                if (remaining & 1) {
+                    overflow = __builtin_mul_overflow(result, factor, &result);
+                }
+                remaining >>= 1;
+                if (remaining > 0 && !overflow) {
+                    overflow = __builtin_mul_overflow(factor, factor, &factor);
+                }
+            }
+            if (!overflow) {
+                return make_integer(result);
+            }
+        }
+        if (base.as_real() == 0.0 && exponent.as_real() < 0.0) {
+            return fail(Status::DivisionByZero);
+        }
+        return checked_real(std::pow(base.as_real(), exponent.as_real()));
+    }
+};
+
+} // namespace
+
+std::string Result::format() const {
+    if (status != Status::Ok) {
+        return "";
+    }
+    if (is_integer) {
+        return std::to_string(integer);
+    }
+    // Twelve significant digits, like a calculator display, so 0.1 + 0.2
+    // reads 0.3 rather than its binary rounding error
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.12g", real);
+    return buffer;
+}
+
+Result evaluate(const std::string& text) {
+    Result result;
+    std::vector<Token> tokens;
+    bool cued = false;
+    if (!tokenize(text, tokens, cued) || tokens.size() < 2 || is_range_or_date(tokens)) {
+        return result;
+    }
+    for (size_t i = 1; i + 1 < tokens.size() && !cued; ++i) {
+        cued = is_binary(tokens[i].kind) && tokens[i].spaced && tokens[i + 1].spaced &&
+               tokens[i + 1].kind != Kind::End;
+    }
+    result.cued = cued;
+    Value value;
+    result.status = Parser(tokens).parse(value);
+    if (result.status == Status::Ok) {
+        result.is_integer = value.is_integer;
+        result.integer = value.integer;
+        result.real = value.real;
+    }
+    return result;
+}
+
+std::string answer(const std::string& text, bool require_cue) {
+    const Result result = evaluate(text);
+    if (require_cue && !result.cued) {
+        return "";
+    }
+    switch (result.status) {
+        case Status::Ok:
+            return result.format();
+        case Status::DivisionByZero:
+            return "Division by zero is undefined.";
+        case Status::Domain:
+            return "That expression has no real-number result.";
+        case Status::Overflow:
+            return "The result is too large to represent.";
+        case Status::NoExpression:
+            break;
+    }
+    return "";
+}
+
+} // namespace calculator
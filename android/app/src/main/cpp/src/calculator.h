@@ -0,0 +1,57 @@
+#ifndef CALCULATOR_H
+#define CALCULATOR_H
+
+#include <string>
+#include <cstdint>
+
+// Arithmetic for math questions, answered exactly without the model. A
+// Pratt parser over + - * / ^ (or **), % as modulo or percent, postfix !
+// factorial, parentheses, unary minus, functions (sqrt, cbrt, abs, ln, log,
+// log2, exp, sin, cos, tan, asin, acos, atan, floor, ceil, round, min, max,
+// pow) and the constants pi and e. Number words such as "plus", "times" and
+// "divided by", and the symbols x, ×, ÷ and −, are read as operators.
+// Arabic-Indic digits are accepted.
+//
+// Integers stay exact in int64 and move to double only when an operation
+// overflows or has no integer result. A percent right of + or - is taken
+// of the left side, as on a pocket calculator: 200 + 10% is 220.
+namespace calculator {
+
+enum class Status {
+    Ok,
+    NoExpression,    // not a math question
+    DivisionByZero,
+    Domain,          // e.g. sqrt(-1), log(0), 2.5!
+    Overflow
+};
+
+struct Result {
+    Status status = Status::NoExpression;
+    bool is_integer = false;
+    int64_t integer = 0;
+    double real = 0.0;
+    // Asked for in so many words: a question or command word, "=", a word
+    // operator, a function, or an operator with spaces on both sides
+    bool cued = false;
+
+    // Integers in full, reals to 12 significant digits: "42", "0.3"
+    std::string format() const;
+};
+
+// Evaluates text that is an expression, optionally wrapped in question
+// words ("what is 15% of 80?", "calculate (3 + 4) * 2", "احسب ٣ + ٤").
+// Any other word means the text is not a math question, so prose such as
+// "2-3 days of water" is never computed. The expression needs at least one
+// operator or function; a bare number is not a question. Ranges and dates
+// such as "3-5" and "2024-01-01" are not expressions either.
+Result evaluate(const std::string& text);
+
+// The reply to text: the formatted result, a short sentence for division by
+// zero, domain and overflow errors, or "" when text is not a math question.
+// With require_cue, text such as "24/7" that only parses as arithmetic but
+// does not ask for it is not a math question either.
+std::string answer(const std::string& text, bool require_cue = false);
+
+} // namespace calculator
+
+#endif // CALCULATOR_H
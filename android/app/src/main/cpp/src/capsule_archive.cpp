@@ -0,0 +1,477 @@
+#include "capsule_archive.h"
+#include "trace.h"
+#include <zlib.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+constexpr char kMagic[4] = {'N', 'C', 'A', 'P'};
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kMaxBlockBytes = 16u << 20;
+
+struct ArchiveHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t passage_count;
+    uint32_t block_count;
+    uint32_t dictionary_size;
+    uint32_t ref_count;
+    uint32_t reserved;
+    uint64_t passages_offset;
+    uint64_t refs_offset;
+    uint64_t vectors_offset;
+    uint64_t dictionary_offset;
+    uint64_t blocks_offset;
+    uint64_t data_offset;
+};
+
+struct PassageRecord {
+    uint32_t block;
+    uint32_t offset;
+    uint32_t length;
+    int32_t sentence_index;
+    uint32_t ref_start;
+    uint32_t ref_count;
+};
+
+struct BlockRecord {
+    uint64_t offset;
+    uint32_t compressed_size;
+    uint32_t raw_size;
+};
+
+// The on-disk layout is these structs verbatim
+static_assert(sizeof(ArchiveHeader) == 80, "archive header layout");
+static_assert(sizeof(PassageRecord) == 24, "passage record layout");
+static_assert(sizeof(BlockRecord) == 16, "block record layout");
+
+bool compress_block(const std::string& raw, const std::string& dictionary, int level, std::string& out) {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    // Negative window bits: raw deflate, no zlib header per block
+    if (deflateInit2(&stream, level, Z_DEFLATED, -15, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    if (!dictionary.empty() &&
+        deflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(dictionary.data()),
+                             static_cast<uInt>(dictionary.size())) != Z_OK) {
+        deflateEnd(&stream);
+        return false;
+    }
+    out.resize(deflateBound(&stream, raw.size()));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(raw.data()));
+    stream.avail_in = static_cast<uInt>(raw.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    int result = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result == Z_STREAM_END;
+}
+
+bool decompress_block(const std::string& compressed, const std::string& dictionary, size_t raw_size,
+                      std::string& out) {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -15) != Z_OK) {
+        return false;
+    }
+    // Raw streams take the dictionary up front rather than on Z_NEED_DICT
+    if (!dictionary.empty() &&
+        inflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(dictionary.data()),
+                             static_cast<uInt>(dictionary.size())) != Z_OK) {
+        inflateEnd(&stream);
+        return false;
+    }
+    out.resize(raw_size);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    int result = inflate(&stream, Z_FINISH);
+    bool ok = result == Z_STREAM_END && stream.total_out == raw_size;
+    inflateEnd(&stream);
+    return ok;
+}
+
+template <typename T>
+bool write_array(FILE* file, const std::vector<T>& values) {
+    return values.empty() || std::fwrite(values.data(), sizeof(T), values.size(), file) == values.size();
+}
+
+template <typename T>
+bool read_array(FILE* file, uint64_t offset, size_t count, std::vector<T>& values) {
+    values.resize(count);
+    if (count == 0) {
+        return true;
+    }
+    return std::fseek(file, static_cast<long>(offset), SEEK_SET) == 0 &&
+           std::fread(values.data(), sizeof(T), count, file) == count;
+}
+
+} // namespace
+
+CapsuleArchiveWriter::CapsuleArchiveWriter(const CapsuleArchiveOptions& options) : m_options(options) {}
+
+std::string CapsuleArchiveWriter::build_dictionary(const std::vector<std::string>& passages, size_t max_bytes) {
+    // Frequent words weighted by length; deflate finds matches nearest the
+    // end of the dictionary cheapest, so the most valuable words go last
+    std::unordered_map<std::string, size_t> counts;
+    for (const auto& passage : passages) {
+        size_t start = 0;
+        while (start < passage.size()) {
+            size_t end = passage.find(' ', start);
+            if (end == std::string::npos) {
+                end = passage.size();
+            }
+            if (end - start >= 3) {
+                counts[passage.substr(start, end - start + (end < passage.size() ? 1 : 0))]++;
+            }
+            start = end + 1;
+        }
+    }
+
+    std::vector<std::pair<size_t, std::string>> ranked;
+    for (auto& entry : counts) {
+        if (entry.second >= 2) {
+            ranked.emplace_back(entry.second * entry.first.size(), entry.first);
+        }
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    std::vector<const std::string*> chosen;
+    size_t total = 0;
+    for (const auto& entry : ranked) {
+        if (total + entry.second.size() > max_bytes) {
+            continue;
+        }
+        chosen.push_back(&entry.second);
+        total += entry.second.size();
+    }
+
+    std::string dictionary;
+    dictionary.reserve(total);
+    for (auto it = chosen.rbegin(); it != chosen.rend(); ++it) {
+        dictionary += **it;
+    }
+    return dictionary;
+}
+
+int64_t CapsuleArchiveWriter::write(const std::string& path, const IngestedCapsule& capsule) const {
+    const size_t count = capsule.passages.size();
+    if (capsule.dim <= 0 || capsule.embeddings.size() != count * static_cast<size_t>(capsule.dim)) {
+        return -1;
+    }
+
+    const std::string dictionary = build_dictionary(capsule.passages, std::min<size_t>(m_options.dictionary_bytes, 32768));
+
+    // Passage table, refs and text blocks
+    std::vector<PassageRecord> passages(count);
+    std::vector<int32_t> refs;
+    std::vector<BlockRecord> blocks;
+    std::string data;
+    std::string raw;
+    auto flush_block = [&]() {
+        if (raw.empty()) {
+            return true;
+        }
+        std::string compressed;
+        if (!compress_block(raw, dictionary, m_options.level, compressed)) {
+            return false;
+        }
+        blocks.push_back({data.size(), static_cast<uint32_t>(compressed.size()), static_cast<uint32_t>(raw.size())});
+        data += compressed;
+        raw.clear();
+        return true;
+    };
+
+    for (size_t i = 0; i < count; ++i) {
+        if (raw.size() >= m_options.block_bytes && !flush_block()) {
+            return -1;
+        }
+        PassageRecord& record = passages[i];
+        record.block = static_cast<uint32_t>(blocks.size());
+        record.offset = static_cast<uint32_t>(raw.size());
+        record.length = static_cast<uint32_t>(capsule.passages[i].size());
+        record.sentence_index = i < capsule.sentence_indices.size() ? capsule.sentence_indices[i] : static_cast<int32_t>(i);
+        record.ref_start = static_cast<uint32_t>(refs.size());
+        if (i < capsule.source_refs.size()) {
+            refs.insert(refs.end(), capsule.source_refs[i].begin(), capsule.source_refs[i].end());
+        }
+        record.ref_count = static_cast<uint32_t>(refs.size()) - record.ref_start;
+        raw += capsule.passages[i];
+    }
+    if (!flush_block()) {
+        return -1;
+    }
+
+    // Symmetric per-row int8 quantization of the normalized vectors
+    const int dim = capsule.dim;
+    std::vector<float> scales(count);
+    std::vector<int8_t> vectors(count * dim);
+    std::vector<float> row(dim);
+    for (size_t i = 0; i < count; ++i) {
+        float norm = 0.0f;
+        for (int d = 0; d < dim; ++d) {
+            row[d] = capsule.embeddings[i * dim + d];
+            norm += row[d] * row[d];
+        }
+        norm = norm > 0.0f ? 1.0f / std::sqrt(norm) : 0.0f;
+        float max_abs = 0.0f;
+        for (int d = 0; d < dim; ++d) {
+            row[d] *= norm;
+            max_abs = std::max(max_abs, std::fabs(row[d]));
+        }
+        scales[i] = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+        for (int d = 0; d < dim; ++d) {
+            vectors[i * dim + d] = static_cast<int8_t>(std::lround(row[d] / scales[i]));
+        }
+    }
+
+    ArchiveHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.dim = static_cast<uint32_t>(dim);
+    header.passage_count = static_cast<uint32_t>(count);
+    header.block_count = static_cast<uint32_t>(blocks.size());
+    header.dictionary_size = static_cast<uint32_t>(dictionary.size());
+    header.ref_count = static_cast<uint32_t>(refs.size());
+    header.passages_offset = sizeof(ArchiveHeader);
+    header.refs_offset = header.passages_offset + passages.size() * sizeof(PassageRecord);
+    header.vectors_offset = header.refs_offset + refs.size() * sizeof(int32_t);
+    header.dictionary_offset = header.vectors_offset + scales.size() * sizeof(float) + vectors.size();
+    header.blocks_offset = header.dictionary_offset + dictionary.size();
+    header.data_offset = header.blocks_offset + blocks.size() * sizeof(BlockRecord);
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return -1;
+    }
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              write_array(file, passages) &&
+              write_array(file, refs) &&
+              write_array(file, scales) &&
+              write_array(file, vectors) &&
+              (dictionary.empty() || std::fwrite(dictionary.data(), 1, dictionary.size(), file) == dictionary.size()) &&
+              write_array(file, blocks) &&
+              (data.empty() || std::fwrite(data.data(), 1, data.size(), file) == data.size());
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        std::remove(path.c_str());
+        return -1;
+    }
+    return static_cast<int64_t>(header.data_offset + data.size());
+}
+
+CapsuleArchive::~CapsuleArchive() {
+    if (m_file) {
+        std::fclose(m_file);
+    }
+}
+
+bool CapsuleArchive::is_archive(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[4] = {0};
+    bool matches = std::fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                   std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+    std::fclose(file);
+    return matches;
+}
+
+bool CapsuleArchive::open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file) {
+        return false;
+    }
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    std::fseek(file, 0, SEEK_END);
+    const uint64_t file_size = static_cast<uint64_t>(std::max(0L, std::ftell(file)));
+    std::fseek(file, 0, SEEK_SET);
+
+    // Every section must lie inside the file before anything is allocated
+    ArchiveHeader header;
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t size) {
+        return offset <= file_size && count <= (file_size - offset) / size;
+    };
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+              header.version == kVersion && header.dim > 0 &&
+              fits(header.passages_offset, header.passage_count, sizeof(PassageRecord)) &&
+              fits(header.refs_offset, header.ref_count, sizeof(int32_t)) &&
+              fits(header.vectors_offset, header.passage_count, sizeof(float) + header.dim) &&
+              fits(header.dictionary_offset, header.dictionary_size, 1) &&
+              fits(header.blocks_offset, header.block_count, sizeof(BlockRecord)) &&
+              header.data_offset <= file_size;
+
+    std::vector<PassageRecord> passages;
+    std::vector<BlockRecord> blocks;
+    std::vector<char> dictionary;
+    ok = ok &&
+         read_array(file, header.passages_offset, header.passage_count, passages) &&
+         read_array(file, header.refs_offset, header.ref_count, m_refs) &&
+         read_array(file, header.vectors_offset, header.passage_count, m_scales) &&
+         read_array(file, header.vectors_offset + header.passage_count * sizeof(float),
+                    static_cast<size_t>(header.passage_count) * header.dim, m_vectors) &&
+         read_array(file, header.dictionary_offset, header.dictionary_size, dictionary) &&
+         read_array(file, header.blocks_offset, header.block_count, blocks);
+
+    // Reject tables that point outside themselves
+    const uint64_t data_size = ok ? file_size - header.data_offset : 0;
+    for (size_t i = 0; ok && i < blocks.size(); ++i) {
+        // Written so a crafted offset cannot wrap the sum past the check
+        ok = blocks[i].offset <= data_size && blocks[i].compressed_size <= data_size - blocks[i].offset &&
+             blocks[i].raw_size <= kMaxBlockBytes;
+    }
+    for (size_t i = 0; ok && i < passages.size(); ++i) {
+        const PassageRecord& p = passages[i];
+        ok = p.block < blocks.size() &&
+             static_cast<uint64_t>(p.offset) + p.length <= blocks[p.block].raw_size &&
+             static_cast<uint64_t>(p.ref_start) + p.ref_count <= m_refs.size();
+    }
+    if (!ok) {
+        std::fclose(file);
+        m_refs.clear();
+        m_scales.clear();
+        m_vectors.clear();
+        return false;
+    }
+
+    m_file = file;
+    m_dim = header.dim;
+    m_data_offset = header.data_offset;
+    m_dictionary.assign(dictionary.begin(), dictionary.end());
+    m_passages.reserve(passages.size());
+    for (const auto& p : passages) {
+        m_passages.push_back({p.block, p.offset, p.length, p.sentence_index, p.ref_start, p.ref_count});
+    }
+    m_blocks.reserve(blocks.size());
+    for (const auto& b : blocks) {
+        m_blocks.push_back({b.offset, b.compressed_size, b.raw_size});
+    }
+    return true;
+}
+
+void CapsuleArchive::dequantize(size_t row, float* out) const {
+    if (m_vectors.size() < (row + 1) * m_dim) {
+        std::fill(out, out + m_dim, 0.0f);
+        return;
+    }
+    const int8_t* codes = m_vectors.data() + row * m_dim;
+    const float scale = m_scales[row];
+    for (uint32_t d = 0; d < m_dim; ++d) {
+        out[d] = codes[d] * scale;
+    }
+}
+
+void CapsuleArchive::release_vectors() {
+    std::vector<float>().swap(m_scales);
+    std::vector<int8_t>().swap(m_vectors);
+}
+
+std::vector<int32_t> CapsuleArchive::source_refs(size_t row) const {
+    const PassageEntry& entry = m_passages[row];
+    return std::vector<int32_t>(m_refs.begin() + entry.ref_start,
+                                m_refs.begin() + entry.ref_start + entry.ref_count);
+}
+
+bool CapsuleArchive::load_block_locked(uint32_t block, std::string& text) const {
+    TRACE_SCOPE_ARG("archive_inflate", block);
+    const BlockEntry& entry = m_blocks[block];
+    std::string compressed(entry.compressed_size, '\0');
+    if (std::fseek(m_file, static_cast<long>(m_data_offset + entry.offset), SEEK_SET) != 0 ||
+        std::fread(&compressed[0], 1, compressed.size(), m_file) != compressed.size()) {
+        return false;
+    }
+    return decompress_block(compressed, m_dictionary, entry.raw_size, text);
+}
+
+const std::string* CapsuleArchive::cached_block_locked(uint32_t block) const {
+    for (auto it = m_cache.begin(); it != m_cache.end(); ++it) {
+        if (it->block == block) {
+            m_cache.splice(m_cache.begin(), m_cache, it);
+            return &m_cache.front().text;
+        }
+    }
+
+    CachedBlock cached{block, std::string()};
+    if (!load_block_locked(block, cached.text)) {
+        return nullptr;
+    }
+    m_cache.push_front(std::move(cached));
+    while (m_cache.size() > std::max<size_t>(1, m_cache_capacity)) {
+        m_cache.pop_back();
+    }
+    return &m_cache.front().text;
+}
+
+bool CapsuleArchive::passage_text(size_t row, std::string& text) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file || row >= m_passages.size()) {
+        return false;
+    }
+    const PassageEntry& entry = m_passages[row];
+    const std::string* block = cached_block_locked(entry.block);
+    if (!block) {
+        return false;
+    }
+    text.assign(*block, entry.offset, entry.length);
+    return true;
+}
+
+bool CapsuleArchive::for_each_passage(const std::function<void(size_t, const std::string&)>& visit) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file) {
+        return false;
+    }
+    // Passages are stored in block order, so each block is inflated once
+    // without disturbing the cache
+    std::string block_text;
+    uint32_t loaded = UINT32_MAX;
+    for (size_t row = 0; row < m_passages.size(); ++row) {
+        const PassageEntry& entry = m_passages[row];
+        if (entry.block != loaded) {
+            if (!load_block_locked(entry.block, block_text)) {
+                return false;
+            }
+            loaded = entry.block;
+        }
+        visit(row, block_text.substr(entry.offset, entry.length));
+    }
+    return true;
+}
+
+void CapsuleArchive::set_block_cache_capacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cache_capacity = capacity;
+    while (m_cache.size() > std::max<size_t>(1, m_cache_capacity)) {
+        m_cache.pop_back();
+    }
+}
+
+uint64_t CapsuleArchive::memory_bytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t bytes = m_passages.capacity() * sizeof(PassageEntry)
+        + m_refs.capacity() * sizeof(int32_t)
+        + m_scales.capacity() * sizeof(float)
+        + m_vectors.capacity() * sizeof(int8_t)
+        + m_dictionary.capacity()
+        + m_blocks.capacity() * sizeof(BlockEntry);
+    for (const auto& block : m_cache) {
+        bytes += sizeof(CachedBlock) + block.text.capacity();
+    }
+    return bytes;
+}
@@ -0,0 +1,112 @@
+#ifndef CAPSULE_ARCHIVE_H
+#define CAPSULE_ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <functional>
+#include <mutex>
+#include <cstdio>
+#include <cstdint>
+#include "capsule_ingest.h"
+
+// Compressed binary capsule (.ncap) for sharing over Bluetooth and SD cards.
+// Passage text is split into blocks that are raw-deflate compressed against
+// one shared dictionary, so any block decompresses on its own; vectors are
+// stored as int8 with a per-row scale.
+//
+// Layout (little-endian):
+//   header | passage table | source refs | vectors | dictionary | block table | blocks
+struct CapsuleArchiveOptions {
+    size_t block_bytes = 8192;       // uncompressed text per block
+    size_t dictionary_bytes = 8192;  // zlib uses at most 32 KiB
+    int level = 9;
+};
+
+class CapsuleArchiveWriter {
+public:
+    explicit CapsuleArchiveWriter(const CapsuleArchiveOptions& options = CapsuleArchiveOptions());
+
+    // Returns the number of bytes written, or -1
+    int64_t write(const std::string& path, const IngestedCapsule& capsule) const;
+
+    static std::string build_dictionary(const std::vector<std::string>& passages, size_t max_bytes);
+
+private:
+    CapsuleArchiveOptions m_options;
+};
+
+// Keeps only the tables and, until released, the quantized vectors
+// resident; text blocks are read and inflated on demand through a small LRU
+// of decoded blocks.
+class CapsuleArchive {
+public:
+    CapsuleArchive() = default;
+    ~CapsuleArchive();
+
+    CapsuleArchive(const CapsuleArchive&) = delete;
+    CapsuleArchive& operator=(const CapsuleArchive&) = delete;
+
+    bool open(const std::string& path);
+    static bool is_archive(const std::string& path);
+
+    int dim() const { return static_cast<int>(m_dim); }
+    size_t passage_count() const { return m_passages.size(); }
+    size_t block_count() const { return m_blocks.size(); }
+
+    // Zeros once release_vectors() has dropped the int8 codes
+    void dequantize(size_t row, float* out) const;
+    // Frees the quantized vectors once they have been dequantized elsewhere
+    void release_vectors();
+    int32_t sentence_index(size_t row) const { return m_passages[row].sentence_index; }
+    std::vector<int32_t> source_refs(size_t row) const;
+
+    bool passage_text(size_t row, std::string& text) const;
+
+    // Decodes every block once in order, e.g. to extract keywords at load
+    bool for_each_passage(const std::function<void(size_t, const std::string&)>& visit) const;
+
+    void set_block_cache_capacity(size_t capacity);
+
+    // Resident tables, vectors and cached blocks
+    uint64_t memory_bytes() const;
+
+private:
+    struct PassageEntry {
+        uint32_t block;
+        uint32_t offset;
+        uint32_t length;
+        int32_t sentence_index;
+        uint32_t ref_start;
+        uint32_t ref_count;
+    };
+
+    struct BlockEntry {
+        uint64_t offset;
+        uint32_t compressed_size;
+        uint32_t raw_size;
+    };
+
+    struct CachedBlock {
+        uint32_t block;
+        std::string text;
+    };
+
+    mutable std::mutex m_mutex;
+    FILE* m_file = nullptr;
+    uint32_t m_dim = 0;
+    uint64_t m_data_offset = 0;
+    std::vector<PassageEntry> m_passages;
+    std::vector<int32_t> m_refs;
+    std::vector<float> m_scales;
+    std::vector<int8_t> m_vectors;
+    std::string m_dictionary;
+    std::vector<BlockEntry> m_blocks;
+    size_t m_cache_capacity = 4;
+    mutable std::list<CachedBlock> m_cache; // most recently used first
+
+    bool load_block_locked(uint32_t block, std::string& text) const;
+    const std::string* cached_block_locked(uint32_t block) const;
+};
+
+#endif // CAPSULE_ARCHIVE_H
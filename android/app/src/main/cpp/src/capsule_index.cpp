@@ -0,0 +1,777 @@
+#include "capsule_index.h"
+#include "query_cache.h"
+#include "retrieval_kernels.h"
+#include "passage_bitmap.h"
+#include "near_duplicate.h"
+#include "capsule_archive.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cctype>
+#include <mutex>
+#include <unordered_set>
+
+namespace {
+
+// Hybrid scoring, kept in line with CapsuleSearchService on the Dart side
+constexpr float kSemanticWeight = 0.4f;
+constexpr float kKeywordWeight = 0.6f;
+constexpr float kSimilarityThreshold = 0.05f;
+constexpr float kKeywordOnlyThreshold = 0.2f;
+
+// Binary prefilter policy
+constexpr size_t kPrefilterMinPassages = 20000;
+constexpr size_t kPrefilterCandidates = 512;
+// Most rows that exact keyword matches may add past the prefilter
+constexpr size_t kKeywordBypassMaxRows = 256;
+
+// Results are diversified by MMR over the best kMmrPoolFactor * max_results
+// hits, with redundancy measured by SimHash distance
+constexpr float kMmrLambda = 0.7f;
+constexpr size_t kMmrPoolFactor = 3;
+
+// Compaction policy
+constexpr size_t kSmallSegmentRows = 512;
+constexpr size_t kMaxSmallSegments = 4;
+
+const std::unordered_set<std::string>& stop_words() {
+    static const std::unordered_set<std::string> words = {
+        "the", "and", "for", "are", "but", "not", "you", "can", "her", "was",
+        "one", "our", "had", "by", "what", "were", "they", "we", "when", "your",
+        "said", "each", "which", "she", "how", "other", "than", "now", "very", "my",
+        "be", "has", "he", "in", "will", "on", "it", "of", "an", "as",
+        "is", "his", "have", "that", "to", "a", "with", "at", "this", "or",
+        "from", "if", "all"
+    };
+    return words;
+}
+
+float keyword_similarity(const std::vector<std::string>& query_words,
+                         const std::vector<std::string>& content_words) {
+    if (query_words.empty() || content_words.empty()) {
+        return 0.0f;
+    }
+
+    int exact_matches = 0;
+    int partial_matches = 0;
+    for (const auto& query_word : query_words) {
+        if (std::find(content_words.begin(), content_words.end(), query_word) != content_words.end()) {
+            exact_matches++;
+            continue;
+        }
+        for (const auto& content_word : content_words) {
+            if (content_word.find(query_word) != std::string::npos ||
+                query_word.find(content_word) != std::string::npos) {
+                partial_matches++;
+                break;
+            }
+        }
+    }
+
+    float n = static_cast<float>(query_words.size());
+    return exact_matches / n + partial_matches / n * 0.5f;
+}
+
+} // namespace
+
+void IndexSegment::build_auxiliary() {
+    // Runs before ids are assigned, so size by the per-row keyword lists
+    const size_t rows = keywords.size();
+    code_words = retrieval::code_words(dim);
+    codes.assign(rows * code_words, 0);
+    postings.clear();
+    for (size_t row = 0; row < rows; ++row) {
+        retrieval::sign_quantize(vectors.data() + row * dim, dim, codes.data() + row * code_words);
+        for (const auto& word : keywords[row]) {
+            auto& rows = postings[word];
+            if (rows.empty() || rows.back() != row) {
+                rows.push_back(static_cast<uint32_t>(row));
+            }
+        }
+    }
+}
+
+void IndexSegment::update_id_range() {
+    if (ids.empty()) {
+        return;
+    }
+    auto bounds = std::minmax_element(ids.begin(), ids.end());
+    min_id = *bounds.first;
+    max_id = *bounds.second;
+}
+
+CapsuleIndex::CapsuleIndex()
+    : m_query_cache(std::make_unique<QueryCache>()),
+      m_prefilter_min_passages(kPrefilterMinPassages),
+      m_prefilter_candidates(kPrefilterCandidates),
+      m_mmr_lambda(kMmrLambda) {}
+
+CapsuleIndex::~CapsuleIndex() {
+    if (m_compactor.joinable()) {
+        m_compactor.join();
+    }
+}
+
+std::vector<std::string> CapsuleIndex::extract_keywords(const std::string& text) {
+    std::vector<std::string> words;
+    std::string current;
+    auto flush = [&]() {
+        if (current.length() > 2 && !stop_words().count(current)) {
+            words.push_back(current);
+        }
+        current.clear();
+    };
+
+    for (unsigned char c : text) {
+        if (std::isalnum(c) || c == '_') {
+            current.push_back(static_cast<char>(std::tolower(c)));
+        } else {
+            flush();
+        }
+    }
+    flush();
+    return words;
+}
+
+bool CapsuleIndex::add_capsule(const std::string& name,
+                               const std::vector<std::string>& sentences,
+                               const std::vector<int>& sentence_indices,
+                               const std::vector<float>& embeddings,
+                               int dim,
+                               const std::vector<std::vector<int>>* source_refs) {
+    if (name.empty() || dim <= 0 ||
+        embeddings.size() != sentences.size() * static_cast<size_t>(dim)) {
+        return false;
+    }
+
+    TRACE_SCOPE_ARG("retrieval_add", static_cast<int64_t>(sentences.size()));
+
+    // Build the segment outside the lock so searches keep running
+    auto segment = std::make_shared<IndexSegment>();
+    segment->dim = dim;
+    segment->vectors = embeddings;
+    segment->keywords.reserve(sentences.size());
+    segment->signatures.reserve(sentences.size());
+    for (size_t i = 0; i < sentences.size(); ++i) {
+        retrieval::normalize(segment->vectors.data() + i * dim, dim);
+        segment->keywords.push_back(extract_keywords(sentences[i]));
+        segment->signatures.push_back(simhash(sentences[i]));
+    }
+    segment->build_auxiliary();
+
+    std::vector<PassageInfo> passages(sentences.size());
+    for (size_t i = 0; i < sentences.size(); ++i) {
+        PassageInfo& info = passages[i];
+        info.text = sentences[i];
+        info.sentence_index = i < sentence_indices.size() ? sentence_indices[i] : static_cast<int32_t>(i);
+        if (source_refs && i < source_refs->size()) {
+            info.source_refs.assign((*source_refs)[i].begin(), (*source_refs)[i].end());
+        }
+    }
+    commit_segment(name, std::move(segment), std::move(passages));
+    return true;
+}
+
+bool CapsuleIndex::add_archive(const std::string& name, std::shared_ptr<CapsuleArchive> archive) {
+    if (name.empty() || !archive || archive->dim() <= 0) {
+        return false;
+    }
+
+    TRACE_SCOPE_ARG("retrieval_add_archive", static_cast<int64_t>(archive->passage_count()));
+
+    // Text is inflated once, block by block, for keywords and signatures
+    const int dim = archive->dim();
+    const size_t count = archive->passage_count();
+    auto segment = std::make_shared<IndexSegment>();
+    segment->dim = dim;
+    segment->vectors.resize(count * dim);
+    segment->keywords.resize(count);
+    segment->signatures.resize(count);
+    bool ok = archive->for_each_passage([&](size_t row, const std::string& text) {
+        archive->dequantize(row, segment->vectors.data() + row * dim);
+        retrieval::normalize(segment->vectors.data() + row * dim, dim);
+        segment->keywords[row] = extract_keywords(text);
+        segment->signatures[row] = simhash(text);
+    });
+    if (!ok) {
+        return false;
+    }
+    archive->release_vectors();
+    segment->build_auxiliary();
+
+    std::vector<PassageInfo> passages(count);
+    for (size_t i = 0; i < count; ++i) {
+        passages[i].sentence_index = archive->sentence_index(i);
+        passages[i].archive = archive;
+        passages[i].archive_row = static_cast<uint32_t>(i);
+    }
+    commit_segment(name, std::move(segment), std::move(passages));
+    return true;
+}
+
+void CapsuleIndex::commit_segment(const std::string& name, std::shared_ptr<IndexSegment> segment,
+                                  std::vector<PassageInfo> passages) {
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        remove_capsule_locked(name);
+
+        auto& ids = m_capsules[name];
+        ids.reserve(passages.size());
+        segment->ids.reserve(passages.size());
+        for (auto& passage : passages) {
+            uint32_t id = m_next_id++;
+            segment->ids.push_back(id);
+            ids.push_back(id);
+
+            passage.capsule = name;
+            m_passages[id] = std::move(passage);
+        }
+        m_tombstones.resize((m_next_id + 63) / 64, 0);
+        segment->update_id_range();
+
+        if (!segment->ids.empty()) {
+            m_segments.push_back(std::move(segment));
+        }
+        m_version++;
+    }
+
+    maybe_schedule_compaction();
+}
+
+bool CapsuleIndex::remove_capsule(const std::string& name) {
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        if (!m_capsules.count(name)) {
+            return false;
+        }
+        remove_capsule_locked(name);
+        m_version++;
+    }
+
+    maybe_schedule_compaction();
+    return true;
+}
+
+void CapsuleIndex::remove_capsule_locked(const std::string& name) {
+    auto it = m_capsules.find(name);
+    if (it == m_capsules.end()) {
+        return;
+    }
+    for (uint32_t id : it->second) {
+        tombstone_locked(id);
+        m_passages.erase(id);
+    }
+    m_capsules.erase(it);
+}
+
+void CapsuleIndex::clear() {
+    // Passage ids are never reused, so an in-flight compaction cannot
+    // resurrect rows from before the clear
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    for (const auto& entry : m_capsules) {
+        for (uint32_t id : entry.second) {
+            m_tombstones[id >> 6] |= 1ULL << (id & 63);
+        }
+    }
+    m_segments.clear();
+    m_passages.clear();
+    m_capsules.clear();
+    m_dead_count = 0;
+    m_version++;
+}
+
+bool CapsuleIndex::is_tombstoned(uint32_t passage_id) const {
+    return (m_tombstones[passage_id >> 6] >> (passage_id & 63)) & 1ULL;
+}
+
+void CapsuleIndex::tombstone_locked(uint32_t passage_id) {
+    if (!is_tombstoned(passage_id)) {
+        m_tombstones[passage_id >> 6] |= 1ULL << (passage_id & 63);
+        m_dead_count++;
+    }
+}
+
+std::vector<SearchHit> CapsuleIndex::search(const std::string& query,
+                                            const float* query_embedding,
+                                            int dim,
+                                            int max_results,
+                                            int* total_results,
+                                            const std::vector<std::string>* capsule_filter) const {
+    TRACE_SCOPE("retrieval_search");
+    std::string scope;
+    if (capsule_filter) {
+        std::vector<std::string> names = *capsule_filter;
+        std::sort(names.begin(), names.end());
+        scope.push_back('\x1e');
+        for (const auto& name : names) {
+            scope += name;
+            scope.push_back('\x1e');
+        }
+    }
+
+    std::vector<SearchHit> hits;
+    std::vector<uint64_t> signatures; // parallel to hits
+    int total = 0;
+    if (m_query_cache->lookup(query, dim, scope, m_version.load(), max_results, hits, total)) {
+        if (total_results) {
+            *total_results = total;
+        }
+        return hits;
+    }
+
+    std::vector<float> query_vec;
+    std::vector<uint64_t> query_code;
+    if (query_embedding && dim > 0) {
+        query_vec.assign(query_embedding, query_embedding + dim);
+        retrieval::normalize(query_vec.data(), dim);
+        query_code.resize(retrieval::code_words(dim));
+        retrieval::sign_quantize(query_vec.data(), dim, query_code.data());
+    }
+    const std::vector<std::string> query_words = extract_keywords(query);
+
+    uint64_t version = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        version = m_version.load();
+
+        // Compile the capsule filter into a bitmap over passage ids
+        std::unique_ptr<PassageBitmap> filter;
+        size_t searchable = m_passages.size();
+        if (capsule_filter) {
+            filter = std::make_unique<PassageBitmap>();
+            for (const auto& name : *capsule_filter) {
+                auto it = m_capsules.find(name);
+                if (it != m_capsules.end()) {
+                    filter->add_many(it->second);
+                }
+            }
+            searchable = filter->cardinality();
+        }
+        auto segment_excluded = [&](const IndexSegment& segment) {
+            return filter && !filter->intersects_range(segment.min_id, segment.max_id);
+        };
+        auto row_excluded = [&](uint32_t id) {
+            return is_tombstoned(id) || (filter && !filter->contains(id));
+        };
+
+        auto score_row = [&](const IndexSegment& segment, size_t row) {
+            uint32_t id = segment.ids[row];
+            if (row_excluded(id)) {
+                return;
+            }
+
+            float semantic = (!query_vec.empty() && segment.dim == dim)
+                ? retrieval::dot_product(query_vec.data(), segment.vectors.data() + row * segment.dim, dim)
+                : 0.0f;
+            float keyword = keyword_similarity(query_words, segment.keywords[row]);
+            float combined = semantic * kSemanticWeight + keyword * kKeywordWeight;
+
+            if (combined >= kSimilarityThreshold || keyword > kKeywordOnlyThreshold) {
+                SearchHit hit;
+                hit.passage_id = id;
+                hit.sentence_index = m_passages.at(id).sentence_index;
+                hit.score = combined;
+                hit.semantic_score = semantic;
+                hit.keyword_score = keyword;
+                hits.push_back(hit);
+                signatures.push_back(segment.signatures[row]);
+            }
+        };
+
+        const size_t candidates = m_prefilter_candidates.load();
+        const bool prefilter = !query_code.empty() &&
+                               searchable >= m_prefilter_min_passages.load() &&
+                               searchable > candidates;
+
+        if (searchable == 0) {
+            // Nothing to scan, e.g. a filter naming only unknown capsules
+        } else if (!prefilter) {
+            for (const auto& segment : m_segments) {
+                if (segment_excluded(*segment)) {
+                    continue;
+                }
+                for (size_t row = 0; row < segment->size(); ++row) {
+                    score_row(*segment, row);
+                }
+            }
+        } else {
+            // Stage 1: Hamming distance over every live sign code
+            struct Candidate {
+                int distance;
+                uint32_t segment;
+                uint32_t row;
+            };
+            std::vector<Candidate> ranked;
+            ranked.reserve(searchable);
+            const int words = static_cast<int>(query_code.size());
+            for (size_t s = 0; s < m_segments.size(); ++s) {
+                const IndexSegment& segment = *m_segments[s];
+                if (segment.dim != dim || segment_excluded(segment)) {
+                    continue;
+                }
+                for (size_t row = 0; row < segment.size(); ++row) {
+                    if (row_excluded(segment.ids[row])) {
+                        continue;
+                    }
+                    int distance = retrieval::hamming_distance(query_code.data(),
+                                                               segment.codes.data() + row * words, words);
+                    ranked.push_back({distance, static_cast<uint32_t>(s), static_cast<uint32_t>(row)});
+                }
+            }
+            size_t keep = std::min(ranked.size(), candidates);
+            std::nth_element(ranked.begin(), ranked.begin() + keep, ranked.end(),
+                             [](const Candidate& a, const Candidate& b) { return a.distance < b.distance; });
+            ranked.resize(keep);
+
+            // Exact keyword matches bypass the prefilter. A common word would
+            // pull much of the corpus back in, so rows are weighted by the
+            // rarity of the query words they contain and at most
+            // kKeywordBypassMaxRows of the heaviest are let through
+            std::vector<size_t> base(m_segments.size() + 1, 0);
+            for (size_t s = 0; s < m_segments.size(); ++s) {
+                base[s + 1] = base[s] + m_segments[s]->size();
+            }
+            std::vector<float> weight;
+            std::vector<Candidate> matched;
+            std::vector<const std::vector<uint32_t>*> word_rows(m_segments.size());
+            for (const auto& word : query_words) {
+                size_t frequency = 0;
+                for (size_t s = 0; s < m_segments.size(); ++s) {
+                    word_rows[s] = nullptr;
+                    if (m_segments[s]->dim != dim || segment_excluded(*m_segments[s])) {
+                        continue;
+                    }
+                    auto it = m_segments[s]->postings.find(word);
+                    if (it != m_segments[s]->postings.end()) {
+                        word_rows[s] = &it->second;
+                        frequency += it->second.size();
+                    }
+                }
+                if (frequency == 0) {
+                    continue;
+                }
+                if (weight.empty()) {
+                    weight.assign(base.back(), 0.0f);
+                }
+                const float rarity = std::log(1.0f + static_cast<float>(searchable) / frequency);
+                for (size_t s = 0; s < m_segments.size(); ++s) {
+                    if (!word_rows[s]) {
+                        continue;
+                    }
+                    for (uint32_t row : *word_rows[s]) {
+                        float& w = weight[base[s] + row];
+                        if (w == 0.0f) {
+                            if (row_excluded(m_segments[s]->ids[row])) {
+                                continue;
+                            }
+                            matched.push_back({0, static_cast<uint32_t>(s), row});
+                        }
+                        w += rarity;
+                    }
+                }
+            }
+            if (matched.size() > kKeywordBypassMaxRows) {
+                auto heavier = [&](const Candidate& a, const Candidate& b) {
+                    return weight[base[a.segment] + a.row] > weight[base[b.segment] + b.row];
+                };
+                std::nth_element(matched.begin(), matched.begin() + kKeywordBypassMaxRows,
+                                 matched.end(), heavier);
+                matched.resize(kKeywordBypassMaxRows);
+            }
+            ranked.insert(ranked.end(), matched.begin(), matched.end());
+            std::sort(ranked.begin(), ranked.end(), [](const Candidate& a, const Candidate& b) {
+                return a.segment != b.segment ? a.segment < b.segment : a.row < b.row;
+            });
+            ranked.erase(std::unique(ranked.begin(), ranked.end(),
+                                     [](const Candidate& a, const Candidate& b) {
+                                         return a.segment == b.segment && a.row == b.row;
+                                     }),
+                         ranked.end());
+
+            // Stage 2: exact float rescoring of the survivors
+            for (const auto& candidate : ranked) {
+                score_row(*m_segments[candidate.segment], candidate.row);
+            }
+        }
+    }
+
+    total = static_cast<int>(hits.size());
+    if (total_results) {
+        *total_results = total;
+    }
+
+    size_t k = std::min(hits.size(), static_cast<size_t>(std::max(0, max_results)));
+    hits = diversify(hits, signatures, k, m_mmr_lambda.load());
+    m_query_cache->store(query, dim, scope, version, hits, total);
+    return hits;
+}
+
+std::vector<SearchHit> CapsuleIndex::diversify(const std::vector<SearchHit>& hits,
+                                               const std::vector<uint64_t>& signatures,
+                                               size_t k, float lambda) {
+    // Rank the pool by relevance first
+    std::vector<size_t> pool(hits.size());
+    for (size_t i = 0; i < pool.size(); ++i) {
+        pool[i] = i;
+    }
+    size_t pool_size = std::min(hits.size(), lambda >= 1.0f ? k : k * kMmrPoolFactor);
+    auto by_score = [&](size_t a, size_t b) { return hits[a].score > hits[b].score; };
+    std::partial_sort(pool.begin(), pool.begin() + pool_size, pool.end(), by_score);
+    pool.resize(pool_size);
+
+    // Greedy MMR: relevance minus redundancy with what is already chosen.
+    // Near duplicates sit within 7 SimHash bits and unrelated texts 13 or
+    // more, so redundancy falls to zero at 16 bits.
+    std::vector<SearchHit> selected;
+    std::vector<float> redundancy(pool.size(), 0.0f);
+    std::vector<bool> taken(pool.size(), false);
+    selected.reserve(k);
+    while (selected.size() < k) {
+        size_t best = pool.size();
+        float best_value = 0.0f;
+        for (size_t i = 0; i < pool.size(); ++i) {
+            if (taken[i]) {
+                continue;
+            }
+            float value = lambda * hits[pool[i]].score - (1.0f - lambda) * redundancy[i];
+            if (best == pool.size() || value > best_value) {
+                best = i;
+                best_value = value;
+            }
+        }
+        taken[best] = true;
+        selected.push_back(hits[pool[best]]);
+        for (size_t i = 0; i < pool.size(); ++i) {
+            if (!taken[i]) {
+                int distance = simhash_distance(signatures[pool[i]], signatures[pool[best]]);
+                redundancy[i] = std::max(redundancy[i], std::max(0.0f, 1.0f - distance / 16.0f));
+            }
+        }
+    }
+    return selected;
+}
+
+bool CapsuleIndex::get_passage(uint32_t passage_id, std::string& text, std::string& source) const {
+    std::shared_ptr<const CapsuleArchive> archive;
+    uint32_t row = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        auto it = m_passages.find(passage_id);
+        if (it == m_passages.end()) {
+            return false;
+        }
+        source = it->second.capsule;
+        if (!it->second.archive) {
+            text = it->second.text;
+            return true;
+        }
+        archive = it->second.archive;
+        row = it->second.archive_row;
+    }
+    // Inflate outside the index lock; the archive serializes its own reads
+    return archive->passage_text(row, text);
+}
+
+void CapsuleIndex::set_prefilter(size_t min_passages, size_t candidates) {
+    m_prefilter_min_passages = min_passages;
+    m_prefilter_candidates = std::max<size_t>(1, candidates);
+    m_query_cache->clear();
+}
+
+void CapsuleIndex::set_diversity(float lambda) {
+    m_mmr_lambda = std::max(0.0f, std::min(1.0f, lambda));
+    m_query_cache->clear();
+}
+
+void CapsuleIndex::set_query_cache_capacity(size_t capacity) {
+    m_query_cache->set_capacity(capacity);
+}
+
+uint64_t CapsuleIndex::query_cache_hits() const {
+    return m_query_cache->hit_count();
+}
+
+uint64_t CapsuleIndex::query_cache_misses() const {
+    return m_query_cache->miss_count();
+}
+
+size_t CapsuleIndex::passage_count() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_passages.size();
+}
+
+size_t CapsuleIndex::segment_count() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_segments.size();
+}
+
+uint64_t CapsuleIndex::memory_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    uint64_t bytes = m_tombstones.capacity() * sizeof(uint64_t);
+
+    for (const auto& segment : m_segments) {
+        bytes += segment->ids.capacity() * sizeof(uint32_t);
+        bytes += segment->vectors.capacity() * sizeof(float);
+        bytes += segment->codes.capacity() * sizeof(uint64_t);
+        bytes += segment->signatures.capacity() * sizeof(uint64_t);
+        for (const auto& words : segment->keywords) {
+            bytes += words.capacity() * sizeof(std::string);
+            for (const auto& word : words) {
+                bytes += word.capacity() + 1;
+            }
+        }
+        for (const auto& posting : segment->postings) {
+            bytes += sizeof(posting) + posting.first.capacity() + posting.second.capacity() * sizeof(uint32_t);
+        }
+    }
+
+    std::unordered_set<const CapsuleArchive*> archives;
+    for (const auto& entry : m_passages) {
+        const PassageInfo& info = entry.second;
+        bytes += sizeof(entry) + info.text.capacity() + info.capsule.capacity()
+            + info.source_refs.capacity() * sizeof(int32_t);
+        if (info.archive && archives.insert(info.archive.get()).second) {
+            bytes += info.archive->memory_bytes();
+        }
+    }
+    for (const auto& entry : m_capsules) {
+        bytes += entry.first.capacity() + entry.second.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+std::vector<std::string> CapsuleIndex::capsule_names() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    std::vector<std::string> names;
+    names.reserve(m_capsules.size());
+    for (const auto& entry : m_capsules) {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
+// The one rule for which segments compact() rewrites; the trigger uses it
+// too, so a scheduled compaction always has work to do
+bool CapsuleIndex::should_compact_locked(const IndexSegment& segment) const {
+    if (segment.size() < kSmallSegmentRows) {
+        return true;
+    }
+    if (m_dead_count * 2 <= segment.size()) {
+        return false; // cannot be mostly dead; skip the scan
+    }
+    size_t dead = 0;
+    for (uint32_t id : segment.ids) {
+        dead += is_tombstoned(id) ? 1 : 0;
+    }
+    return dead * 2 > segment.size();
+}
+
+bool CapsuleIndex::needs_compaction_locked() const {
+    size_t small_segments = 0;
+    for (const auto& segment : m_segments) {
+        if (segment->size() < kSmallSegmentRows) {
+            small_segments++;
+        } else if (should_compact_locked(*segment)) {
+            return true;
+        }
+    }
+    return small_segments > kMaxSmallSegments;
+}
+
+void CapsuleIndex::maybe_schedule_compaction() {
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        if (!needs_compaction_locked()) {
+            return;
+        }
+    }
+    if (m_compacting.exchange(true)) {
+        return;
+    }
+    if (m_compactor.joinable()) {
+        m_compactor.join();
+    }
+    m_compactor = std::thread([this]() {
+        compact();
+        m_compacting = false;
+    });
+}
+
+bool CapsuleIndex::get_passage_refs(uint32_t passage_id, std::vector<int32_t>& refs) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_passages.find(passage_id);
+    if (it == m_passages.end()) {
+        return false;
+    }
+    refs = it->second.archive ? it->second.archive->source_refs(it->second.archive_row)
+                              : it->second.source_refs;
+    if (refs.empty()) {
+        refs.push_back(it->second.sentence_index);
+    }
+    return true;
+}
+
+void CapsuleIndex::compact() {
+    TRACE_SCOPE("retrieval_compact");
+    std::vector<std::shared_ptr<const IndexSegment>> inputs;
+    std::vector<uint64_t> tombstones;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        for (const auto& segment : m_segments) {
+            if (should_compact_locked(*segment)) {
+                inputs.push_back(segment);
+            }
+        }
+        tombstones = m_tombstones;
+    }
+    if (inputs.empty()) {
+        return;
+    }
+
+    // Merge per embedding dimension; segments are immutable so no lock is
+    // needed while copying rows. Passages removed after the tombstone snapshot
+    // stay filtered by the live bitmap.
+    std::unordered_map<int, std::shared_ptr<IndexSegment>> merged;
+    size_t dropped = 0;
+    for (const auto& segment : inputs) {
+        auto& out = merged[segment->dim];
+        if (!out) {
+            out = std::make_shared<IndexSegment>();
+            out->dim = segment->dim;
+        }
+        for (size_t row = 0; row < segment->size(); ++row) {
+            uint32_t id = segment->ids[row];
+            if ((tombstones[id >> 6] >> (id & 63)) & 1ULL) {
+                dropped++;
+                continue;
+            }
+            out->ids.push_back(id);
+            out->vectors.insert(out->vectors.end(),
+                                segment->vectors.begin() + row * segment->dim,
+                                segment->vectors.begin() + (row + 1) * segment->dim);
+            out->keywords.push_back(segment->keywords[row]);
+            out->signatures.push_back(segment->signatures[row]);
+        }
+    }
+    for (auto& entry : merged) {
+        entry.second->build_auxiliary();
+        entry.second->update_id_range();
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    for (const auto& segment : inputs) {
+        if (std::find(m_segments.begin(), m_segments.end(), segment) == m_segments.end()) {
+            return; // index was cleared while merging
+        }
+    }
+    auto is_input = [&](const std::shared_ptr<const IndexSegment>& segment) {
+        return std::find(inputs.begin(), inputs.end(), segment) != inputs.end();
+    };
+    m_segments.erase(std::remove_if(m_segments.begin(), m_segments.end(), is_input), m_segments.end());
+    for (auto& entry : merged) {
+        if (!entry.second->ids.empty()) {
+            m_segments.push_back(std::move(entry.second));
+        }
+    }
+    m_dead_count -= std::min(m_dead_count, dropped);
+}
@@ -0,0 +1,156 @@
+#ifndef CAPSULE_INDEX_H
+#define CAPSULE_INDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <shared_mutex>
+#include <unordered_map>
+#include <cstdint>
+
+struct SearchHit {
+    uint32_t passage_id = 0;
+    int32_t sentence_index = 0;
+    float score = 0.0f;
+    float semantic_score = 0.0f;
+    float keyword_score = 0.0f;
+};
+
+class QueryCache;
+class PassageBitmap;
+class CapsuleArchive;
+
+// Immutable block of passages. A freshly added capsule is one segment;
+// background compaction merges small segments into larger ones.
+struct IndexSegment {
+    int dim = 0;
+    std::vector<uint32_t> ids;                      // global passage ids
+    std::vector<float> vectors;                     // L2-normalized, row-major
+    std::vector<std::vector<std::string>> keywords; // meaningful words per passage
+
+    // 1-bit sign codes (dim/8 bytes per passage) for the Hamming prefilter,
+    // and keyword postings so exact matches on rare keywords survive it
+    int code_words = 0;
+    std::vector<uint64_t> codes;
+    std::unordered_map<std::string, std::vector<uint32_t>> postings;
+
+    // SimHash of each passage text, used to diversify results
+    std::vector<uint64_t> signatures;
+
+    // Id bounds let filtered searches skip whole segments
+    uint32_t min_id = 0;
+    uint32_t max_id = 0;
+
+    size_t size() const { return ids.size(); }
+    void build_auxiliary();
+    void update_id_range();
+};
+
+class CapsuleIndex {
+public:
+    CapsuleIndex();
+    ~CapsuleIndex();
+
+    // Adds (or replaces) a capsule as a new segment. Cost is proportional to
+    // the capsule itself; existing segments are untouched. source_refs lists
+    // every source sentence a passage stands for when duplicates were collapsed.
+    bool add_capsule(const std::string& name,
+                     const std::vector<std::string>& sentences,
+                     const std::vector<int>& sentence_indices,
+                     const std::vector<float>& embeddings,
+                     int dim,
+                     const std::vector<std::vector<int>>* source_refs = nullptr);
+
+    // Adds a compressed capsule. Vectors are dequantized into the segment
+    // and the archive's int8 copies are released; passage text stays
+    // compressed in the archive and only the block holding a requested
+    // passage is inflated.
+    bool add_archive(const std::string& name, std::shared_ptr<CapsuleArchive> archive);
+
+    // Tombstones every passage of the capsule. Storage is reclaimed later by compaction.
+    bool remove_capsule(const std::string& name);
+    void clear();
+
+    // capsule_filter restricts the search to the named capsules; it is
+    // compiled into a passage bitmap that both the scan and the prefilter use
+    std::vector<SearchHit> search(const std::string& query,
+                                  const float* query_embedding,
+                                  int dim,
+                                  int max_results,
+                                  int* total_results = nullptr,
+                                  const std::vector<std::string>* capsule_filter = nullptr) const;
+
+    bool get_passage(uint32_t passage_id, std::string& text, std::string& source) const;
+    bool get_passage_refs(uint32_t passage_id, std::vector<int32_t>& refs) const;
+
+    // Merges small or mostly-deleted segments. Runs on the caller's thread;
+    // maybe_schedule_compaction() runs it in the background.
+    void compact();
+
+    uint64_t version() const { return m_version.load(); }
+    size_t passage_count() const;
+    size_t segment_count() const;
+    std::vector<std::string> capsule_names() const;
+
+    // Approximate heap footprint of segments, passage text and archive tables
+    uint64_t memory_bytes() const;
+
+    // Above this many live passages, search first ranks every passage by
+    // Hamming distance of sign codes and only rescores the closest
+    // candidates (plus exact keyword matches) in float
+    void set_prefilter(size_t min_passages, size_t candidates);
+
+    // MMR trade-off between relevance and redundancy; 1 ranks by relevance only
+    void set_diversity(float lambda);
+
+    // Repeated queries against an unchanged capsule set are served from an LRU cache
+    void set_query_cache_capacity(size_t capacity);
+    uint64_t query_cache_hits() const;
+    uint64_t query_cache_misses() const;
+
+    static std::vector<std::string> extract_keywords(const std::string& text);
+
+private:
+    struct PassageInfo {
+        std::string text;
+        std::string capsule;
+        int32_t sentence_index = 0;
+        std::vector<int32_t> source_refs;
+
+        // Set for archived capsules, whose text is read on demand
+        std::shared_ptr<const CapsuleArchive> archive;
+        uint32_t archive_row = 0;
+    };
+
+    mutable std::shared_mutex m_mutex;
+    std::vector<std::shared_ptr<const IndexSegment>> m_segments;
+    std::unordered_map<uint32_t, PassageInfo> m_passages;
+    std::unordered_map<std::string, std::vector<uint32_t>> m_capsules;
+    std::vector<uint64_t> m_tombstones; // bit per global passage id
+    size_t m_dead_count = 0;
+    uint32_t m_next_id = 0;
+    std::atomic<uint64_t> m_version{0};
+    std::unique_ptr<QueryCache> m_query_cache;
+    std::atomic<size_t> m_prefilter_min_passages;
+    std::atomic<size_t> m_prefilter_candidates;
+    std::atomic<float> m_mmr_lambda;
+
+    std::thread m_compactor;
+    std::atomic<bool> m_compacting{false};
+
+    static std::vector<SearchHit> diversify(const std::vector<SearchHit>& hits,
+                                            const std::vector<uint64_t>& signatures,
+                                            size_t k, float lambda);
+    void commit_segment(const std::string& name, std::shared_ptr<IndexSegment> segment,
+                        std::vector<PassageInfo> passages);
+    bool is_tombstoned(uint32_t passage_id) const;
+    void tombstone_locked(uint32_t passage_id);
+    void remove_capsule_locked(const std::string& name);
+    bool should_compact_locked(const IndexSegment& segment) const;
+    bool needs_compaction_locked() const;
+    void maybe_schedule_compaction();
+};
+
+#endif // CAPSULE_INDEX_H
@@ -0,0 +1,285 @@
+#include "capsule_ingest.h"
+#include "json_reader.h"
+#include "near_duplicate.h"
+#include "trace.h"
+#include <fstream>
+#include <sstream>
+#include <cctype>
+
+namespace {
+
+// Accumulates cleaned sentences into a passage until the token budget is hit
+class PassagePacker {
+public:
+    PassagePacker(IngestedCapsule& out, int max_tokens)
+        : m_out(out), m_max_tokens(max_tokens) {}
+
+    // Returns the slot of the passage the sentence went into
+    int add(const std::string& sentence, int tokens, int sentence_index, const float* embedding) {
+        if (!m_text.empty() && m_tokens + tokens > m_max_tokens) {
+            flush();
+        }
+        const int slot = static_cast<int>(m_out.passages.size());
+        add_ref(slot, sentence_index);
+        if (m_text.empty()) {
+            m_first_index = sentence_index;
+            m_sum.assign(m_out.dim, 0.0f);
+        } else {
+            m_text.push_back(' ');
+        }
+        m_text += sentence;
+        m_tokens += tokens;
+        m_count++;
+        for (int d = 0; d < m_out.dim; ++d) {
+            m_sum[d] += embedding[d];
+        }
+        return slot;
+    }
+
+    void add_ref(int slot, int sentence_index) {
+        if (m_out.source_refs.size() <= static_cast<size_t>(slot)) {
+            m_out.source_refs.resize(slot + 1);
+        }
+        auto& refs = m_out.source_refs[slot];
+        if (refs.empty() || refs.back() != sentence_index) {
+            refs.push_back(sentence_index);
+        }
+    }
+
+    void flush() {
+        if (m_text.empty()) {
+            return;
+        }
+        // The passage vector is the mean of its sentences; the index normalizes it
+        for (float& v : m_sum) {
+            v /= static_cast<float>(m_count);
+        }
+        m_out.passages.push_back(std::move(m_text));
+        m_out.sentence_indices.push_back(m_first_index);
+        m_out.embeddings.insert(m_out.embeddings.end(), m_sum.begin(), m_sum.end());
+        m_text.clear();
+        m_tokens = 0;
+        m_count = 0;
+    }
+
+private:
+    IngestedCapsule& m_out;
+    int m_max_tokens;
+    std::string m_text;
+    std::vector<float> m_sum;
+    int m_tokens = 0;
+    int m_count = 0;
+    int m_first_index = 0;
+};
+
+} // namespace
+
+CapsuleIngestor::CapsuleIngestor(const IngestOptions& options, TokenCounter token_counter)
+    : m_options(options), m_token_counter(std::move(token_counter)) {}
+
+std::string CapsuleIngestor::clean_sentence(const std::string& raw) {
+    // Collapse every whitespace run (including newlines) to one space and trim
+    std::string cleaned;
+    cleaned.reserve(raw.size());
+    bool pending_space = false;
+    for (unsigned char c : raw) {
+        if (std::isspace(c)) {
+            pending_space = !cleaned.empty();
+            continue;
+        }
+        if (pending_space) {
+            cleaned.push_back(' ');
+            pending_space = false;
+        }
+        cleaned.push_back(static_cast<char>(c));
+    }
+    return cleaned;
+}
+
+int CapsuleIngestor::count_words(const std::string& cleaned) {
+    if (cleaned.empty()) {
+        return 0;
+    }
+    int words = 1;
+    for (char c : cleaned) {
+        if (c == ' ') {
+            words++;
+        }
+    }
+    return words;
+}
+
+int CapsuleIngestor::estimate_tokens(const std::string& text) {
+    // Roughly four tokens per three words for BPE vocabularies
+    return (count_words(clean_sentence(text)) * 4 + 2) / 3;
+}
+
+int CapsuleIngestor::count_tokens(const std::string& text) const {
+    if (m_token_counter) {
+        int tokens = m_token_counter(text);
+        if (tokens > 0) {
+            return tokens;
+        }
+    }
+    return estimate_tokens(text);
+}
+
+bool CapsuleIngestor::ingest_file(const std::string& file_path, IngestedCapsule& out) {
+    std::ifstream file(file_path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    // One read into a buffer sized from the file, with no intermediate copy
+    const std::streamoff length = file.tellg();
+    if (length < 0) {
+        return false;
+    }
+    std::string content(static_cast<size_t>(length), '\0');
+    file.seekg(0);
+    if (!file.read(&content[0], length)) {
+        return false;
+    }
+    return ingest_buffer(content.data(), content.size(), out);
+}
+
+bool CapsuleIngestor::ingest_buffer(const char* data, size_t length, IngestedCapsule& out) {
+    TRACE_SCOPE("capsule_ingest");
+    out = IngestedCapsule();
+
+    JsonReader reader(data, length);
+    std::vector<float> sentence_embeddings;
+    int embedding_rows = 0;
+    bool have_embeddings = false;
+    bool have_sentences = false;
+
+    // Sentences are cleaned and packed as they are parsed; only a file that
+    // lists sentences before embeddings needs them buffered
+    std::vector<std::string> pending_sentences;
+    int sentence_count = 0;
+    PassagePacker packer(out, m_options.max_passage_tokens);
+    NearDuplicateIndex duplicates(m_options.duplicate_distance);
+
+    auto process = [&](const std::string& raw, int index) {
+        out.sentences_read++;
+        std::string cleaned = clean_sentence(raw);
+        int words = count_words(cleaned);
+        if (words < m_options.min_words) {
+            out.sentences_dropped++;
+            return;
+        }
+
+        // A near-duplicate only adds a source reference to the passage
+        // holding the sentence it repeats
+        uint64_t signature = 0;
+        if (m_options.duplicate_distance >= 0) {
+            signature = simhash(cleaned);
+            int slot = duplicates.find(signature);
+            if (slot >= 0) {
+                packer.add_ref(slot, index);
+                out.sentences_collapsed++;
+                return;
+            }
+        }
+
+        const float* embedding = sentence_embeddings.data() + static_cast<size_t>(index) * out.dim;
+        int tokens = count_tokens(cleaned);
+        if (tokens <= m_options.max_passage_tokens) {
+            int slot = packer.add(cleaned, tokens, index, embedding);
+            if (m_options.duplicate_distance >= 0) {
+                duplicates.add(signature, slot);
+            }
+            return;
+        }
+
+        // Oversized sentence: split into equal word runs that share its embedding
+        int pieces = (tokens + m_options.max_passage_tokens - 1) / m_options.max_passage_tokens;
+        int words_per_piece = (words + pieces - 1) / pieces;
+        std::istringstream iss(cleaned);
+        std::string word, piece;
+        int in_piece = 0;
+        packer.flush();
+        if (m_options.duplicate_distance >= 0) {
+            duplicates.add(signature, static_cast<int>(out.passages.size()));
+        }
+        while (iss >> word) {
+            piece += piece.empty() ? word : " " + word;
+            if (++in_piece == words_per_piece) {
+                packer.add(piece, m_options.max_passage_tokens, index, embedding);
+                packer.flush();
+                piece.clear();
+                in_piece = 0;
+            }
+        }
+        if (!piece.empty()) {
+            packer.add(piece, count_tokens(piece), index, embedding);
+        }
+    };
+
+    std::string key;
+    if (!reader.begin_object()) {
+        return false;
+    }
+
+    while (reader.next_key(key)) {
+        if (key == "embeddings") {
+            if (!reader.begin_array()) {
+                return false;
+            }
+            while (reader.next_element()) {
+                if (!reader.begin_array()) {
+                    return false;
+                }
+                int row_dim = 0;
+                double value;
+                while (reader.next_element()) {
+                    if (!reader.read_number(value)) {
+                        return false;
+                    }
+                    sentence_embeddings.push_back(static_cast<float>(value));
+                    row_dim++;
+                }
+                if (embedding_rows == 0) {
+                    out.dim = row_dim;
+                } else if (row_dim != out.dim) {
+                    return false;
+                }
+                embedding_rows++;
+            }
+            have_embeddings = true;
+        } else if (key == "sentences") {
+            if (!reader.begin_array()) {
+                return false;
+            }
+            std::string sentence;
+            while (reader.next_element()) {
+                if (!reader.read_string(sentence)) {
+                    return false;
+                }
+                if (have_embeddings) {
+                    if (sentence_count >= embedding_rows) {
+                        return false;
+                    }
+                    process(sentence, sentence_count);
+                } else {
+                    pending_sentences.push_back(std::move(sentence));
+                }
+                sentence_count++;
+            }
+            have_sentences = true;
+        } else if (!reader.skip_value()) {
+            return false;
+        }
+    }
+
+    if (reader.failed() || !have_embeddings || !have_sentences ||
+        embedding_rows != sentence_count || out.dim <= 0) {
+        return false;
+    }
+
+    for (size_t i = 0; i < pending_sentences.size(); ++i) {
+        process(pending_sentences[i], static_cast<int>(i));
+    }
+    packer.flush();
+    out.source_refs.resize(out.passages.size());
+    return true;
+}
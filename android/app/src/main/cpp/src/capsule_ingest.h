@@ -0,0 +1,53 @@
+#ifndef CAPSULE_INGEST_H
+#define CAPSULE_INGEST_H
+
+#include <string>
+#include <vector>
+#include <functional>
+
+struct IngestOptions {
+    int min_words = 4;             // shorter sentences are dropped
+    int max_passage_tokens = 64;   // consecutive sentences are packed up to this budget
+    int duplicate_distance = 7;    // SimHash bits; near-duplicate sentences collapse, -1 keeps all
+};
+
+// Passages ready to be added to the CapsuleIndex as one segment
+struct IngestedCapsule {
+    std::vector<std::string> passages;
+    std::vector<int> sentence_indices; // index of the first source sentence
+    std::vector<std::vector<int>> source_refs; // every source sentence, duplicates included
+    std::vector<float> embeddings;     // one row per passage
+    int dim = 0;
+    int sentences_read = 0;
+    int sentences_dropped = 0;
+    int sentences_collapsed = 0;
+};
+
+using TokenCounter = std::function<int(const std::string&)>;
+
+// Reads a capsule JSON file ({"embeddings": [[...]], "sentences": [...]}) in
+// one pass, cleans whitespace, drops short sentences, collapses near-duplicate
+// sentences into the passage that already holds them and packs the rest into
+// token-bounded passages. Collapsing stays within the capsule, so removing
+// or filtering one capsule never touches another's text; repeats across
+// capsules are kept out of the same results by the MMR pass in search.
+class CapsuleIngestor {
+public:
+    explicit CapsuleIngestor(const IngestOptions& options = IngestOptions(),
+                             TokenCounter token_counter = nullptr);
+
+    bool ingest_file(const std::string& file_path, IngestedCapsule& out);
+    bool ingest_buffer(const char* data, size_t length, IngestedCapsule& out);
+
+    static std::string clean_sentence(const std::string& raw);
+    static int count_words(const std::string& cleaned);
+    static int estimate_tokens(const std::string& text);
+
+private:
+    IngestOptions m_options;
+    TokenCounter m_token_counter;
+
+    int count_tokens(const std::string& text) const;
+};
+
+#endif // CAPSULE_INGEST_H
@@ -0,0 +1,187 @@
+#include "context_packer.h"
+#include "capsule_index.h"
+#include <algorithm>
+#include <cctype>
+#include <set>
+
+namespace {
+
+struct Piece {
+    std::string text;
+    std::vector<int32_t> tokens;
+};
+
+std::string fold(const std::string& text) {
+    std::string folded;
+    bool pending_space = false;
+    for (unsigned char c : text) {
+        if (std::isspace(c)) {
+            pending_space = !folded.empty();
+            continue;
+        }
+        if (pending_space) {
+            folded.push_back(' ');
+            pending_space = false;
+        }
+        folded.push_back(static_cast<char>(std::tolower(c)));
+    }
+    return folded;
+}
+
+float jaccard(const std::set<std::string>& a, const std::set<std::string>& b) {
+    if (a.empty() || b.empty()) {
+        return 0.0f;
+    }
+    size_t shared = 0;
+    for (const auto& word : a) {
+        shared += b.count(word);
+    }
+    return static_cast<float>(shared) / static_cast<float>(a.size() + b.size() - shared);
+}
+
+} // namespace
+
+ContextPacker::ContextPacker(Tokenizer tokenizer) : m_tokenizer(std::move(tokenizer)) {}
+
+std::vector<std::string> ContextPacker::split_sentences(const std::string& text) {
+    std::vector<std::string> sentences;
+    std::string current;
+    for (size_t i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '\n') {
+            if (!current.empty()) {
+                sentences.push_back(current);
+                current.clear();
+            }
+            continue;
+        }
+        current.push_back(c);
+        bool terminal = c == '.' || c == '!' || c == '?';
+        if (terminal && (i + 1 == text.size() || std::isspace(static_cast<unsigned char>(text[i + 1])))) {
+            sentences.push_back(current);
+            current.clear();
+            while (i + 1 < text.size() && text[i + 1] == ' ') {
+                i++;
+            }
+        }
+    }
+    if (!current.empty()) {
+        sentences.push_back(current);
+    }
+    return sentences;
+}
+
+PackedContext ContextPacker::pack(const std::vector<PackCandidate>& candidates, const PackOptions& options) const {
+    PackedContext packed;
+    if (candidates.empty() || options.token_budget <= 0) {
+        return packed;
+    }
+
+    // Tokenize every candidate once, sentence by sentence
+    std::vector<std::vector<Piece>> sentences(candidates.size());
+    std::vector<int> total_tokens(candidates.size(), 0);
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        bool first = true;
+        for (const auto& sentence : split_sentences(candidates[i].text)) {
+            Piece piece;
+            piece.text = first ? sentence : " " + sentence;
+            piece.tokens = m_tokenizer(piece.text);
+            total_tokens[i] += static_cast<int>(piece.tokens.size());
+            sentences[i].push_back(std::move(piece));
+            first = false;
+        }
+    }
+
+    const std::vector<int32_t> separator_tokens = m_tokenizer(options.separator);
+    const int separator_cost = static_cast<int>(separator_tokens.size());
+
+    std::vector<size_t> order(candidates.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        float da = candidates[a].score / std::max(1, total_tokens[a]);
+        float db = candidates[b].score / std::max(1, total_tokens[b]);
+        return da > db;
+    });
+
+    struct Selection {
+        size_t candidate;
+        size_t sentence_count;
+    };
+    std::vector<Selection> selections;
+    std::vector<std::set<std::string>> selected_words;
+    std::vector<std::string> selected_folded;
+    int remaining = options.token_budget;
+
+    for (size_t index : order) {
+        if (sentences[index].empty()) {
+            continue;
+        }
+
+        std::string folded;
+        std::set<std::string> words;
+        if (options.dedup != DedupPolicy::None) {
+            folded = fold(candidates[index].text);
+            std::vector<std::string> keywords = CapsuleIndex::extract_keywords(candidates[index].text);
+            words.insert(keywords.begin(), keywords.end());
+            bool duplicate = std::find(selected_folded.begin(), selected_folded.end(), folded) != selected_folded.end();
+            if (!duplicate && options.dedup == DedupPolicy::Near) {
+                for (const auto& other : selected_words) {
+                    if (jaccard(words, other) >= options.near_duplicate_jaccard) {
+                        duplicate = true;
+                        break;
+                    }
+                }
+            }
+            if (duplicate) {
+                continue;
+            }
+        }
+
+        int cost = selections.empty() ? 0 : separator_cost;
+        size_t kept = 0;
+        for (const auto& piece : sentences[index]) {
+            int piece_cost = static_cast<int>(piece.tokens.size());
+            if (cost + piece_cost > remaining) {
+                break;
+            }
+            cost += piece_cost;
+            kept++;
+        }
+        if (kept == 0) {
+            continue;
+        }
+
+        selections.push_back({index, kept});
+        remaining -= cost;
+        // Only passages that made it in shadow their duplicates
+        if (options.dedup != DedupPolicy::None) {
+            selected_folded.push_back(std::move(folded));
+            selected_words.push_back(std::move(words));
+        }
+        if (remaining <= separator_cost) {
+            break;
+        }
+    }
+
+    // Present passages in retrieval order rather than packing order
+    std::stable_sort(selections.begin(), selections.end(), [&](const Selection& a, const Selection& b) {
+        return candidates[a.candidate].score > candidates[b.candidate].score;
+    });
+
+    for (const auto& selection : selections) {
+        if (!packed.chosen.empty()) {
+            packed.text += options.separator;
+            packed.token_ids.insert(packed.token_ids.end(), separator_tokens.begin(), separator_tokens.end());
+        }
+        for (size_t s = 0; s < selection.sentence_count; ++s) {
+            const Piece& piece = sentences[selection.candidate][s];
+            packed.text += piece.text;
+            packed.token_ids.insert(packed.token_ids.end(), piece.tokens.begin(), piece.tokens.end());
+        }
+        packed.chosen.push_back(static_cast<int>(selection.candidate));
+    }
+    packed.tokens_used = static_cast<int>(packed.token_ids.size());
+    return packed;
+}
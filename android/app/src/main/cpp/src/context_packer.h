@@ -0,0 +1,52 @@
+#ifndef CONTEXT_PACKER_H
+#define CONTEXT_PACKER_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+enum class DedupPolicy {
+    None = 0,
+    Exact = 1, // identical after whitespace/case folding
+    Near = 2   // keyword-set Jaccard similarity above a threshold
+};
+
+struct PackCandidate {
+    std::string text;
+    float score = 0.0f;
+};
+
+struct PackOptions {
+    int token_budget = 256;
+    DedupPolicy dedup = DedupPolicy::Near;
+    float near_duplicate_jaccard = 0.7f;
+    std::string separator = " | ";
+};
+
+struct PackedContext {
+    std::string text;
+    std::vector<int32_t> token_ids;  // tokenization of text, piece by piece
+    std::vector<int> chosen;         // candidate indices, in output order
+    int tokens_used = 0;
+};
+
+// Chooses retrieval passages for a prompt under a token budget. Passages
+// are taken greedily by score per token and trimmed at sentence boundaries
+// when only part of one fits. Every piece is tokenized exactly once and the
+// ids are returned with the text so the prompt never needs re-tokenizing.
+class ContextPacker {
+public:
+    using Tokenizer = std::function<std::vector<int32_t>(const std::string&)>;
+
+    explicit ContextPacker(Tokenizer tokenizer);
+
+    PackedContext pack(const std::vector<PackCandidate>& candidates, const PackOptions& options) const;
+
+    static std::vector<std::string> split_sentences(const std::string& text);
+
+private:
+    Tokenizer m_tokenizer;
+};
+
+#endif // CONTEXT_PACKER_H
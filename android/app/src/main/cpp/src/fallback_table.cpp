@@ -0,0 +1,289 @@
+#include "fallback_table.h"
+#include "json_reader.h"
+#include "calculator.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+using Responses = std::vector<std::pair<std::string, std::string>>;
+
+const std::string& pick_response(const Responses& responses, const std::string& language) {
+    static const std::string empty;
+    for (const auto& response : responses) {
+        if (response.first == language) {
+            return response.second;
+        }
+    }
+    for (const auto& response : responses) {
+        if (response.first == "en") {
+            return response.second;
+        }
+    }
+    return responses.empty() ? empty : responses.front().second;
+}
+
+bool read_responses(JsonReader& reader, Responses& out) {
+    std::string language, text;
+    if (!reader.begin_object()) {
+        return false;
+    }
+    while (reader.next_key(language)) {
+        if (!reader.read_string(text)) {
+            return false;
+        }
+        out.emplace_back(language, text);
+    }
+    return !reader.failed();
+}
+
+// Either a flat list of keywords (one group) or a list of groups
+bool read_keywords(JsonReader& reader, std::vector<std::vector<std::string>>& groups) {
+    if (!reader.begin_array()) {
+        return false;
+    }
+    std::vector<std::string> flat;
+    std::string keyword;
+    while (reader.next_element()) {
+        if (reader.peek() == '"') {
+            if (!reader.read_string(keyword)) {
+                return false;
+            }
+            flat.push_back(keyword);
+            continue;
+        }
+        std::vector<std::string> group;
+        if (!reader.begin_array()) {
+            return false;
+        }
+        while (reader.next_element()) {
+            if (!reader.read_string(keyword)) {
+                return false;
+            }
+            group.push_back(keyword);
+        }
+        groups.push_back(std::move(group));
+    }
+    if (!flat.empty()) {
+        groups.insert(groups.begin(), std::move(flat));
+    }
+    return !reader.failed();
+}
+
+bool read_intent(JsonReader& reader, FallbackIntent& intent, std::string& error) {
+    std::string key;
+    if (!reader.begin_object()) {
+        return false;
+    }
+    while (reader.next_key(key)) {
+        if (key == "id") {
+            if (!reader.read_string(intent.id)) {
+                return false;
+            }
+        } else if (key == "priority") {
+            double priority;
+            if (!reader.read_number(priority)) {
+                return false;
+            }
+            intent.priority = static_cast<int>(priority);
+        } else if (key == "handler") {
+            std::string handler;
+            if (!reader.read_string(handler)) {
+                return false;
+            }
+            if (handler == "math") {
+                intent.handler = FallbackHandler::Math;
+            } else if (handler != "response") {
+                error = "unknown handler \"" + handler + "\"";
+                return false;
+            }
+        } else if (key == "keywords") {
+            if (!read_keywords(reader, intent.keyword_groups)) {
+                return false;
+            }
+        } else if (key == "responses") {
+            if (!read_responses(reader, intent.responses)) {
+                return false;
+            }
+        } else if (!reader.skip_value()) {
+            return false;
+        }
+    }
+    return !reader.failed();
+}
+
+} // namespace
+
+std::shared_ptr<const FallbackTable> FallbackTable::builtin() {
+    static const std::shared_ptr<const FallbackTable> table = [] {
+        std::vector<FallbackIntent> intents = {
+            // Emergency and safety responses (highest priority for Gaza context)
+            {"emergency", 100, FallbackHandler::Response,
+             {{"emergency", "danger*", "help"}},
+             {{"en", "I understand this may be an emergency situation. For immediate safety:\n\n1. Move to the safest available location\n2. Stay low if there's debris or smoke\n3. Check for injuries and provide basic first aid\n4. Signal for help if possible\n5. Conserve water, food, and battery power\n\nWhat specific emergency assistance do you need?"}}},
+            // Water purification (critical for survival)
+            {"water", 90, FallbackHandler::Response,
+             {{"water"}, {"clean*", "purif*"}},
+             {{"en", "Water purification methods using available materials:\n\n**Immediate options:**\n• Boiling: Use any heat source for 1-3 minutes\n• Solar disinfection: Clear bottles in direct sunlight for 6+ hours\n• Sand filtration: Layer fine sand, gravel, cloth in container\n\n**Materials needed:**\n• Cloth or fabric for initial filtering\n• Sand and gravel (if available)\n• Clear containers or bottles\n• Heat source (wood, solar cooker)\n\nThese methods remove most harmful bacteria and particles. Always use the clearest water source available as starting point."}}},
+            {"medical", 80, FallbackHandler::Response,
+             {{"medical", "injur*", "first aid"}},
+             {{"en", "Basic first aid using available materials:\n\n**For wounds:**\n• Clean cloth or fabric for bandages\n• Clean water for washing\n• Apply direct pressure to stop bleeding\n• Elevate injured area if possible\n\n**For burns:**\n• Cool running water or clean wet cloth\n• Avoid ice or very cold water\n• Cover with clean, dry cloth\n\n**Important:** These are emergency measures. Seek professional medical help when possible."}}},
+            {"shelter", 70, FallbackHandler::Response,
+             {{"shelter*", "protection"}},
+             {{"en", "Creating protective shelter with available materials:\n\n**Basic structure:**\n• Use walls, debris, or natural features\n• Create windbreaks with fabric, tarps, or boards\n• Insulate from ground with blankets, cardboard, or clothing\n\n**For weather protection:**\n• Slope roof materials to shed water\n• Block wind from dominant direction\n• Create small, enclosed space to retain body heat\n\n**Safety priorities:**\n• Avoid unstable structures\n• Ensure ventilation\n• Have clear exit routes"}}},
+            {"communication", 60, FallbackHandler::Response,
+             {{"communication", "signal*", "contact"}},
+             {{"en", "Communication methods when networks are down:\n\n**Visual signals:**\n• Mirrors or reflective surfaces for sunlight signals\n• Bright cloth or clothing as markers\n• Smoke signals (safely controlled fires)\n\n**Audio signals:**\n• Whistles, horns, or loud objects\n• Rhythmic patterns (3 blasts = distress)\n• Shouting at regular intervals\n\n**Written messages:**\n• Leave notes in visible locations\n• Use improvised writing materials\n• Include date, time, direction of travel"}}},
+            {"greeting", 50, FallbackHandler::Response,
+             {{"hello", "hi"}},
+             {{"en", "Hello! I'm NaseerAI, running locally on your device. I'm designed to provide assistance even without internet connectivity. How can I help you today?"}}},
+            {"how_are_you", 40, FallbackHandler::Response,
+             {{"how are you"}},
+             {{"en", "I'm functioning well and ready to assist you. As a local AI model, I can help with information, problem-solving, and guidance even when you're offline. What do you need help with?"}}},
+            {"identity", 30, FallbackHandler::Response,
+             {{"what"}, {"ai"}},
+             {{"en", "I'm an AI assistant running locally on your device using a lightweight language model. I can help with explanations, problem-solving, emergency guidance, and general questions without requiring an internet connection."}}},
+            {"programming", 20, FallbackHandler::Response,
+             {{"programming", "code"}},
+             {{"en", "I can help with programming concepts and coding questions. What specific programming language or problem are you working with? I can explain concepts, help debug issues, or suggest approaches."}}},
+            {"math", 10, FallbackHandler::Math,
+             {{"+", "-", "*", "/", "^", "%", "\xC3\x97", "\xC3\xB7", "calculate", "plus", "minus", "times",
+               "divided", "mod", "sqrt"}},
+             {}},
+        };
+        auto built = std::make_shared<FallbackTable>();
+        std::string error;
+        built->compile(std::move(intents), {{"en", "I'm here to help with a wide range of topics including emergency guidance, technical questions, explanations, and problem-solving. I work completely offline, so you can rely on me even without internet access. What specific information or assistance do you need?"}}, error);
+        return std::shared_ptr<const FallbackTable>(std::move(built));
+    }();
+    return table;
+}
+
+bool FallbackTable::load_file(const std::string& path, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string content = buffer.str();
+    return load_buffer(content.data(), content.size(), error);
+}
+
+bool FallbackTable::load_buffer(const char* data, size_t length, std::string& error) {
+    JsonReader reader(data, length);
+    std::vector<FallbackIntent> intents;
+    Responses default_responses;
+    std::string key;
+    error.clear();
+
+    bool ok = reader.begin_object();
+    while (ok && reader.next_key(key)) {
+        if (key == "default") {
+            ok = read_responses(reader, default_responses);
+        } else if (key == "intents") {
+            ok = reader.begin_array();
+            while (ok && reader.next_element()) {
+                intents.emplace_back();
+                ok = read_intent(reader, intents.back(), error);
+            }
+        } else {
+            ok = reader.skip_value();
+        }
+    }
+    if (!ok || reader.failed()) {
+        if (error.empty()) {
+            error = "malformed JSON";
+        }
+        return false;
+    }
+    return compile(std::move(intents), std::move(default_responses), error);
+}
+
+bool FallbackTable::compile(std::vector<FallbackIntent> intents, Responses default_responses, std::string& error) {
+    IntentMatcher matcher;
+    std::vector<uint64_t> required;
+    int group_count = 0;
+
+    std::stable_sort(intents.begin(), intents.end(),
+                     [](const FallbackIntent& a, const FallbackIntent& b) { return a.priority > b.priority; });
+    for (const auto& intent : intents) {
+        if (intent.keyword_groups.empty()) {
+            error = "intent \"" + intent.id + "\" has no keywords";
+            return false;
+        }
+        if (intent.handler == FallbackHandler::Response && intent.responses.empty()) {
+            error = "intent \"" + intent.id + "\" has no responses";
+            return false;
+        }
+        uint64_t bits = 0;
+        for (const auto& group : intent.keyword_groups) {
+            if (group_count == 64) {
+                error = "more than 64 keyword groups";
+                return false;
+            }
+            for (const auto& keyword : group) {
+                const bool prefix = keyword.size() > 1 && keyword.back() == '*';
+                matcher.add(prefix ? keyword.substr(0, keyword.size() - 1) : keyword, group_count, prefix);
+            }
+            bits |= uint64_t{1} << group_count;
+            group_count++;
+        }
+        required.push_back(bits);
+    }
+    matcher.build();
+
+    m_intents = std::move(intents);
+    m_required = std::move(required);
+    m_default_responses = std::move(default_responses);
+    m_matcher = std::move(matcher);
+    return true;
+}
+
+std::vector<const FallbackIntent*> FallbackTable::match(const std::string& prompt) const {
+    std::vector<const FallbackIntent*> matched;
+    const uint64_t groups = m_matcher.match(prompt);
+    if (groups == 0) {
+        return matched;
+    }
+    for (size_t i = 0; i < m_intents.size(); ++i) {
+        if ((groups & m_required[i]) == m_required[i]) {
+            matched.push_back(&m_intents[i]);
+        }
+    }
+    return matched;
+}
+
+std::string FallbackTable::answer(const std::string& prompt) const {
+    for (const FallbackIntent* intent : match(prompt)) {
+        if (intent->handler == FallbackHandler::Math) {
+            std::string result = calculator::answer(prompt);
+            if (!result.empty()) {
+                return result;
+            }
+            continue;
+        }
+        return response(*intent, detect_language(prompt));
+    }
+    return "";
+}
+
+const std::string& FallbackTable::response(const FallbackIntent& intent, const std::string& language) const {
+    return pick_response(intent.responses, language);
+}
+
+const std::string& FallbackTable::default_response(const std::string& language) const {
+    return pick_response(m_default_responses, language);
+}
+
+std::string FallbackTable::detect_language(const std::string& prompt) {
+    // UTF-8 lead bytes 0xD8-0xDB encode U+0600-U+06FF, the Arabic block
+    for (unsigned char c : prompt) {
+        if (c >= 0xD8 && c <= 0xDB) {
+            return "ar";
+        }
+    }
+    return "en";
+}
@@ -0,0 +1,74 @@
+#ifndef FALLBACK_TABLE_H
+#define FALLBACK_TABLE_H
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include "intent_matcher.h"
+
+enum class FallbackHandler {
+    Response,  // answer with the intent's text
+    Math       // try the calculator; fall through to lower priorities if it fails
+};
+
+// An intent matches when each keyword group has at least one keyword in the
+// prompt. A trailing '*' makes a keyword a prefix ("injur*").
+struct FallbackIntent {
+    std::string id;
+    int priority = 0;
+    FallbackHandler handler = FallbackHandler::Response;
+    std::vector<std::vector<std::string>> keyword_groups;
+    std::vector<std::pair<std::string, std::string>> responses; // language, text
+};
+
+// Offline answers used when no model is loaded. A table is either the
+// built-in English one or loaded from a JSON file:
+//
+//   {"default": {"en": "...", "ar": "..."},
+//    "intents": [{"id": "water", "priority": 90,
+//                 "keywords": [["water", "مياه"], ["clean*", "purif*", "تنقية"]],
+//                 "responses": {"en": "...", "ar": "..."}},
+//                {"id": "math", "priority": 10, "handler": "math",
+//                 "keywords": ["+", "-", "calculate", "احسب"]}]}
+//
+// A flat "keywords" list is a single group. All keywords compile into one
+// IntentMatcher, so matching costs one pass over the prompt however large
+// the table grows; priorities are resolved over a bitmask per intent.
+// Tables hold at most 64 keyword groups.
+class FallbackTable {
+public:
+    static std::shared_ptr<const FallbackTable> builtin();
+
+    // Replace the table; on failure error says why and the table is unchanged
+    bool load_file(const std::string& path, std::string& error);
+    bool load_buffer(const char* data, size_t length, std::string& error);
+    bool compile(std::vector<FallbackIntent> intents,
+                 std::vector<std::pair<std::string, std::string>> default_responses, std::string& error);
+
+    // Intents whose keyword groups all match, highest priority first; equal
+    // priorities keep table order
+    std::vector<const FallbackIntent*> match(const std::string& prompt) const;
+
+    // Answer of the highest-priority matching intent in the prompt's
+    // language; "" when nothing matches and only the default would apply
+    std::string answer(const std::string& prompt) const;
+
+    // Text in language, else English, else the first one listed
+    const std::string& response(const FallbackIntent& intent, const std::string& language) const;
+    const std::string& default_response(const std::string& language) const;
+
+    // "ar" when the prompt contains Arabic script, otherwise "en"
+    static std::string detect_language(const std::string& prompt);
+
+    size_t intent_count() const { return m_intents.size(); }
+
+private:
+    std::vector<FallbackIntent> m_intents;
+    std::vector<uint64_t> m_required;  // keyword group bits per intent
+    std::vector<std::pair<std::string, std::string>> m_default_responses;
+    IntentMatcher m_matcher;
+};
+
+#endif // FALLBACK_TABLE_H
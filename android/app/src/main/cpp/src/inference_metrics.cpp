@@ -0,0 +1,75 @@
+#include "inference_metrics.h"
+#include <algorithm>
+#include <cmath>
+
+MetricsRecorder::MetricsRecorder(size_t capacity) : m_capacity(capacity > 0 ? capacity : 1) {
+    m_ring.reserve(m_capacity);
+}
+
+double MetricsRecorder::bucket_upper_ms(size_t bucket) {
+    // 1, 2, 5, 10, 20, 50 ... ms; the last bucket has no upper bound
+    if (bucket + 1 >= kHistogramBuckets) {
+        return INFINITY;
+    }
+    static const double steps[3] = {1.0, 2.0, 5.0};
+    return steps[bucket % 3] * std::pow(10.0, static_cast<double>(bucket / 3));
+}
+
+size_t MetricsRecorder::bucket_for(double ms) {
+    for (size_t bucket = 0; bucket + 1 < kHistogramBuckets; ++bucket) {
+        if (ms <= bucket_upper_ms(bucket)) {
+            return bucket;
+        }
+    }
+    return kHistogramBuckets - 1;
+}
+
+void MetricsRecorder::record(RequestMetrics metrics) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    metrics.request_id = m_next_id++;
+
+    if (m_ring.size() < m_capacity) {
+        m_ring.push_back(metrics);
+    } else {
+        m_ring[m_next] = metrics;
+    }
+    m_next = (m_next + 1) % m_capacity;
+
+    if (metrics.generated_tokens > 0) {
+        m_histograms[static_cast<int>(LatencyMetric::TimeToFirstToken)][bucket_for(metrics.ttft_ms)]++;
+        m_histograms[static_cast<int>(LatencyMetric::DecodePerToken)]
+                    [bucket_for(metrics.decode_ms / metrics.generated_tokens)]++;
+    }
+    if (metrics.prefill_tokens > 0) {
+        m_histograms[static_cast<int>(LatencyMetric::Prefill)][bucket_for(metrics.prefill_ms)]++;
+    }
+    m_histograms[static_cast<int>(LatencyMetric::Total)][bucket_for(metrics.total_ms)]++;
+}
+
+std::vector<RequestMetrics> MetricsRecorder::last(size_t count) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<RequestMetrics> result;
+    count = std::min(count, m_ring.size());
+    result.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        result.push_back(m_ring[(m_next + m_ring.size() - 1 - i) % m_ring.size()]);
+    }
+    return result;
+}
+
+std::vector<uint64_t> MetricsRecorder::histogram(LatencyMetric metric) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint64_t* counts = m_histograms[static_cast<int>(metric)];
+    return std::vector<uint64_t>(counts, counts + kHistogramBuckets);
+}
+
+void MetricsRecorder::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ring.clear();
+    m_next = 0;
+    for (auto& histogram : m_histograms) {
+        for (auto& count : histogram) {
+            count = 0;
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef INFERENCE_METRICS_H
+#define INFERENCE_METRICS_H
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include "perf_counters.h"
+
+enum class StopReason {
+    None = 0,
+    EndOfSequence = 1,
+    MaxTokens = 2,
+    ContextFull = 3,
+    DecodeError = 4,
+    CacheHit = 5      // answered from the response cache without decoding
+};
+
+// Timings of one generate() call, or of a response cache hit
+struct RequestMetrics {
+    uint64_t request_id = 0;
+    double tokenize_ms = 0.0;
+    int prompt_tokens = 0;
+    int reused_tokens = 0;     // prompt prefix already in the KV cache
+    int prefill_tokens = 0;    // prompt tokens actually decoded
+    double prefill_ms = 0.0;
+    double ttft_ms = 0.0;      // request start to first sampled token
+    int generated_tokens = 0;
+    double decode_ms = 0.0;
+    double sample_ms = 0.0;
+    double total_ms = 0.0;
+    StopReason stop_reason = StopReason::None;
+    // Hardware counters, only recorded while PerfCounters is enabled
+    PerfSample prefill_counters;
+    PerfSample decode_counters;
+
+    double decode_tokens_per_second() const {
+        return decode_ms > 0.0 ? generated_tokens * 1000.0 / decode_ms : 0.0;
+    }
+};
+
+enum class LatencyMetric {
+    TimeToFirstToken = 0,
+    Prefill = 1,
+    DecodePerToken = 2,
+    Total = 3
+};
+
+// Keeps the most recent requests and log-scale latency histograms over
+// every request since the last reset
+class MetricsRecorder {
+public:
+    static constexpr size_t kHistogramBuckets = 16;
+
+    explicit MetricsRecorder(size_t capacity = 64);
+
+    void record(RequestMetrics metrics);
+
+    // Newest first
+    std::vector<RequestMetrics> last(size_t count) const;
+
+    // Bucket i counts samples <= bucket_upper_ms(i); the last bucket is open-ended
+    std::vector<uint64_t> histogram(LatencyMetric metric) const;
+    static double bucket_upper_ms(size_t bucket);
+
+    void reset();
+
+private:
+    mutable std::mutex m_mutex;
+    size_t m_capacity;
+    std::vector<RequestMetrics> m_ring;
+    size_t m_next = 0;
+    uint64_t m_next_id = 1;
+    uint64_t m_histograms[4][kHistogramBuckets] = {};
+
+    static size_t bucket_for(double ms);
+};
+
+#endif // INFERENCE_METRICS_H
@@ -0,0 +1,215 @@
+#include "intent_classifier.h"
+#include "retrieval_kernels.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+constexpr char kMagic[4] = {'N', 'I', 'C', 'C'};
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kMaxDim = 8192;
+
+const char* const kIntentNames[kPromptIntentCount] = {
+    "emergency", "medical", "math", "greeting", "capsule_lookup", "open_ended",
+};
+
+bool read_u32(const char*& cursor, const char* end, uint32_t& out) {
+    if (end - cursor < static_cast<ptrdiff_t>(sizeof(out))) {
+        return false;
+    }
+    std::memcpy(&out, cursor, sizeof(out));
+    cursor += sizeof(out);
+    return true;
+}
+
+void write_u32(std::ofstream& out, uint32_t value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+} // namespace
+
+bool IntentClassifier::load_file(const std::string& path, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return load_buffer(data.data(), data.size(), error);
+}
+
+bool IntentClassifier::load_buffer(const char* data, size_t length, std::string& error) {
+    const char* cursor = data;
+    const char* end = data + length;
+    uint32_t version, dim, count;
+    if (length < sizeof(kMagic) || std::memcmp(data, kMagic, sizeof(kMagic)) != 0) {
+        error = "not an intent centroid file";
+        return false;
+    }
+    cursor += sizeof(kMagic);
+    if (!read_u32(cursor, end, version) || !read_u32(cursor, end, dim) || !read_u32(cursor, end, count)) {
+        error = "truncated header";
+        return false;
+    }
+    if (version != kVersion) {
+        error = "unsupported version " + std::to_string(version);
+        return false;
+    }
+    if (dim == 0 || dim > kMaxDim) {
+        error = "bad dimension " + std::to_string(dim);
+        return false;
+    }
+    const size_t record_bytes = 2 * sizeof(uint32_t) + dim * sizeof(float);
+    const size_t remaining = static_cast<size_t>(end - cursor);
+    if (remaining % record_bytes != 0 || remaining / record_bytes != count) {
+        error = "size does not match " + std::to_string(count) + " centroids";
+        return false;
+    }
+
+    std::vector<IntentCentroid> centroids(count);
+    for (auto& centroid : centroids) {
+        uint32_t intent;
+        read_u32(cursor, end, intent);
+        centroid.intent = static_cast<PromptIntent>(intent);
+        std::memcpy(&centroid.min_similarity, cursor, sizeof(float));
+        cursor += sizeof(float);
+        centroid.values.resize(dim);
+        std::memcpy(centroid.values.data(), cursor, dim * sizeof(float));
+        cursor += dim * sizeof(float);
+    }
+    return set_centroids(std::move(centroids), error);
+}
+
+bool IntentClassifier::set_centroids(std::vector<IntentCentroid> centroids, std::string& error) {
+    if (centroids.empty()) {
+        error = "no centroids";
+        return false;
+    }
+    const size_t dim = centroids.front().values.size();
+    std::vector<PromptIntent> intents;
+    std::vector<float> thresholds;
+    std::vector<float> values;
+    values.reserve(centroids.size() * dim);
+    for (auto& centroid : centroids) {
+        if (static_cast<uint32_t>(centroid.intent) >= kPromptIntentCount) {
+            error = "unknown intent " + std::to_string(static_cast<uint32_t>(centroid.intent));
+            return false;
+        }
+        if (centroid.values.size() != dim || dim == 0) {
+            error = "centroids differ in dimension";
+            return false;
+        }
+        float norm = 0.0f;
+        for (float v : centroid.values) {
+            norm += v * v;
+        }
+        if (!std::isfinite(norm) || norm == 0.0f) {
+            error = "zero or non-finite centroid for " + std::string(name(centroid.intent));
+            return false;
+        }
+        retrieval::normalize(centroid.values.data(), static_cast<int>(dim));
+        intents.push_back(centroid.intent);
+        thresholds.push_back(centroid.min_similarity);
+        values.insert(values.end(), centroid.values.begin(), centroid.values.end());
+    }
+    m_dim = static_cast<int>(dim);
+    m_intents = std::move(intents);
+    m_thresholds = std::move(thresholds);
+    m_values = std::move(values);
+    return true;
+}
+
+bool IntentClassifier::write_file(const std::string& path, const std::vector<IntentCentroid>& centroids,
+                                  std::string& error) {
+    if (centroids.empty()) {
+        error = "no centroids";
+        return false;
+    }
+    const uint32_t dim = static_cast<uint32_t>(centroids.front().values.size());
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error = "cannot write " + path;
+        return false;
+    }
+    out.write(kMagic, sizeof(kMagic));
+    write_u32(out, kVersion);
+    write_u32(out, dim);
+    write_u32(out, static_cast<uint32_t>(centroids.size()));
+    for (const auto& centroid : centroids) {
+        if (centroid.values.size() != dim) {
+            error = "centroids differ in dimension";
+            return false;
+        }
+        write_u32(out, static_cast<uint32_t>(centroid.intent));
+        out.write(reinterpret_cast<const char*>(&centroid.min_similarity), sizeof(float));
+        out.write(reinterpret_cast<const char*>(centroid.values.data()), dim * sizeof(float));
+    }
+    if (!out) {
+        error = "write failed for " + path;
+        return false;
+    }
+    return true;
+}
+
+IntentClassification IntentClassifier::classify(const float* embedding, int dim) const {
+    IntentClassification result;
+    if (!embedding || dim != m_dim || m_intents.empty()) {
+        return result;
+    }
+    std::vector<float> query(embedding, embedding + dim);
+    retrieval::normalize(query.data(), dim);
+
+    // Best similarity per intent, then the winner and its runner-up
+    float best[kPromptIntentCount];
+    int best_centroid[kPromptIntentCount];
+    for (uint32_t i = 0; i < kPromptIntentCount; ++i) {
+        best[i] = -2.0f;
+        best_centroid[i] = -1;
+    }
+    for (size_t c = 0; c < m_intents.size(); ++c) {
+        const float similarity = retrieval::dot_product(query.data(), &m_values[c * dim], dim);
+        const uint32_t intent = static_cast<uint32_t>(m_intents[c]);
+        if (similarity > best[intent]) {
+            best[intent] = similarity;
+            best_centroid[intent] = static_cast<int>(c);
+        }
+    }
+    uint32_t winner = 0;
+    for (uint32_t i = 1; i < kPromptIntentCount; ++i) {
+        if (best[i] > best[winner]) {
+            winner = i;
+        }
+    }
+    if (best_centroid[winner] < 0) {
+        return result; // non-finite embedding
+    }
+    float runner_up = -1.0f;
+    for (uint32_t i = 0; i < kPromptIntentCount; ++i) {
+        if (i != winner && best_centroid[i] >= 0 && best[i] > runner_up) {
+            runner_up = best[i];
+        }
+    }
+
+    result.similarity = best[winner];
+    result.margin = best[winner] - runner_up;
+    if (best[winner] >= m_thresholds[best_centroid[winner]]) {
+        result.intent = static_cast<PromptIntent>(winner);
+    }
+    return result;
+}
+
+const char* IntentClassifier::name(PromptIntent intent) {
+    const uint32_t index = static_cast<uint32_t>(intent);
+    return index < kPromptIntentCount ? kIntentNames[index] : "unknown";
+}
+
+int IntentClassifier::from_name(const std::string& name) {
+    for (uint32_t i = 0; i < kPromptIntentCount; ++i) {
+        if (name == kIntentNames[i]) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,72 @@
+#ifndef INTENT_CLASSIFIER_H
+#define INTENT_CLASSIFIER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Values are part of the C ABI and the centroid file format
+enum class PromptIntent : uint32_t {
+    Emergency = 0,
+    Medical = 1,
+    Math = 2,
+    Greeting = 3,
+    CapsuleLookup = 4,
+    OpenEnded = 5
+};
+
+constexpr uint32_t kPromptIntentCount = 6;
+
+struct IntentCentroid {
+    PromptIntent intent = PromptIntent::OpenEnded;
+    float min_similarity = 0.0f;  // below this the centroid does not claim a prompt
+    std::vector<float> values;
+};
+
+struct IntentClassification {
+    PromptIntent intent = PromptIntent::OpenEnded;
+    float similarity = 0.0f;  // cosine to the nearest centroid
+    float margin = 0.0f;      // over the nearest centroid of another intent
+};
+
+// Nearest-centroid routing over sentence embeddings. Each intent has one or
+// more unit centroids; a prompt goes to the most similar one if it clears
+// that centroid's threshold, otherwise it is OpenEnded and needs the model.
+//
+// Centroid files are little-endian:
+//
+//   char magic[4] = "NICC"; uint32 version = 1; uint32 dim; uint32 count;
+//   count x { uint32 intent; float min_similarity; float values[dim]; }
+//
+// tools/intent_centroids.cpp builds them from labelled example prompts with
+// the same model that embeds prompts at run time. Centroids from another
+// embedding model are meaningless, which the dimension check only partly
+// catches.
+class IntentClassifier {
+public:
+    // Replace the centroids; on failure error says why and nothing changes
+    bool load_file(const std::string& path, std::string& error);
+    bool load_buffer(const char* data, size_t length, std::string& error);
+    bool set_centroids(std::vector<IntentCentroid> centroids, std::string& error);
+
+    static bool write_file(const std::string& path, const std::vector<IntentCentroid>& centroids,
+                           std::string& error);
+
+    // embedding need not be normalized; dim must equal dim()
+    IntentClassification classify(const float* embedding, int dim) const;
+
+    int dim() const { return m_dim; }
+    size_t centroid_count() const { return m_intents.size(); }
+
+    static const char* name(PromptIntent intent);
+    // -1 for an unknown name
+    static int from_name(const std::string& name);
+
+private:
+    int m_dim = 0;
+    std::vector<PromptIntent> m_intents;
+    std::vector<float> m_thresholds;
+    std::vector<float> m_values;  // centroid_count() x m_dim, unit rows
+};
+
+#endif // INTENT_CLASSIFIER_H
@@ -0,0 +1,178 @@
+#include "intent_matcher.h"
+#include <queue>
+
+namespace {
+
+unsigned char fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c - 'A' + 'a') : c;
+}
+
+bool is_word_codepoint(uint32_t cp) {
+    if (cp < 0x80) {
+        return (cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z') || (cp >= '0' && cp <= '9');
+    }
+    // Punctuation and spaces outside ASCII, including Arabic comma,
+    // semicolon and question mark; everything else is treated as a letter
+    return !((cp >= 0xA0 && cp <= 0xBF) || cp == 0x060C || cp == 0x061B || cp == 0x061F ||
+             (cp >= 0x066A && cp <= 0x066D) || cp == 0x06D4 || (cp >= 0x2000 && cp <= 0x206F) ||
+             (cp >= 0x3000 && cp <= 0x303F));
+}
+
+uint32_t decode_at(const unsigned char* bytes, size_t pos, size_t size) {
+    const unsigned char lead = bytes[pos];
+    int extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+    uint32_t cp = extra ? lead & (0x3F >> extra) : lead;
+    for (int i = 1; i <= extra && pos + i < size; ++i) {
+        cp = (cp << 6) | (bytes[pos + i] & 0x3F);
+    }
+    return cp;
+}
+
+// Offset of the character ending just before pos
+size_t char_before(const unsigned char* bytes, size_t pos) {
+    size_t start = pos - 1;
+    while (start > 0 && pos - start < 4 && (bytes[start] & 0xC0) == 0x80) {
+        --start;
+    }
+    return start;
+}
+
+// Whether the character ending just before pos is a word character
+bool word_before(const unsigned char* bytes, size_t pos, size_t size) {
+    return is_word_codepoint(decode_at(bytes, char_before(bytes, pos), size));
+}
+
+// Arabic one-letter proclitics: wa, fa, bi, ka, li
+bool is_proclitic(uint32_t cp) {
+    return cp == 0x0648 || cp == 0x0641 || cp == 0x0628 || cp == 0x0643 || cp == 0x0644;
+}
+
+// Whether a match starting at pos begins a word. Arabic writes proclitics
+// joined to the word, so a few of them between a boundary and pos are
+// allowed, e.g. "بالماء" for "الماء" or "وللطبيب" for "طبيب" (li plus
+// the article's elided lam)
+bool word_starts_at(const unsigned char* bytes, size_t pos, size_t size) {
+    constexpr int kMaxProclitics = 3;
+    for (int clitics = 0; pos > 0; ++clitics) {
+        const size_t start = char_before(bytes, pos);
+        const uint32_t cp = decode_at(bytes, start, size);
+        if (!is_word_codepoint(cp)) {
+            return true;
+        }
+        if (clitics == kMaxProclitics || !is_proclitic(cp)) {
+            return false;
+        }
+        pos = start;
+    }
+    return true;
+}
+
+bool is_word_edge(const std::string& text, bool front) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    return front ? is_word_codepoint(decode_at(bytes, 0, text.size()))
+                 : word_before(bytes, text.size(), text.size());
+}
+
+} // namespace
+
+void IntentMatcher::add(const std::string& keyword, int term, bool prefix) {
+    if (keyword.empty() || term < 0 || term >= 64) {
+        return;
+    }
+    std::string folded = keyword;
+    for (char& c : folded) {
+        c = static_cast<char>(fold(static_cast<unsigned char>(c)));
+    }
+    m_keywords.push_back({folded, term, prefix});
+}
+
+void IntentMatcher::build() {
+    m_classes.fill(0);
+    m_class_count = 1;
+    for (const auto& keyword : m_keywords) {
+        for (unsigned char c : keyword.text) {
+            if (m_classes[c] == 0) {
+                m_classes[c] = static_cast<uint8_t>(m_class_count++);
+            }
+        }
+    }
+    for (unsigned char c = 'A'; c <= 'Z'; ++c) {
+        m_classes[c] = m_classes[fold(c)];
+    }
+
+    // Trie, with -1 for missing edges
+    const size_t classes = static_cast<size_t>(m_class_count);
+    m_patterns.clear();
+    m_outputs.assign(1, {});
+    m_next.assign(classes, -1);
+    for (const auto& keyword : m_keywords) {
+        int32_t state = 0;
+        for (unsigned char c : keyword.text) {
+            int32_t& edge = m_next[state * classes + m_classes[c]];
+            if (edge < 0) {
+                edge = static_cast<int32_t>(m_outputs.size());
+                m_outputs.emplace_back();
+                m_next.resize(m_next.size() + classes, -1);
+            }
+            state = m_next[state * classes + m_classes[c]];
+        }
+        m_outputs[state].push_back(static_cast<uint32_t>(m_patterns.size()));
+        m_patterns.push_back({static_cast<uint32_t>(keyword.text.size()), keyword.term,
+                              is_word_edge(keyword.text, true),
+                              !keyword.prefix && is_word_edge(keyword.text, false)});
+    }
+
+    // Breadth-first over the trie: fill missing edges from the fail state so
+    // match() never follows fail links, and inherit the fail state's outputs
+    std::vector<int32_t> fail(m_outputs.size(), 0);
+    std::queue<int32_t> pending;
+    for (size_t c = 0; c < classes; ++c) {
+        int32_t& edge = m_next[c];
+        if (edge < 0) {
+            edge = 0;
+        } else {
+            pending.push(edge);
+        }
+    }
+    while (!pending.empty()) {
+        const int32_t state = pending.front();
+        pending.pop();
+        const auto& inherited = m_outputs[fail[state]];
+        m_outputs[state].insert(m_outputs[state].end(), inherited.begin(), inherited.end());
+        for (size_t c = 0; c < classes; ++c) {
+            int32_t& edge = m_next[state * classes + c];
+            const int32_t fallback = m_next[fail[state] * classes + c];
+            if (edge < 0) {
+                edge = fallback;
+            } else {
+                fail[edge] = fallback;
+                pending.push(edge);
+            }
+        }
+    }
+}
+
+uint64_t IntentMatcher::match(const std::string& text) const {
+    if (m_next.empty()) {
+        return 0;
+    }
+    const auto* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    const size_t size = text.size();
+    uint64_t terms = 0;
+    int32_t state = 0;
+    for (size_t i = 0; i < size; ++i) {
+        state = m_next[static_cast<size_t>(state) * m_class_count + m_classes[bytes[i]]];
+        for (uint32_t index : m_outputs[state]) {
+            const Pattern& pattern = m_patterns[index];
+            const size_t start = i + 1 - pattern.length;
+            if (pattern.left_boundary && !word_starts_at(bytes, start, size)) {
+                continue;
+            }
+            if (pattern.right_boundary && i + 1 < size && is_word_codepoint(decode_at(bytes, i + 1, size))) {
+                continue;
+            }
+            terms |= uint64_t{1} << pattern.term;
+        }
+    }
+    return terms;
+}
@@ -0,0 +1,52 @@
+#ifndef INTENT_MATCHER_H
+#define INTENT_MATCHER_H
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Aho-Corasick automaton over intent keywords. match() classifies a prompt
+// in one pass over its bytes, however many keywords there are. ASCII is
+// matched case-insensitively. A keyword edge that is a word character only
+// matches at a word boundary, so "hi" does not fire inside "this". Prefix
+// keywords drop the boundary on the right ("signal" also finds "signals").
+// Boundaries are decided on UTF-8 code points, so Arabic keywords get the
+// same treatment and Arabic punctuation ends a word; Arabic proclitics
+// joined to the front of a word (و ف ب ك ل) still count as a boundary.
+class IntentMatcher {
+public:
+    // term is the bit set in match()'s result and must be below 64.
+    // Keywords added after build() take effect on the next build().
+    void add(const std::string& keyword, int term, bool prefix = false);
+    void build();
+
+    uint64_t match(const std::string& text) const;
+
+    size_t state_count() const { return m_outputs.size(); }
+
+private:
+    struct Keyword {
+        std::string text;
+        int term;
+        bool prefix;
+    };
+    struct Pattern {
+        uint32_t length;
+        int term;
+        bool left_boundary;   // starts with a word character
+        bool right_boundary;  // ends with a word character and is not a prefix
+    };
+
+    std::vector<Keyword> m_keywords;
+    std::vector<Pattern> m_patterns;
+    // Bytes that occur in no keyword share class 0; A-Z share a-z's class
+    std::array<uint8_t, 256> m_classes{};
+    int m_class_count = 1;
+    // Complete DFA: m_next[state * m_class_count + class]
+    std::vector<int32_t> m_next;
+    // Patterns ending in each state, including those reached via fail links
+    std::vector<std::vector<uint32_t>> m_outputs;
+};
+
+#endif // INTENT_MATCHER_H
@@ -0,0 +1,234 @@
+#include "json_reader.h"
+#include <cstdlib>
+#include <cstring>
+
+JsonReader::JsonReader(const char* data, size_t length) : m_data(data), m_length(length) {}
+
+void JsonReader::skip_whitespace() {
+    while (m_pos < m_length) {
+        char c = m_data[m_pos];
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+            break;
+        }
+        m_pos++;
+    }
+}
+
+bool JsonReader::fail() {
+    m_failed = true;
+    return false;
+}
+
+bool JsonReader::at_end() {
+    skip_whitespace();
+    return m_pos >= m_length;
+}
+
+char JsonReader::peek() {
+    skip_whitespace();
+    return m_pos < m_length ? m_data[m_pos] : '\0';
+}
+
+bool JsonReader::consume(char c) {
+    if (peek() == c) {
+        m_pos++;
+        return true;
+    }
+    return false;
+}
+
+bool JsonReader::expect(char c) {
+    return consume(c) || fail();
+}
+
+void JsonReader::append_utf8(std::string& out, unsigned int cp) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+bool JsonReader::read_string(std::string& out) {
+    out.clear();
+    if (!expect('"')) {
+        return false;
+    }
+
+    while (m_pos < m_length) {
+        // Copy unescaped runs in one go
+        size_t start = m_pos;
+        while (m_pos < m_length && m_data[m_pos] != '"' && m_data[m_pos] != '\\') {
+            m_pos++;
+        }
+        out.append(m_data + start, m_pos - start);
+        if (m_pos >= m_length) {
+            break;
+        }
+
+        char c = m_data[m_pos++];
+        if (c == '"') {
+            return true;
+        }
+        if (m_pos >= m_length) {
+            break;
+        }
+
+        char esc = m_data[m_pos++];
+        switch (esc) {
+            case '"': out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '/': out.push_back('/'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                if (m_pos + 4 > m_length) {
+                    return fail();
+                }
+                unsigned int cp = std::strtoul(std::string(m_data + m_pos, 4).c_str(), nullptr, 16);
+                m_pos += 4;
+                // Combine UTF-16 surrogate pairs
+                if (cp >= 0xD800 && cp <= 0xDBFF && m_pos + 6 <= m_length &&
+                    m_data[m_pos] == '\\' && m_data[m_pos + 1] == 'u') {
+                    unsigned int low = std::strtoul(std::string(m_data + m_pos + 2, 4).c_str(), nullptr, 16);
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        m_pos += 6;
+                    }
+                }
+                append_utf8(out, cp);
+                break;
+            }
+            default:
+                return fail();
+        }
+    }
+    return fail();
+}
+
+bool JsonReader::read_number(double& out) {
+    skip_whitespace();
+    if (m_pos >= m_length) {
+        return fail();
+    }
+
+    // strtod needs a terminated buffer; numbers are short so copy the lexeme
+    char buffer[64];
+    size_t n = 0;
+    while (m_pos < m_length && n < sizeof(buffer) - 1 &&
+           std::strchr("+-0123456789.eE", m_data[m_pos])) {
+        buffer[n++] = m_data[m_pos++];
+    }
+    buffer[n] = '\0';
+
+    char* end = nullptr;
+    out = std::strtod(buffer, &end);
+    return (n > 0 && end == buffer + n) || fail();
+}
+
+bool JsonReader::read_bool(bool& out) {
+    skip_whitespace();
+    if (m_length - m_pos >= 4 && std::strncmp(m_data + m_pos, "true", 4) == 0) {
+        m_pos += 4;
+        out = true;
+        return true;
+    }
+    if (m_length - m_pos >= 5 && std::strncmp(m_data + m_pos, "false", 5) == 0) {
+        m_pos += 5;
+        out = false;
+        return true;
+    }
+    return fail();
+}
+
+bool JsonReader::skip_value() {
+    char c = peek();
+    if (c == '"') {
+        std::string ignored;
+        return read_string(ignored);
+    }
+    if (c == '{') {
+        std::string key;
+        if (!begin_object()) return false;
+        while (next_key(key)) {
+            if (!skip_value()) return false;
+        }
+        return !m_failed;
+    }
+    if (c == '[') {
+        if (!begin_array()) return false;
+        while (next_element()) {
+            if (!skip_value()) return false;
+        }
+        return !m_failed;
+    }
+    if (c == 't' || c == 'f') {
+        bool ignored;
+        return read_bool(ignored);
+    }
+    if (c == 'n') {
+        if (m_length - m_pos >= 4 && std::strncmp(m_data + m_pos, "null", 4) == 0) {
+            m_pos += 4;
+            return true;
+        }
+        return fail();
+    }
+    double ignored;
+    return read_number(ignored);
+}
+
+// m_first tracks whether the innermost open container still expects its
+// first member. Closing a nested container clears it, so the enclosing
+// container then requires a separator before its next member.
+bool JsonReader::begin_object() {
+    m_first = true;
+    return expect('{');
+}
+
+bool JsonReader::next_key(std::string& key) {
+    if (m_failed) {
+        return false;
+    }
+    if (consume('}')) {
+        m_first = false;
+        return false;
+    }
+    if (!m_first && !expect(',')) {
+        return false;
+    }
+    m_first = false;
+    return read_string(key) && expect(':');
+}
+
+bool JsonReader::begin_array() {
+    m_first = true;
+    return expect('[');
+}
+
+bool JsonReader::next_element() {
+    if (m_failed) {
+        return false;
+    }
+    if (consume(']')) {
+        m_first = false;
+        return false;
+    }
+    if (!m_first && !expect(',')) {
+        return false;
+    }
+    m_first = false;
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <string>
+#include <cstddef>
+
+// Minimal forward-only JSON pull reader over an in-memory buffer. Used for
+// capsule files, which are large arrays of numbers and strings that we want
+// to consume in one pass without building a document tree.
+class JsonReader {
+public:
+    JsonReader(const char* data, size_t length);
+
+    bool at_end();
+    char peek();
+    bool consume(char c);
+    bool expect(char c);
+
+    bool read_string(std::string& out);
+    bool read_number(double& out);
+    bool read_bool(bool& out);
+    bool skip_value();
+
+    // Iteration helpers: call begin_*, then next_* until it returns false
+    bool begin_object();
+    bool next_key(std::string& key);
+    bool begin_array();
+    bool next_element();
+
+    bool failed() const { return m_failed; }
+
+private:
+    const char* m_data;
+    size_t m_length;
+    size_t m_pos = 0;
+    bool m_failed = false;
+    bool m_first = true;
+
+    void skip_whitespace();
+    bool fail();
+    static void append_utf8(std::string& out, unsigned int codepoint);
+};
+
+#endif // JSON_READER_H
@@ -0,0 +1,95 @@
+#include "memory_stats.h"
+#include <fstream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace memory_probe {
+
+namespace {
+
+size_t page_size() {
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+// Reads a "Key:   1234 kB" line of /proc/self/status
+uint64_t status_kb(const char* key) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    const std::string prefix = std::string(key) + ":";
+    while (std::getline(status, line)) {
+        if (line.compare(0, prefix.size(), prefix) == 0) {
+            return std::strtoull(line.c_str() + prefix.size(), nullptr, 10);
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+bool mapped_file(const std::string& file_path, uint64_t& mapped_bytes, uint64_t& resident_bytes) {
+    mapped_bytes = 0;
+    resident_bytes = 0;
+    std::ifstream maps("/proc/self/maps");
+    if (!maps.is_open() || file_path.empty()) {
+        return false;
+    }
+
+    const size_t page = page_size();
+    std::vector<unsigned char> residency;
+    std::string line;
+    bool found = false;
+    while (std::getline(maps, line)) {
+        // start-end perms offset dev inode path
+        size_t path_pos = line.find('/');
+        if (path_pos == std::string::npos || line.compare(path_pos, std::string::npos, file_path) != 0) {
+            continue;
+        }
+        unsigned long long start = 0, end = 0;
+        if (std::sscanf(line.c_str(), "%llx-%llx", &start, &end) != 2 || end <= start) {
+            continue;
+        }
+        found = true;
+        const size_t length = static_cast<size_t>(end - start);
+        mapped_bytes += length;
+
+        residency.resize((length + page - 1) / page);
+        if (mincore(reinterpret_cast<void*>(start), length, residency.data()) != 0) {
+            continue;
+        }
+        for (unsigned char flags : residency) {
+            if (flags & 1) {
+                resident_bytes += page;
+            }
+        }
+    }
+    return found;
+}
+
+uint64_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size_pages = 0, resident_pages = 0;
+    if (!(statm >> size_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * page_size();
+}
+
+uint64_t peak_resident_bytes() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // ru_maxrss is in kilobytes on Linux and Android
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+}
+
+uint64_t data_bytes() {
+    return status_kb("VmData") * 1024;
+}
+
+} // namespace memory_probe
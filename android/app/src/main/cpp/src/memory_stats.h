@@ -0,0 +1,36 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <string>
+#include <cstdint>
+
+// Process-level memory probes. All sizes are in bytes; each probe returns 0
+// (or false) where the platform does not expose the figure.
+namespace memory_probe {
+
+// Sums every mapping of file_path in /proc/self/maps and counts the pages
+// of those mappings that are resident according to mincore()
+bool mapped_file(const std::string& file_path, uint64_t& mapped_bytes, uint64_t& resident_bytes);
+
+uint64_t resident_bytes();
+uint64_t peak_resident_bytes();
+
+// Anonymous and heap address space (VmData). Compute buffers are large
+// allocations that are not touched until the first decode, so they show up
+// here long before they show up in the resident set.
+uint64_t data_bytes();
+
+} // namespace memory_probe
+
+// Memory held by the loaded model and its contexts
+struct ModelMemory {
+    uint64_t model_file_bytes = 0;      // mmapped GGUF
+    uint64_t model_resident_bytes = 0;  // part of it currently in RAM
+    uint64_t kv_cache_bytes = 0;
+    int32_t kv_cells_used = 0;
+    int32_t kv_cells_total = 0;
+    uint64_t compute_buffer_bytes = 0;  // every context's scheduler buffers
+    uint64_t tokenizer_bytes = 0;
+};
+
+#endif // MEMORY_STATS_H
@@ -1,11 +1,56 @@
 #include "../include/model_interface.h"
 #include "text_generator.h"
 #include "model_loader.h"
+#include "capsule_index.h"
+#include "capsule_ingest.h"
+#include "capsule_archive.h"
+#include "trace.h"
+#include "memory_stats.h"
+#include "perf_counters.h"
+#include "native_log.h"
+#include "calculator.h"
+#include "intent_classifier.h"
+#include "response_cache.h"
 #include <string>
+#include <chrono>
 #include <memory>
+#include <mutex>
 #include <cstring>
+#include <algorithm>
 
-static std::unique_ptr<TextGenerator> g_model = nullptr;
+// Calls on the chat isolate use g_model directly. Work on other threads
+// (capsule ingestion) holds a snapshot instead, so cleanup_model() or
+// init_model() never frees the model under it. g_model_mutex guards only
+// the pointer swap and the snapshot.
+static std::shared_ptr<TextGenerator> g_model = nullptr;
+static std::mutex g_model_mutex;
+static CapsuleIndex g_capsule_index;
+static std::shared_ptr<const FallbackTable> g_fallback_table;
+static std::shared_ptr<const IntentClassifier> g_intent_classifier;
+static ResponseCache g_response_cache;
+
+static std::shared_ptr<TextGenerator> model_snapshot() {
+    std::lock_guard<std::mutex> lock(g_model_mutex);
+    return g_model;
+}
+
+static char* copy_string(const std::string& value) {
+    char* result = new char[value.length() + 1];
+    std::strcpy(result, value.c_str());
+    return result;
+}
+
+// Names the loaded capsule set across restarts; the index version restarts
+// from zero with every process
+static std::string capsule_scope() {
+    std::vector<std::string> names = g_capsule_index.capsule_names();
+    std::sort(names.begin(), names.end());
+    std::string scope = std::to_string(g_capsule_index.passage_count());
+    for (const auto& name : names) {
+        scope += '\x1e' + name;
+    }
+    return scope;
+}
 
 extern "C" {
 
@@ -15,16 +60,23 @@ int init_model(const char* model_path) {
             cleanup_model();
         }
         
-        g_model = std::make_unique<TextGenerator>();
-        return g_model->load_model(model_path) ? 0 : -1;
+        auto model = std::make_shared<TextGenerator>();
+        model->set_fallback_table(g_fallback_table);
+        const bool loaded = model->load_model(model_path);
+        std::lock_guard<std::mutex> lock(g_model_mutex);
+        g_model = std::move(model);
+        return loaded ? 0 : -1;
     } catch (const std::exception& e) {
         return -1;
     }
 }
 
 void cleanup_model() {
-    if (g_model) {
-        g_model.reset();
+    // A snapshot still in use keeps the model alive until it is released
+    std::shared_ptr<TextGenerator> released;
+    {
+        std::lock_guard<std::mutex> lock(g_model_mutex);
+        released.swap(g_model);
     }
 }
 
@@ -34,10 +86,28 @@ char* generate_text(const char* prompt, int max_tokens) {
     }
     
     try {
+        const auto request_start = std::chrono::steady_clock::now();
+        // Sampling is greedy, so a finished answer is the answer for its key
+        const std::string fingerprint = g_model->generation_fingerprint(max_tokens);
+        const bool cacheable = !fingerprint.empty() && g_response_cache.is_open();
+        ResponseKey key;
+        if (cacheable) {
+            key = ResponseCache::make_key(prompt, fingerprint, capsule_scope());
+            std::string cached;
+            if (g_response_cache.lookup(key, cached)) {
+                g_model->discard_packed_context();
+                g_model->record_cache_hit(std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - request_start).count());
+                NLOG_DEBUG("cache", "Answered %zu-byte prompt from the response cache", std::strlen(prompt));
+                return copy_string(cached);
+            }
+        }
         std::string response = g_model->generate(prompt, max_tokens);
-        char* result = new char[response.length() + 1];
-        std::strcpy(result, response.c_str());
-        return result;
+        const StopReason stop = g_model->last_stop_reason();
+        if (cacheable && !response.empty() && (stop == StopReason::EndOfSequence || stop == StopReason::MaxTokens)) {
+            g_response_cache.store(key, response);
+        }
+        return copy_string(response);
     } catch (const std::exception& e) {
         return nullptr;
     }
@@ -74,4 +144,527 @@ void set_top_p(float top_p) {
     }
 }
 
+void set_prefix_reuse(int enabled) {
+    if (g_model) {
+        g_model->set_prefix_reuse(enabled != 0);
+    }
+}
+
+int load_fallback_responses(const char* path) {
+    if (!path) {
+        return -1;
+    }
+    try {
+        auto table = std::make_shared<FallbackTable>();
+        std::string error;
+        if (!table->load_file(path, error)) {
+            NLOG_ERROR("fallback", "Rejected %s: %s", path, error.c_str());
+            return -1;
+        }
+        g_fallback_table = table;
+        if (g_model) {
+            g_model->set_fallback_table(g_fallback_table);
+        }
+        NLOG_INFO("fallback", "Loaded %zu intents from %s", table->intent_count(), path);
+        return static_cast<int>(table->intent_count());
+    } catch (const std::exception& e) {
+        return -1;
+    }
+}
+
+char* evaluate_math(const char* text, int require_cue) {
+    if (!text) {
+        return nullptr;
+    }
+    try {
+        const std::string reply = calculator::answer(text, require_cue != 0);
+        return reply.empty() ? nullptr : copy_string(reply);
+    } catch (const std::exception& e) {
+        return nullptr;
+    }
+}
+
+char* curated_response(const char* prompt) {
+    if (!prompt) {
+        return nullptr;
+    }
+    try {
+        const FallbackTable& table = g_fallback_table ? *g_fallback_table : *FallbackTable::builtin();
+        const std::string answer = table.answer(prompt);
+        return answer.empty() ? nullptr : copy_string(answer);
+    } catch (const std::exception& e) {
+        return nullptr;
+    }
+}
+
+int load_intent_centroids(const char* path) {
+    if (!path) {
+        return -1;
+    }
+    try {
+        auto classifier = std::make_shared<IntentClassifier>();
+        std::string error;
+        if (!classifier->load_file(path, error)) {
+            NLOG_ERROR("intent", "Rejected %s: %s", path, error.c_str());
+            return -1;
+        }
+        std::atomic_store(&g_intent_classifier, std::shared_ptr<const IntentClassifier>(classifier));
+        NLOG_INFO("intent", "Loaded %zu centroids of dimension %d from %s",
+                  classifier->centroid_count(), classifier->dim(), path);
+        return static_cast<int>(classifier->centroid_count());
+    } catch (const std::exception& e) {
+        return -1;
+    }
+}
+
+int classify_intent(const char* text, float* similarity) {
+    // Called from a background isolate, so both are read as snapshots
+    const std::shared_ptr<const IntentClassifier> classifier = std::atomic_load(&g_intent_classifier);
+    const std::shared_ptr<TextGenerator> model = model_snapshot();
+    if (!text || !classifier || !model) {
+        return -1;
+    }
+    try {
+        std::vector<float> embedding;
+        if (!model->embed(text, embedding)) {
+            return -1;
+        }
+        if (static_cast<int>(embedding.size()) != classifier->dim()) {
+            NLOG_WARN("intent", "Centroids have dimension %d but the model embeds in %zu",
+                      classifier->dim(), embedding.size());
+            return -1;
+        }
+        const IntentClassification result = classifier->classify(embedding.data(), classifier->dim());
+        if (similarity) {
+            *similarity = result.similarity;
+        }
+        NLOG_DEBUG("intent", "%s (similarity %.3f, margin %.3f)", IntentClassifier::name(result.intent),
+                   result.similarity, result.margin);
+        return static_cast<int>(result.intent);
+    } catch (const std::exception& e) {
+        return -1;
+    }
+}
+
+int response_cache_open(const char* path, int64_t max_bytes) {
+    if (!path || max_bytes <= 0) {
+        return -1;
+    }
+    try {
+        std::string error;
+        if (!g_response_cache.open(path, static_cast<uint64_t>(max_bytes), error)) {
+            NLOG_ERROR("cache", "Response cache disabled: %s", error.c_str());
+            return -1;
+        }
+        NLOG_INFO("cache", "Opened %s with %zu responses", path, g_response_cache.entry_count());
+        return static_cast<int>(g_response_cache.entry_count());
+    } catch (const std::exception& e) {
+        return -1;
+    }
+}
+
+void response_cache_close() {
+    g_response_cache.close();
+}
+
+void response_cache_clear() {
+    g_response_cache.clear();
+}
+
+int response_cache_get_stats(response_cache_stats* stats) {
+    if (!stats) {
+        return -1;
+    }
+    stats->hits = g_response_cache.hit_count();
+    stats->misses = g_response_cache.miss_count();
+    stats->entries = g_response_cache.entry_count();
+    stats->live_bytes = g_response_cache.live_bytes();
+    stats->file_bytes = g_response_cache.file_bytes();
+    return 0;
+}
+
+int get_last_metrics(inference_metrics* records, int max_records) {
+    if (!g_model || !records || max_records <= 0) {
+        return 0;
+    }
+    std::vector<RequestMetrics> last = g_model->metrics().last(static_cast<size_t>(max_records));
+    for (size_t i = 0; i < last.size(); ++i) {
+        const RequestMetrics& m = last[i];
+        inference_metrics& out = records[i];
+        out.request_id = m.request_id;
+        out.tokenize_ms = m.tokenize_ms;
+        out.prompt_tokens = m.prompt_tokens;
+        out.reused_tokens = m.reused_tokens;
+        out.prefill_tokens = m.prefill_tokens;
+        out.prefill_ms = m.prefill_ms;
+        out.ttft_ms = m.ttft_ms;
+        out.generated_tokens = m.generated_tokens;
+        out.decode_ms = m.decode_ms;
+        out.decode_tokens_per_sec = m.decode_tokens_per_second();
+        out.sample_ms = m.sample_ms;
+        out.total_ms = m.total_ms;
+        out.stop_reason = static_cast<int32_t>(m.stop_reason);
+        out.prefill_cycles = m.prefill_counters.cycles;
+        out.prefill_instructions = m.prefill_counters.instructions;
+        out.prefill_cache_misses = m.prefill_counters.cache_misses;
+        out.prefill_llc_loads = m.prefill_counters.llc_loads;
+        out.prefill_task_clock_ms = m.prefill_counters.task_clock_ms;
+        out.decode_cycles = m.decode_counters.cycles;
+        out.decode_instructions = m.decode_counters.instructions;
+        out.decode_cache_misses = m.decode_counters.cache_misses;
+        out.decode_llc_loads = m.decode_counters.llc_loads;
+        out.decode_task_clock_ms = m.decode_counters.task_clock_ms;
+    }
+    return static_cast<int>(last.size());
+}
+
+int get_latency_histogram(int metric, uint64_t* counts, double* upper_bounds_ms, int max_buckets) {
+    if (!g_model || metric < 0 || metric > 3 || max_buckets <= 0) {
+        return -1;
+    }
+    std::vector<uint64_t> histogram = g_model->metrics().histogram(static_cast<LatencyMetric>(metric));
+    int buckets = std::min(max_buckets, static_cast<int>(histogram.size()));
+    for (int i = 0; i < buckets; ++i) {
+        if (counts) {
+            counts[i] = histogram[i];
+        }
+        if (upper_bounds_ms) {
+            upper_bounds_ms[i] = MetricsRecorder::bucket_upper_ms(i);
+        }
+    }
+    return buckets;
+}
+
+void reset_metrics() {
+    if (g_model) {
+        g_model->metrics().reset();
+    }
+}
+
+int perf_counters_set_enabled(int enabled) {
+    PerfCounters::set_enabled(enabled != 0);
+    return PerfCounters::enabled() ? 1 : 0;
+}
+
+int get_memory_stats(memory_stats* stats) {
+    if (!stats) {
+        return -1;
+    }
+    try {
+        ModelMemory model;
+        if (g_model) {
+            model = g_model->memory_usage();
+        }
+        stats->model_file_bytes = model.model_file_bytes;
+        stats->model_resident_bytes = model.model_resident_bytes;
+        stats->kv_cache_bytes = model.kv_cache_bytes;
+        stats->kv_cells_used = model.kv_cells_used;
+        stats->kv_cells_total = model.kv_cells_total;
+        stats->compute_buffer_bytes = model.compute_buffer_bytes;
+        stats->index_bytes = g_capsule_index.memory_bytes();
+        stats->tokenizer_bytes = model.tokenizer_bytes;
+        stats->rss_bytes = memory_probe::resident_bytes();
+        stats->peak_rss_bytes = memory_probe::peak_resident_bytes();
+        return 0;
+    } catch (const std::exception& e) {
+        return -1;
+    }
+}
+
+void trace_set_enabled(int enabled) {
+    Tracer::set_enabled(enabled != 0);
+}
+
+int trace_is_enabled() {
+    return Tracer::enabled() ? 1 : 0;
+}
+
+void trace_clear() {
+    Tracer::clear();
+}
+
+char* trace_dump_json() {
+    try {
+        return copy_string(Tracer::dump_json());
+    } catch (const std::exception& e) {
+        return nullptr;
+    }
+}
+
+int trace_dump_to_file(const char* path) {
+    if (!path) {
+        return -1;
+    }
+    try {
+        return Tracer::dump_to_file(path) ? 0 : -1;
+    } catch (const std::exception& e) {
+        return -1;
+    }
+}
+
+void log_set_level(int level) {
+    NativeLog::set_level(static_cast<LogLevel>(std::max(0, std::min(level, 4))));
+}
+
+void log_set_logcat(int enabled) {
+    NativeLog::set_logcat(enabled != 0);
+}
+
+char* log_drain_json(int max_events) {
+    try {
+        return copy_string(NativeLog::drain_json(max_events > 0 ? max_events : 0));
+    } catch (const std::exception& e) {
+        return nullptr;
+    }
+}
+
+uint64_t log_dropped_count() {
+    return NativeLog::dropped();
+}
+
+int rerank_passages(const char* query, const char** passages, int count,
+                    float* scores, int time_budget_ms) {
+    // Called from a search isolate; the snapshot outlives a concurrent cleanup_model()
+    std::shared_ptr<TextGenerator> model = model_snapshot();
+    if (!model || !query || !passages || !scores || count <= 0) {
+        return -1;
+    }
+
+    try {
+        std::vector<std::string> texts;
+        texts.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            texts.emplace_back(passages[i] ? passages[i] : "");
+        }
+        std::vector<float> results;
+        int scored = model->rerank(query, texts, time_budget_ms, results);
+        for (int i = 0; i < scored; ++i) {
+            scores[i] = results[i];
+        }
+        return scored;
+    } catch (const std::exception& e) {
+        return -1;
+    }
+}
+
+char* pack_context(const char* system_prompt, const char* history, const char* user_message,
+                   const char** passages, const float* scores, int count,
+                   int reserved_tokens, int dedup_policy, int* tokens_used) {
+    if (!g_model || !passages || count < 0 || dedup_policy < 0 || dedup_policy > 2) {
+        return nullptr;
+    }
+
+    try {
+        std::vector<PackCandidate> candidates(count);
+        for (int i = 0; i < count; ++i) {
+            candidates[i].text = passages[i] ? passages[i] : "";
+            // Without scores, earlier passages rank higher
+            candidates[i].score = scores ? scores[i] : static_cast<float>(count - i);
+        }
+        PackedContext packed;
+        if (!g_model->pack_context(system_prompt ? system_prompt : "", history ? history : "",
+                                   user_message ? user_message : "", candidates, reserved_tokens,
+                                   static_cast<DedupPolicy>(dedup_policy), packed)) {
+            return nullptr;
+        }
+        if (tokens_used) {
+            *tokens_used = packed.tokens_used;
+        }
+        return copy_string(packed.text);
+    } catch (const std::exception& e) {
+        return nullptr;
+    }
+}
+
+int capsule_index_add(const char* name, const char** sentences, const int32_t* sentence_indices,
+                      const float* embeddings, int count, int dim) {
+    if (!name || count < 0 || (count > 0 && (!sentences || !embeddings))) {
+        return -1;
+    }
+
+    try {
+        std::vector<std::string> texts;
+        std::vector<int> indices;
+        texts.reserve(count);
+        indices.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            texts.emplace_back(sentences[i] ? sentences[i] : "");
+            indices.push_back(sentence_indices ? sentence_indices[i] : i);
+        }
+        std::vector<float> vectors(embeddings, embeddings + static_cast<size_t>(count) * dim);
+        return g_capsule_index.add_capsule(name, texts, indices, vectors, dim) ? 0 : -1;
+    } catch (const std::exception& e) {
+        return -1;
+    }
+}
+
+// Capsules are named after their file, without directory or extension
+static std::string capsule_name_from_path(const std::string& file_path) {
+    std::string name = file_path;
+    size_t slash = name.find_last_of("/\\");
+    if (slash != std::string::npos) {
+        name = name.substr(slash + 1);
+    }
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos) {
+        name = name.substr(0, dot);
+    }
+    return name;
+}
+
+static bool ingest_capsule_file(const char* file_path, int max_passage_tokens, IngestedCapsule& capsule) {
+    IngestOptions options;
+    if (max_passage_tokens > 0) {
+        options.max_passage_tokens = max_passage_tokens;
+    }
+    // Count with the model tokenizer when a model is loaded
+    TokenCounter counter = nullptr;
+    std::shared_ptr<TextGenerator> model = model_snapshot();
+    if (model && model->is_loaded()) {
+        counter = [model](const std::string& text) { return model->count_tokens(text); };
+    }
+
+    CapsuleIngestor ingestor(options, counter);
+    return ingestor.ingest_file(file_path, capsule);
+}
+
+int capsule_index_add_file(const char* file_path, int max_passage_tokens) {
+    if (!file_path) {
+        return -1;
+    }
+
+    try {
+        const std::string name = capsule_name_from_path(file_path);
+
+        // Compressed capsules are indexed without inflating their text for good
+        if (CapsuleArchive::is_archive(file_path)) {
+            auto archive = std::make_shared<CapsuleArchive>();
+            if (!archive->open(file_path) || !g_capsule_index.add_archive(name, archive)) {
+                return -1;
+            }
+            return static_cast<int>(archive->passage_count());
+        }
+
+        IngestedCapsule capsule;
+        if (!ingest_capsule_file(file_path, max_passage_tokens, capsule)) {
+            return -1;
+        }
+        if (!g_capsule_index.add_capsule(name, capsule.passages, capsule.sentence_indices,
+                                         capsule.embeddings, capsule.dim, &capsule.source_refs)) {
+            return -1;
+        }
+        return static_cast<int>(capsule.passages.size());
+    } catch (const std::exception& e) {
+        return -1;
+    }
+}
+
+int64_t capsule_compress_file(const char* json_path, const char* archive_path, int max_passage_tokens) {
+    if (!json_path || !archive_path) {
+        return -1;
+    }
+
+    try {
+        IngestedCapsule capsule;
+        if (!ingest_capsule_file(json_path, max_passage_tokens, capsule)) {
+            return -1;
+        }
+        CapsuleArchiveWriter writer;
+        return writer.write(archive_path, capsule);
+    } catch (const std::exception& e) {
+        return -1;
+    }
+}
+
+int capsule_index_remove(const char* name) {
+    if (!name) {
+        return -1;
+    }
+    return g_capsule_index.remove_capsule(name) ? 0 : -1;
+}
+
+void capsule_index_clear() {
+    g_capsule_index.clear();
+}
+
+int capsule_index_search(const char* query, const float* query_embedding, int dim,
+                         capsule_search_hit* hits, int max_results, int* total_results) {
+    return capsule_index_search_filtered(query, query_embedding, dim, nullptr, -1,
+                                         hits, max_results, total_results);
+}
+
+int capsule_index_search_filtered(const char* query, const float* query_embedding, int dim,
+                                  const char** capsules, int capsule_count,
+                                  capsule_search_hit* hits, int max_results, int* total_results) {
+    if (!query || !hits || max_results <= 0) {
+        return -1;
+    }
+
+    try {
+        // A negative count means no filter; zero capsules matches nothing
+        std::vector<std::string> filter;
+        if (capsule_count >= 0) {
+            for (int i = 0; i < capsule_count; ++i) {
+                if (capsules && capsules[i]) {
+                    filter.emplace_back(capsules[i]);
+                }
+            }
+        }
+
+        std::vector<SearchHit> results = g_capsule_index.search(query, query_embedding, dim,
+                                                                max_results, total_results,
+                                                                capsule_count >= 0 ? &filter : nullptr);
+        for (size_t i = 0; i < results.size(); ++i) {
+            hits[i].passage_id = results[i].passage_id;
+            hits[i].sentence_index = results[i].sentence_index;
+            hits[i].score = results[i].score;
+            hits[i].semantic_score = results[i].semantic_score;
+            hits[i].keyword_score = results[i].keyword_score;
+        }
+        return static_cast<int>(results.size());
+    } catch (const std::exception& e) {
+        return -1;
+    }
+}
+
+char* capsule_index_passage_text(uint32_t passage_id) {
+    std::string text, source;
+    if (!g_capsule_index.get_passage(passage_id, text, source)) {
+        return nullptr;
+    }
+    return copy_string(text);
+}
+
+char* capsule_index_passage_source(uint32_t passage_id) {
+    std::string text, source;
+    if (!g_capsule_index.get_passage(passage_id, text, source)) {
+        return nullptr;
+    }
+    return copy_string(source);
+}
+
+int capsule_index_passage_refs(uint32_t passage_id, int32_t* refs, int max_refs) {
+    std::vector<int32_t> values;
+    if (!g_capsule_index.get_passage_refs(passage_id, values)) {
+        return -1;
+    }
+    for (int i = 0; refs && i < max_refs && i < static_cast<int>(values.size()); ++i) {
+        refs[i] = values[i];
+    }
+    return static_cast<int>(values.size());
+}
+
+uint64_t capsule_index_version() {
+    return g_capsule_index.version();
+}
+
+void capsule_index_set_cache_capacity(int capacity) {
+    g_capsule_index.set_query_cache_capacity(static_cast<size_t>(std::max(0, capacity)));
+}
+
+void capsule_index_set_prefilter(int min_passages, int candidates) {
+    g_capsule_index.set_prefilter(static_cast<size_t>(std::max(0, min_passages)),
+                                  static_cast<size_t>(std::max(1, candidates)));
+}
+
 }
\ No newline at end of file
@@ -1,9 +1,37 @@
 #include "model_loader.h"
+#include "native_log.h"
 #include <fstream>
-#include <iostream>
 #include <algorithm>
 #include "llama.h"
 
+namespace {
+
+// llama.cpp emits partial lines (GGML_LOG_LEVEL_CONT) while loading, so
+// text is buffered per thread and logged one line at a time
+void route_llama_log(ggml_log_level level, const char* text, void*) {
+    thread_local std::string line;
+    thread_local LogLevel line_level = LogLevel::Info;
+
+    if (level != GGML_LOG_LEVEL_CONT) {
+        switch (level) {
+            case GGML_LOG_LEVEL_ERROR: line_level = LogLevel::Error; break;
+            case GGML_LOG_LEVEL_WARN: line_level = LogLevel::Warn; break;
+            case GGML_LOG_LEVEL_INFO: line_level = LogLevel::Info; break;
+            default: line_level = LogLevel::Debug; break;
+        }
+    }
+    for (const char* c = text; c && *c; ++c) {
+        if (*c == '\n') {
+            NativeLog::write(line_level, "llama", line.c_str());
+            line.clear();
+        } else {
+            line.push_back(*c);
+        }
+    }
+}
+
+} // namespace
+
 ModelLoader::ModelLoader() = default;
 ModelLoader::~ModelLoader() = default;
 
@@ -47,6 +75,9 @@ bool ModelLoader::is_supported_format(const std::string& file_path) {
 }
 
 bool ModelLoader::load_gguf(const std::string& file_path, ModelData& data) {
+    // Route llama.cpp output into the native log before it prints anything
+    llama_log_set(route_llama_log, nullptr);
+
     // Initialize llama.cpp backend
     llama_backend_init();
     
@@ -61,6 +92,7 @@ bool ModelLoader::load_gguf(const std::string& file_path, ModelData& data) {
         llama_model* model = llama_model_load_from_file(file_path.c_str(), model_params);
         
         if (!model) {
+            NLOG_ERROR("loader", "Failed to load GGUF model: %s", file_path.c_str());
             llama_backend_free();
             return false;
         }
@@ -76,14 +108,12 @@ bool ModelLoader::load_gguf(const std::string& file_path, ModelData& data) {
         // Store model file path for context creation
         data.model_path = file_path;
         
-        std::cout << "Successfully loaded GGUF model:" << std::endl;
-        std::cout << "  Vocab size: " << data.vocab_size << std::endl;
-        std::cout << "  Hidden size: " << data.hidden_size << std::endl;
-        std::cout << "  Layers: " << data.num_layers << std::endl;
+        NLOG_INFO("loader", "Loaded GGUF model: vocab %d, hidden %d, layers %d",
+                  data.vocab_size, data.hidden_size, data.num_layers);
         
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error loading GGUF model: " << e.what() << std::endl;
+        NLOG_ERROR("loader", "Error loading GGUF model: %s", e.what());
         llama_backend_free();
         return false;
     }
@@ -0,0 +1,193 @@
+#include "native_log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__ANDROID__)
+#include <android/log.h>
+#endif
+
+namespace {
+
+constexpr size_t kRingSize = 512; // power of two
+constexpr size_t kRingMask = kRingSize - 1;
+
+// sequence is 2 * index + 1 while the slot is being written and
+// 2 * index + 2 once event holds the event with that index
+struct Slot {
+    std::atomic<uint64_t> sequence{0};
+    LogEvent event;
+};
+
+Slot g_ring[kRingSize];
+std::atomic<uint64_t> g_head{0};
+std::atomic<bool> g_logcat{false};
+
+// Drains are rare and may come from several isolates
+std::mutex g_reader_mutex;
+uint64_t g_tail = 0;
+std::atomic<uint64_t> g_dropped{0};
+
+int32_t current_thread_id() {
+#if defined(__linux__)
+    thread_local const int32_t tid = static_cast<int32_t>(syscall(SYS_gettid));
+    return tid;
+#else
+    return 0;
+#endif
+}
+
+void forward_to_logcat(LogLevel level, const char* tag, const char* message) {
+#if defined(__ANDROID__)
+    static const int priorities[] = {ANDROID_LOG_DEBUG, ANDROID_LOG_INFO, ANDROID_LOG_WARN, ANDROID_LOG_ERROR};
+    char android_tag[32];
+    std::snprintf(android_tag, sizeof(android_tag), "NaseerAI/%s", tag);
+    __android_log_write(priorities[static_cast<int>(level)], android_tag, message);
+#else
+    (void)level;
+    (void)tag;
+    (void)message;
+#endif
+}
+
+void append_json_string(std::string& out, const char* text) {
+    out.push_back('"');
+    for (const char* c = text; *c; ++c) {
+        unsigned char ch = static_cast<unsigned char>(*c);
+        if (ch == '"' || ch == '\\') {
+            out.push_back('\\');
+            out.push_back(*c);
+        } else if (ch == '\n') {
+            out += "\\n";
+        } else if (ch == '\t') {
+            out += "\\t";
+        } else if (ch < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+            out += escaped;
+        } else {
+            out.push_back(*c);
+        }
+    }
+    out.push_back('"');
+}
+
+} // namespace
+
+std::atomic<int> NativeLog::s_level{static_cast<int>(LogLevel::Info)};
+
+void NativeLog::set_level(LogLevel level) {
+    s_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void NativeLog::set_logcat(bool enabled) {
+    g_logcat.store(enabled, std::memory_order_relaxed);
+}
+
+void NativeLog::write(LogLevel level, const char* tag, const char* message) {
+    if (!enabled(level) || level == LogLevel::Off) {
+        return;
+    }
+    tag = tag ? tag : "";
+    message = message ? message : "";
+
+    const uint64_t index = g_head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = g_ring[index & kRingMask];
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    LogEvent& event = slot.event;
+    event.sequence = index;
+    event.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    event.level = static_cast<int32_t>(level);
+    event.thread_id = current_thread_id();
+    std::strncpy(event.tag, tag, sizeof(event.tag) - 1);
+    event.tag[sizeof(event.tag) - 1] = '\0';
+    std::strncpy(event.message, message, sizeof(event.message) - 1);
+    event.message[sizeof(event.message) - 1] = '\0';
+
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+
+    if (g_logcat.load(std::memory_order_relaxed)) {
+        forward_to_logcat(level, tag, message);
+    }
+}
+
+void NativeLog::writef(LogLevel level, const char* tag, const char* format, ...) {
+    char message[sizeof(LogEvent::message)];
+    va_list args;
+    va_start(args, format);
+    std::vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    write(level, tag, message);
+}
+
+size_t NativeLog::drain(std::vector<LogEvent>& out, size_t max_events) {
+    std::lock_guard<std::mutex> lock(g_reader_mutex);
+    const uint64_t head = g_head.load(std::memory_order_acquire);
+    if (head - g_tail > kRingSize) {
+        g_dropped.fetch_add(head - kRingSize - g_tail, std::memory_order_relaxed);
+        g_tail = head - kRingSize;
+    }
+
+    size_t drained = 0;
+    while (g_tail < head && drained < max_events) {
+        Slot& slot = g_ring[g_tail & kRingMask];
+        const uint64_t expected = 2 * g_tail + 2;
+        const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before < expected) {
+            break; // still being written; picked up by the next drain
+        }
+        if (before == expected) {
+            LogEvent event;
+            std::memcpy(&event, &slot.event, sizeof(event));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == expected) {
+                out.push_back(event);
+                drained++;
+                g_tail++;
+                continue;
+            }
+        }
+        // Overwritten by a writer that lapped the ring
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        g_tail++;
+    }
+    return drained;
+}
+
+std::string NativeLog::drain_json(size_t max_events) {
+    static const char* level_names[] = {"debug", "info", "warn", "error"};
+    std::vector<LogEvent> events;
+    events.reserve(std::min(max_events, kRingSize));
+    drain(events, max_events);
+
+    std::string out = "{\"dropped\":" + std::to_string(dropped()) + ",\"events\":[";
+    char line[160];
+    for (size_t i = 0; i < events.size(); ++i) {
+        const LogEvent& event = events[i];
+        std::snprintf(line, sizeof(line), "%s{\"seq\":%llu,\"time_ms\":%lld,\"level\":\"%s\",\"tid\":%d,\"tag\":",
+                      i ? "," : "", static_cast<unsigned long long>(event.sequence),
+                      static_cast<long long>(event.time_ms), level_names[event.level & 3], event.thread_id);
+        out += line;
+        append_json_string(out, event.tag);
+        out += ",\"message\":";
+        append_json_string(out, event.message);
+        out += "}";
+    }
+    out += "]}";
+    return out;
+}
+
+uint64_t NativeLog::dropped() {
+    return g_dropped.load(std::memory_order_relaxed);
+}
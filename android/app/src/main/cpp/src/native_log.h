@@ -0,0 +1,66 @@
+#ifndef NATIVE_LOG_H
+#define NATIVE_LOG_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Leveled native log kept in a fixed ring of events. Writers never lock or
+// allocate: they claim a slot with one atomic increment and publish it with
+// a sequence number. When the ring is full the oldest events are
+// overwritten and counted as dropped. The host drains events in bulk, so no
+// hot path ever waits on I/O. Events can also be forwarded to logcat.
+enum class LogLevel : int {
+    Debug = 0,
+    Info = 1,
+    Warn = 2,
+    Error = 3,
+    Off = 4
+};
+
+struct LogEvent {
+    uint64_t sequence = 0;
+    int64_t time_ms = 0;      // wall clock, comparable with Dart timestamps
+    int32_t level = 0;
+    int32_t thread_id = 0;
+    char tag[16] = {};        // subsystem: "loader", "llama", "generate", ...
+    char message[208] = {};
+};
+
+class NativeLog {
+public:
+    static void set_level(LogLevel level);
+    static bool enabled(LogLevel level) {
+        return static_cast<int>(level) >= s_level.load(std::memory_order_relaxed);
+    }
+
+    // Mirrors every accepted event to logcat on Android; ignored elsewhere
+    static void set_logcat(bool enabled);
+
+    static void write(LogLevel level, const char* tag, const char* message);
+    static void writef(LogLevel level, const char* tag, const char* format, ...)
+        __attribute__((format(printf, 3, 4)));
+
+    // Moves up to max_events of the oldest pending events into out
+    static size_t drain(std::vector<LogEvent>& out, size_t max_events);
+    static std::string drain_json(size_t max_events);
+    static uint64_t dropped();
+
+private:
+    static std::atomic<int> s_level;
+};
+
+#define NLOG(level, tag, ...)                                                 \
+    do {                                                                      \
+        if (NativeLog::enabled(level)) {                                      \
+            NativeLog::writef(level, tag, __VA_ARGS__);                       \
+        }                                                                     \
+    } while (0)
+
+#define NLOG_DEBUG(tag, ...) NLOG(LogLevel::Debug, tag, __VA_ARGS__)
+#define NLOG_INFO(tag, ...) NLOG(LogLevel::Info, tag, __VA_ARGS__)
+#define NLOG_WARN(tag, ...) NLOG(LogLevel::Warn, tag, __VA_ARGS__)
+#define NLOG_ERROR(tag, ...) NLOG(LogLevel::Error, tag, __VA_ARGS__)
+
+#endif // NATIVE_LOG_H
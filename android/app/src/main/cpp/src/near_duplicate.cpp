@@ -0,0 +1,95 @@
+#include "near_duplicate.h"
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+uint64_t fnv1a(const std::string& text, uint64_t hash = 1469598103934665603ULL) {
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Spreads FNV output across all 64 bits (splitmix64 finalizer)
+uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+} // namespace
+
+uint64_t simhash(const std::string& text) {
+    // Words are runs of alphanumerics or non-ASCII bytes, so Arabic survives
+    std::vector<std::string> words;
+    std::string word;
+    for (unsigned char c : text) {
+        if (std::isalnum(c) || c >= 0x80) {
+            word.push_back(static_cast<char>(std::tolower(c)));
+        } else if (!word.empty()) {
+            words.push_back(std::move(word));
+            word.clear();
+        }
+    }
+    if (!word.empty()) {
+        words.push_back(std::move(word));
+    }
+    if (words.empty()) {
+        return 0;
+    }
+
+    int weights[64] = {0};
+    auto accumulate = [&](uint64_t hash) {
+        hash = mix(hash);
+        for (int bit = 0; bit < 64; ++bit) {
+            weights[bit] += ((hash >> bit) & 1ULL) ? 1 : -1;
+        }
+    };
+    // Unigrams only: in a ten-word sentence one inserted word then moves
+    // one feature in ten, where bigrams would move three
+    for (const auto& w : words) {
+        accumulate(fnv1a(w));
+    }
+
+    uint64_t signature = 0;
+    for (int bit = 0; bit < 64; ++bit) {
+        if (weights[bit] > 0) {
+            signature |= 1ULL << bit;
+        }
+    }
+    return signature;
+}
+
+NearDuplicateIndex::NearDuplicateIndex(int max_distance)
+    : m_max_distance(std::min(max_distance, kBands - 1)) {}
+
+int NearDuplicateIndex::find(uint64_t signature) const {
+    for (int band = 0; band < kBands; ++band) {
+        uint32_t key = (static_cast<uint32_t>(band) << 8) | ((signature >> (band * 8)) & 0xff);
+        auto it = m_bands.find(key);
+        if (it == m_bands.end()) {
+            continue;
+        }
+        for (uint32_t slot : it->second) {
+            if (simhash_distance(signature, m_signatures[slot]) <= m_max_distance) {
+                return m_ids[slot];
+            }
+        }
+    }
+    return -1;
+}
+
+void NearDuplicateIndex::add(uint64_t signature, int id) {
+    uint32_t slot = static_cast<uint32_t>(m_signatures.size());
+    m_signatures.push_back(signature);
+    m_ids.push_back(id);
+    for (int band = 0; band < kBands; ++band) {
+        uint32_t key = (static_cast<uint32_t>(band) << 8) | ((signature >> (band * 8)) & 0xff);
+        m_bands[key].push_back(slot);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef NEAR_DUPLICATE_H
+#define NEAR_DUPLICATE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// 64-bit SimHash over lowercased words. Sentences that differ in a word or
+// two land a few bits apart; unrelated ones rarely come within 13 bits.
+uint64_t simhash(const std::string& text);
+
+inline int simhash_distance(uint64_t a, uint64_t b) {
+    return __builtin_popcountll(a ^ b);
+}
+
+// Finds earlier signatures within max_distance bits. Signatures are split
+// into eight 8-bit bands; any pair within 7 bits shares at least one band,
+// so only band collisions are compared in full.
+class NearDuplicateIndex {
+public:
+    explicit NearDuplicateIndex(int max_distance = 7);
+
+    // Returns the id of a near-duplicate already added, or -1
+    int find(uint64_t signature) const;
+    void add(uint64_t signature, int id);
+
+private:
+    static constexpr int kBands = 8;
+
+    int m_max_distance;
+    std::vector<uint64_t> m_signatures;
+    std::vector<int> m_ids;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> m_bands; // (band, value) -> slots
+};
+
+#endif // NEAR_DUPLICATE_H
@@ -0,0 +1,214 @@
+#include "op_profiler.h"
+
+#if NASEER_OP_PROFILER
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include "ggml.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Stat {
+    uint64_t calls = 0;
+    double total_ms = 0.0;
+};
+
+const char* kPhaseNames[OpProfiler::PhaseCount] = {"prefill", "decode"};
+
+std::atomic<bool> g_enabled{false};
+std::atomic<int> g_phase{OpProfiler::Prefill};
+
+// The scheduler calls back from the thread running llama_decode; the mutex
+// only guards against a reader dumping stats mid-run
+std::mutex g_mutex;
+std::map<std::string, Stat> g_ops[OpProfiler::PhaseCount];
+std::map<int, Stat> g_layers[OpProfiler::PhaseCount];
+Clock::time_point g_node_start;
+
+// Layout-only ops; ggml computes nothing for them, so they are folded into
+// the next real node instead of forcing a sync of their own
+bool is_empty_op(const ggml_tensor* tensor) {
+    switch (tensor->op) {
+        case GGML_OP_NONE:
+        case GGML_OP_VIEW:
+        case GGML_OP_RESHAPE:
+        case GGML_OP_PERMUTE:
+        case GGML_OP_TRANSPOSE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// llama.cpp names per-layer tensors "<name>-<layer>", optionally followed
+// by a " (view)"-style suffix; anything else is outside the layers
+int layer_of(const char* name) {
+    int layer = -1;
+    for (const char* c = std::strchr(name, '-'); c; c = std::strchr(c + 1, '-')) {
+        const char* digits = c + 1;
+        const char* end = digits;
+        while (*end >= '0' && *end <= '9') {
+            ++end;
+        }
+        if (end != digits && (*end == '\0' || *end == ' ')) {
+            layer = std::atoi(digits);
+        }
+    }
+    return layer;
+}
+
+std::vector<OpProfileEntry> to_entries(const std::map<std::string, Stat>& stats) {
+    std::vector<OpProfileEntry> entries;
+    for (const auto& [name, stat] : stats) {
+        entries.push_back({name, stat.calls, stat.total_ms});
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const OpProfileEntry& a, const OpProfileEntry& b) { return a.total_ms > b.total_ms; });
+    return entries;
+}
+
+double phase_total_ms(int phase) {
+    double total = 0.0;
+    for (const auto& entry : g_ops[phase]) {
+        total += entry.second.total_ms;
+    }
+    return total;
+}
+
+} // namespace
+
+void OpProfiler::set_enabled(bool enabled) {
+    g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool OpProfiler::enabled() {
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void OpProfiler::set_phase(Phase phase) {
+    g_phase.store(phase, std::memory_order_relaxed);
+}
+
+void OpProfiler::reset() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        g_ops[phase].clear();
+        g_layers[phase].clear();
+    }
+}
+
+bool OpProfiler::eval_callback(ggml_tensor* tensor, bool ask, void*) {
+    if (ask) {
+        // The scheduler computes a node right after asking about it, so the
+        // node's time runs from here to the matching ask == false call
+        if (!enabled() || is_empty_op(tensor)) {
+            return false;
+        }
+        g_node_start = Clock::now();
+        return true;
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(Clock::now() - g_node_start).count();
+    const int phase = g_phase.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(g_mutex);
+    Stat& op = g_ops[phase][ggml_op_desc(tensor)];
+    op.calls++;
+    op.total_ms += ms;
+    Stat& layer = g_layers[phase][layer_of(tensor->name)];
+    layer.calls++;
+    layer.total_ms += ms;
+    return true; // false would abort the graph
+}
+
+std::vector<OpProfileEntry> OpProfiler::by_op(Phase phase) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return to_entries(g_ops[phase]);
+}
+
+std::vector<OpProfileEntry> OpProfiler::by_layer(Phase phase) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    std::vector<OpProfileEntry> entries;
+    for (const auto& [layer, stat] : g_layers[phase]) {
+        entries.push_back({std::to_string(layer), stat.calls, stat.total_ms});
+    }
+    return entries;
+}
+
+std::string OpProfiler::table() {
+    std::string out;
+    char line[128];
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        const std::vector<OpProfileEntry> ops = by_op(static_cast<Phase>(phase));
+        if (ops.empty()) {
+            continue;
+        }
+        const std::vector<OpProfileEntry> layers = by_layer(static_cast<Phase>(phase));
+        double total = 0.0;
+        for (const auto& op : ops) {
+            total += op.total_ms;
+        }
+        std::snprintf(line, sizeof(line), "%s: %.1f ms in graph nodes\n", kPhaseNames[phase], total);
+        out += line;
+        std::snprintf(line, sizeof(line), "  %-20s %10s %12s %7s\n", "op", "calls", "total ms", "share");
+        out += line;
+        for (const auto& op : ops) {
+            std::snprintf(line, sizeof(line), "  %-20s %10llu %12.2f %6.1f%%\n", op.name.c_str(),
+                          static_cast<unsigned long long>(op.calls), op.total_ms,
+                          total > 0.0 ? 100.0 * op.total_ms / total : 0.0);
+            out += line;
+        }
+        std::snprintf(line, sizeof(line), "  %-20s %10s %12s %7s\n", "layer", "calls", "total ms", "share");
+        out += line;
+        for (const auto& layer : layers) {
+            std::snprintf(line, sizeof(line), "  %-20s %10llu %12.2f %6.1f%%\n",
+                          layer.name == "-1" ? "other" : layer.name.c_str(),
+                          static_cast<unsigned long long>(layer.calls), layer.total_ms,
+                          total > 0.0 ? 100.0 * layer.total_ms / total : 0.0);
+            out += line;
+        }
+    }
+    return out;
+}
+
+std::string OpProfiler::json() {
+    std::string out = "{";
+    char line[160];
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        double total;
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            total = phase_total_ms(phase);
+        }
+        std::snprintf(line, sizeof(line), "%s\"%s\": {\"total_ms\": %.3f, \"ops\": [",
+                      phase ? ", " : "", kPhaseNames[phase], total);
+        out += line;
+        const std::vector<OpProfileEntry> ops = by_op(static_cast<Phase>(phase));
+        for (size_t i = 0; i < ops.size(); ++i) {
+            std::snprintf(line, sizeof(line), "%s{\"op\": \"%s\", \"calls\": %llu, \"total_ms\": %.3f}",
+                          i ? ", " : "", ops[i].name.c_str(),
+                          static_cast<unsigned long long>(ops[i].calls), ops[i].total_ms);
+            out += line;
+        }
+        out += "], \"layers\": [";
+        const std::vector<OpProfileEntry> layers = by_layer(static_cast<Phase>(phase));
+        for (size_t i = 0; i < layers.size(); ++i) {
+            std::snprintf(line, sizeof(line), "%s{\"layer\": %s, \"calls\": %llu, \"total_ms\": %.3f}",
+                          i ? ", " : "", layers[i].name.c_str(),
+                          static_cast<unsigned long long>(layers[i].calls), layers[i].total_ms);
+            out += line;
+        }
+        out += "]}";
+    }
+    out += "}";
+    return out;
+}
+
+#endif // NASEER_OP_PROFILER
@@ -0,0 +1,60 @@
+#ifndef OP_PROFILER_H
+#define OP_PROFILER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Per-op and per-layer wall time of llama.cpp graphs, collected through the
+// scheduler's cb_eval callback. While profiling, every graph node runs as its
+// own sub-graph followed by a backend sync, so absolute throughput drops;
+// the split between ops and layers is what it is for.
+//
+// Debug tooling only: compiled into Debug builds with -DNASEER_OP_PROFILER=ON,
+// and absent from every other configuration, where OP_PROFILER_PHASE
+// expands to nothing.
+#ifndef NASEER_OP_PROFILER
+#define NASEER_OP_PROFILER 0
+#endif
+
+#if NASEER_OP_PROFILER
+
+struct ggml_tensor;
+
+struct OpProfileEntry {
+    std::string name;   // op name, or layer index ("-1" for tensors outside layers)
+    uint64_t calls = 0;
+    double total_ms = 0.0;
+};
+
+class OpProfiler {
+public:
+    enum Phase { Prefill, Decode, PhaseCount };
+
+    static void set_enabled(bool enabled);
+    static bool enabled();
+    // Phase the following graph evaluations are attributed to
+    static void set_phase(Phase phase);
+    static void reset();
+
+    // ggml_backend_sched_eval_callback; install as llama_context_params.cb_eval
+    static bool eval_callback(ggml_tensor* tensor, bool ask, void* user_data);
+
+    // Sorted by total time, slowest first
+    static std::vector<OpProfileEntry> by_op(Phase phase);
+    // Sorted by layer index; tensors outside the layers come first
+    static std::vector<OpProfileEntry> by_layer(Phase phase);
+
+    static std::string table();
+    static std::string json();
+};
+
+#define OP_PROFILER_PHASE(phase) OpProfiler::set_phase(OpProfiler::phase)
+
+#else
+
+#define OP_PROFILER_PHASE(phase) ((void)0)
+
+#endif
+
+#endif // OP_PROFILER_H
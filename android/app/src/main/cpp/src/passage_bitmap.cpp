@@ -0,0 +1,100 @@
+#include "passage_bitmap.h"
+#include <algorithm>
+
+bool PassageBitmap::Chunk::contains(uint16_t low) const {
+    if (is_bitmap()) {
+        return (bits[low >> 6] >> (low & 63)) & 1ULL;
+    }
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+void PassageBitmap::Chunk::add(uint16_t low) {
+    if (is_bitmap()) {
+        uint64_t mask = 1ULL << (low & 63);
+        if (!(bits[low >> 6] & mask)) {
+            bits[low >> 6] |= mask;
+            count++;
+        }
+        return;
+    }
+
+    auto it = std::lower_bound(array.begin(), array.end(), low);
+    if (it != array.end() && *it == low) {
+        return;
+    }
+    array.insert(it, low);
+    count++;
+
+    if (array.size() > kArrayLimit) {
+        bits.assign(kBitmapWords, 0);
+        for (uint16_t value : array) {
+            bits[value >> 6] |= 1ULL << (value & 63);
+        }
+        array.clear();
+        array.shrink_to_fit();
+    }
+}
+
+const PassageBitmap::Chunk* PassageBitmap::find_chunk(uint16_t key) const {
+    auto it = std::lower_bound(m_chunks.begin(), m_chunks.end(), key,
+                               [](const Chunk& chunk, uint16_t k) { return chunk.key < k; });
+    return (it != m_chunks.end() && it->key == key) ? &*it : nullptr;
+}
+
+void PassageBitmap::add(uint32_t id) {
+    uint16_t key = static_cast<uint16_t>(id >> 16);
+    auto it = std::lower_bound(m_chunks.begin(), m_chunks.end(), key,
+                               [](const Chunk& chunk, uint16_t k) { return chunk.key < k; });
+    if (it == m_chunks.end() || it->key != key) {
+        Chunk chunk;
+        chunk.key = key;
+        it = m_chunks.insert(it, std::move(chunk));
+    }
+    it->add(static_cast<uint16_t>(id & 0xFFFF));
+}
+
+void PassageBitmap::add_many(const std::vector<uint32_t>& ids) {
+    for (uint32_t id : ids) {
+        add(id);
+    }
+}
+
+bool PassageBitmap::contains(uint32_t id) const {
+    const Chunk* chunk = find_chunk(static_cast<uint16_t>(id >> 16));
+    return chunk && chunk->contains(static_cast<uint16_t>(id & 0xFFFF));
+}
+
+bool PassageBitmap::intersects_range(uint32_t first, uint32_t last) const {
+    for (const Chunk& chunk : m_chunks) {
+        uint32_t base = static_cast<uint32_t>(chunk.key) << 16;
+        if (base + 0xFFFF < first) {
+            continue;
+        }
+        if (base > last) {
+            break;
+        }
+        uint32_t lo = std::max(first, base) - base;
+        uint32_t hi = std::min<uint32_t>(last, base + 0xFFFF) - base;
+        if (chunk.is_bitmap()) {
+            for (uint32_t v = lo; v <= hi; ++v) {
+                if ((chunk.bits[v >> 6] >> (v & 63)) & 1ULL) {
+                    return true;
+                }
+            }
+        } else {
+            auto it = std::lower_bound(chunk.array.begin(), chunk.array.end(), static_cast<uint16_t>(lo));
+            if (it != chunk.array.end() && *it <= hi) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+size_t PassageBitmap::cardinality() const {
+    size_t total = 0;
+    for (const Chunk& chunk : m_chunks) {
+        total += chunk.count;
+    }
+    return total;
+}
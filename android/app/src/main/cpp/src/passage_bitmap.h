@@ -0,0 +1,41 @@
+#ifndef PASSAGE_BITMAP_H
+#define PASSAGE_BITMAP_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Roaring-style compressed set of passage ids. Ids are split by their high
+// 16 bits into chunks; each chunk is a sorted array while sparse and
+// switches to a 65536-bit bitmap once it holds more than 4096 ids.
+class PassageBitmap {
+public:
+    void add(uint32_t id);
+    void add_many(const std::vector<uint32_t>& ids);
+
+    bool contains(uint32_t id) const;
+    bool intersects_range(uint32_t first, uint32_t last) const;
+    size_t cardinality() const;
+    bool empty() const { return m_chunks.empty(); }
+
+private:
+    static constexpr size_t kArrayLimit = 4096;
+    static constexpr size_t kBitmapWords = 65536 / 64;
+
+    struct Chunk {
+        uint16_t key = 0;
+        std::vector<uint16_t> array; // sorted, used while sparse
+        std::vector<uint64_t> bits;  // kBitmapWords words once dense
+        size_t count = 0;
+
+        bool is_bitmap() const { return !bits.empty(); }
+        bool contains(uint16_t low) const;
+        void add(uint16_t low);
+    };
+
+    std::vector<Chunk> m_chunks; // sorted by key
+
+    const Chunk* find_chunk(uint16_t key) const;
+};
+
+#endif // PASSAGE_BITMAP_H
@@ -0,0 +1,228 @@
+#include "perf_counters.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+std::atomic<bool> PerfCounters::s_enabled{false};
+
+#if defined(__linux__)
+
+namespace {
+
+struct EventSpec {
+    uint32_t type;
+    uint64_t config;
+};
+
+const EventSpec kEvents[] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16)},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+};
+
+// Members of a group start with their leader, so only a leader is disabled
+int open_event(const EventSpec& spec, pid_t tid, int group_fd = -1) {
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = spec.type;
+    attr.config = spec.config;
+    attr.disabled = group_fd < 0 ? 1 : 0;
+    attr.inherit = 1;
+    // User space only, which perf_event_paranoid 2 still allows
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, tid, -1, group_fd, 0));
+}
+
+std::string thread_name(pid_t tid) {
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/self/task/%d/comm", static_cast<int>(tid));
+    std::string name;
+    if (FILE* file = std::fopen(path, "r")) {
+        char buffer[32];
+        if (std::fgets(buffer, sizeof(buffer), file)) {
+            name = buffer;
+            while (!name.empty() && name.back() == '\n') {
+                name.pop_back();
+            }
+        }
+        std::fclose(file);
+    }
+    return name;
+}
+
+std::vector<pid_t> process_threads() {
+    std::vector<pid_t> tids;
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir) {
+        return tids;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            tids.push_back(static_cast<pid_t>(std::atoi(entry->d_name)));
+        }
+    }
+    closedir(dir);
+    return tids;
+}
+
+// The calling thread first, then the workers it spawned
+std::vector<pid_t> inference_threads() {
+    const pid_t self = static_cast<pid_t>(syscall(SYS_gettid));
+    std::vector<pid_t> tids = {self};
+    const std::string name = thread_name(self);
+    if (name.empty()) {
+        return tids;
+    }
+    for (pid_t tid : process_threads()) {
+        if (tid != self && thread_name(tid) == name) {
+            tids.push_back(tid);
+        }
+    }
+    return tids;
+}
+
+// Count scaled up by how long the counter was actually on the PMU
+bool read_scaled(int fd, double& value) {
+    uint64_t data[3] = {0, 0, 0}; // value, time enabled, time running
+    if (read(fd, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) {
+        return false;
+    }
+    if (data[2] == 0) {
+        value = 0.0;
+        return data[1] == 0;
+    }
+    value = static_cast<double>(data[0]) * data[1] / data[2];
+    return true;
+}
+
+} // namespace
+
+PerfCounters::~PerfCounters() {
+    close_all();
+}
+
+void PerfCounters::set_enabled(bool enabled) {
+    s_enabled.store(enabled && supported(), std::memory_order_relaxed);
+}
+
+bool PerfCounters::supported() {
+    static const bool supported = [] {
+        int fd = open_event(kEvents[TaskClock], 0);
+        if (fd < 0) {
+            return false;
+        }
+        close(fd);
+        return true;
+    }();
+    return supported;
+}
+
+bool PerfCounters::start() {
+    close_all();
+    if (!enabled()) {
+        return false;
+    }
+    for (pid_t tid : inference_threads()) {
+        int leader = open_event(kEvents[Cycles], tid);
+        if (leader < 0) {
+            // No hardware PMU for this thread; task clock still works
+            int fd = open_event(kEvents[TaskClock], tid);
+            if (fd >= 0) {
+                m_fds[TaskClock].push_back(fd);
+                m_leaders.push_back(fd);
+            }
+            continue;
+        }
+        m_fds[Cycles].push_back(leader);
+        m_leaders.push_back(leader);
+        for (int event = Cycles + 1; event < EventCount; ++event) {
+            int fd = open_event(kEvents[event], tid, leader);
+            if (fd >= 0) {
+                m_fds[event].push_back(fd);
+            }
+        }
+    }
+    for (int fd : m_leaders) {
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    m_running = true;
+    return true;
+}
+
+PerfSample PerfCounters::stop() {
+    PerfSample sample;
+    if (!m_running) {
+        return sample;
+    }
+    for (int fd : m_leaders) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    double totals[EventCount];
+    for (int event = 0; event < EventCount; ++event) {
+        totals[event] = -1.0;
+        for (int fd : m_fds[event]) {
+            double value;
+            if (read_scaled(fd, value)) {
+                totals[event] = std::max(totals[event], 0.0) + value;
+            }
+        }
+    }
+    sample.cycles = totals[Cycles] >= 0.0 ? static_cast<int64_t>(totals[Cycles]) : -1;
+    sample.instructions = totals[Instructions] >= 0.0 ? static_cast<int64_t>(totals[Instructions]) : -1;
+    sample.cache_misses = totals[CacheMisses] >= 0.0 ? static_cast<int64_t>(totals[CacheMisses]) : -1;
+    sample.llc_loads = totals[LlcLoads] >= 0.0 ? static_cast<int64_t>(totals[LlcLoads]) : -1;
+    sample.task_clock_ms = totals[TaskClock] >= 0.0 ? totals[TaskClock] / 1e6 : -1.0;
+
+    close_all();
+    return sample;
+}
+
+void PerfCounters::close_all() {
+    for (auto& fds : m_fds) {
+        for (int fd : fds) {
+            close(fd);
+        }
+        fds.clear();
+    }
+    m_leaders.clear();
+    m_running = false;
+}
+
+#else
+
+PerfCounters::~PerfCounters() = default;
+
+void PerfCounters::set_enabled(bool) {}
+
+bool PerfCounters::supported() {
+    return false;
+}
+
+bool PerfCounters::start() {
+    return false;
+}
+
+PerfSample PerfCounters::stop() {
+    return PerfSample();
+}
+
+void PerfCounters::close_all() {}
+
+#endif
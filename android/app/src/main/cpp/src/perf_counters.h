@@ -0,0 +1,61 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+// Hardware counters of one phase, summed over the inference threads.
+// A counter the kernel or PMU does not provide stays at -1.
+struct PerfSample {
+    int64_t cycles = -1;
+    int64_t instructions = -1;
+    int64_t cache_misses = -1;
+    int64_t llc_loads = -1;
+    double task_clock_ms = -1.0;
+
+    bool valid() const { return task_clock_ms >= 0.0 || cycles >= 0; }
+};
+
+// Counts user-space events with perf_event_open around a phase such as
+// prefill. start() counts the calling thread and the threads that share its
+// name, which is how llama.cpp's workers appear since a new thread inherits
+// its creator's name; Flutter, GC and binder threads are left out. Counters
+// are inherited, so workers spawned during the phase are counted too.
+//
+// Each thread's events form one group led by cycles, so the kernel
+// schedules them together and ratios such as IPC come from the same time
+// window. Values are scaled when the kernel multiplexes the group.
+//
+// Off by default: opening counters costs a few syscalls per thread, and
+// Android only allows it when perf_event_paranoid permits.
+class PerfCounters {
+public:
+    PerfCounters() = default;
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    static void set_enabled(bool enabled);
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    // Whether this process may open counters at all
+    static bool supported();
+
+    // No-op returning false while disabled or unsupported
+    bool start();
+    PerfSample stop();
+
+private:
+    enum Event { Cycles, Instructions, CacheMisses, LlcLoads, TaskClock, EventCount };
+
+    std::vector<int> m_fds[EventCount];
+    std::vector<int> m_leaders; // enabling these starts their whole group
+    bool m_running = false;
+
+    static std::atomic<bool> s_enabled;
+
+    void close_all();
+};
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,115 @@
+#include "query_cache.h"
+#include <algorithm>
+#include <cctype>
+
+QueryCache::QueryCache(size_t capacity) : m_capacity(capacity) {}
+
+std::string QueryCache::normalize_query(const std::string& query) {
+    // Case and whitespace never change the query embedding or keyword set,
+    // and neither does trailing sentence punctuation
+    std::string normalized;
+    normalized.reserve(query.size());
+    bool pending_space = false;
+    for (unsigned char c : query) {
+        if (std::isspace(c)) {
+            pending_space = !normalized.empty();
+            continue;
+        }
+        if (pending_space) {
+            normalized.push_back(' ');
+            pending_space = false;
+        }
+        normalized.push_back(static_cast<char>(std::tolower(c)));
+    }
+    while (!normalized.empty() &&
+           (normalized.back() == '?' || normalized.back() == '!' ||
+            normalized.back() == '.' || normalized.back() == ' ')) {
+        normalized.pop_back();
+    }
+    return normalized;
+}
+
+std::string QueryCache::make_key(const std::string& query, int dim, const std::string& scope) {
+    return std::to_string(dim) + '\x1f' + scope + '\x1f' + normalize_query(query);
+}
+
+bool QueryCache::sync_version_locked(uint64_t version) {
+    if (version < m_version) {
+        return false; // caller raced with a segment change
+    }
+    if (version > m_version) {
+        m_lru.clear();
+        m_entries.clear();
+        m_version = version;
+    }
+    return true;
+}
+
+bool QueryCache::lookup(const std::string& query, int dim, const std::string& scope, uint64_t version,
+                        int max_results, std::vector<SearchHit>& hits, int& total_results) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!sync_version_locked(version)) {
+        m_misses++;
+        return false;
+    }
+
+    auto it = m_entries.find(make_key(query, dim, scope));
+    if (it == m_entries.end()) {
+        m_misses++;
+        return false;
+    }
+
+    const Entry& entry = *it->second;
+    // A cached top-k only answers requests for k or fewer results, unless
+    // it already holds every match
+    if (max_results > static_cast<int>(entry.hits.size()) &&
+        static_cast<int>(entry.hits.size()) < entry.total_results) {
+        m_misses++;
+        return false;
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    size_t k = std::min(entry.hits.size(), static_cast<size_t>(std::max(0, max_results)));
+    hits.assign(entry.hits.begin(), entry.hits.begin() + k);
+    total_results = entry.total_results;
+    m_hits++;
+    return true;
+}
+
+void QueryCache::store(const std::string& query, int dim, const std::string& scope, uint64_t version,
+                       const std::vector<SearchHit>& hits, int total_results) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_capacity == 0 || !sync_version_locked(version)) {
+        return;
+    }
+
+    std::string key = make_key(query, dim, scope);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        m_lru.erase(it->second);
+        m_entries.erase(it);
+    }
+
+    m_lru.push_front(Entry{key, hits, total_results});
+    m_entries[key] = m_lru.begin();
+
+    while (m_lru.size() > m_capacity) {
+        m_entries.erase(m_lru.back().key);
+        m_lru.pop_back();
+    }
+}
+
+void QueryCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lru.clear();
+    m_entries.clear();
+}
+
+void QueryCache::set_capacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_capacity = capacity;
+    while (m_lru.size() > m_capacity) {
+        m_entries.erase(m_lru.back().key);
+        m_lru.pop_back();
+    }
+}
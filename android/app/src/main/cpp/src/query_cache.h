@@ -0,0 +1,53 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <cstdint>
+#include "capsule_index.h"
+
+// LRU cache of capsule search results. Entries are keyed by the normalized
+// query text and the index version they were computed against, so any
+// segment change makes older entries unreachable.
+class QueryCache {
+public:
+    explicit QueryCache(size_t capacity = 128);
+
+    // scope distinguishes searches over different capsule filters
+    bool lookup(const std::string& query, int dim, const std::string& scope, uint64_t version,
+                int max_results, std::vector<SearchHit>& hits, int& total_results);
+    void store(const std::string& query, int dim, const std::string& scope, uint64_t version,
+               const std::vector<SearchHit>& hits, int total_results);
+
+    void clear();
+    void set_capacity(size_t capacity);
+
+    uint64_t hit_count() const { return m_hits; }
+    uint64_t miss_count() const { return m_misses; }
+
+    static std::string normalize_query(const std::string& query);
+
+private:
+    struct Entry {
+        std::string key;
+        std::vector<SearchHit> hits;
+        int total_results = 0;
+    };
+
+    std::mutex m_mutex;
+    size_t m_capacity;
+    uint64_t m_version = 0;
+    std::list<Entry> m_lru; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_entries;
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+
+    static std::string make_key(const std::string& query, int dim, const std::string& scope);
+    bool sync_version_locked(uint64_t version);
+};
+
+#endif // QUERY_CACHE_H
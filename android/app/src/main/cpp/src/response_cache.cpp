@@ -0,0 +1,424 @@
+#include "response_cache.h"
+#include "native_log.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char kMagic[4] = {'N', 'R', 'C', 'L'};
+constexpr uint32_t kVersion = 1;
+constexpr uint64_t kHeaderBytes = 16;
+constexpr uint64_t kRecordHeaderBytes = 32;
+constexpr uint32_t kPut = 1;
+constexpr uint32_t kErase = 2;
+constexpr uint64_t kMinMapBytes = 1 << 20;
+// Dead records below this are not worth a rewrite
+constexpr uint64_t kMinCompactBytes = 64 << 10;
+
+uint64_t padded(uint64_t length) {
+    return (length + 7) & ~uint64_t{7};
+}
+
+uint64_t record_bytes(uint32_t value_length) {
+    return kRecordHeaderBytes + padded(value_length);
+}
+
+uint64_t fnv1a(const char* data, size_t length, uint64_t hash) {
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// splitmix64 finalizer
+uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+uint64_t checksum(uint32_t type, const ResponseKey& key, const char* value, uint32_t length) {
+    return mix(fnv1a(value, length, key.hi ^ mix(key.lo + type) ^ length));
+}
+
+bool write_all(int fd, const char* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        const ssize_t written = ::pwrite(fd, data, length, static_cast<off_t>(offset));
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+
+std::vector<char> encode_record(uint32_t type, const ResponseKey& key, const char* value, uint32_t length) {
+    std::vector<char> record(record_bytes(length), 0);
+    const uint64_t sum = checksum(type, key, value, length);
+    std::memcpy(&record[0], &type, 4);
+    std::memcpy(&record[4], &length, 4);
+    std::memcpy(&record[8], &key.hi, 8);
+    std::memcpy(&record[16], &key.lo, 8);
+    std::memcpy(&record[24], &sum, 8);
+    if (length > 0) {
+        std::memcpy(&record[kRecordHeaderBytes], value, length);
+    }
+    return record;
+}
+
+bool write_header(int fd) {
+    char header[kHeaderBytes] = {};
+    std::memcpy(header, kMagic, sizeof(kMagic));
+    std::memcpy(header + 4, &kVersion, sizeof(kVersion));
+    return write_all(fd, header, sizeof(header), 0);
+}
+
+} // namespace
+
+ResponseCache::~ResponseCache() {
+    close();
+}
+
+ResponseKey ResponseCache::make_key(const std::string& prompt, const std::string& fingerprint,
+                                    const std::string& scope) {
+    std::string material = fingerprint + '\x1f' + scope + '\x1f';
+    material.reserve(material.size() + prompt.size());
+    bool pending_space = false;
+    const size_t prefix = material.size();
+    for (unsigned char c : prompt) {
+        if (std::isspace(c)) {
+            pending_space = material.size() > prefix;
+            continue;
+        }
+        if (pending_space) {
+            material.push_back(' ');
+            pending_space = false;
+        }
+        material.push_back(static_cast<char>(c));
+    }
+
+    ResponseKey key;
+    key.hi = mix(fnv1a(material.data(), material.size(), 1469598103934665603ULL));
+    key.lo = mix(fnv1a(material.data(), material.size(), 0x9e3779b97f4a7c15ULL) ^ material.size());
+    return key;
+}
+
+bool ResponseCache::open(const std::string& path, uint64_t max_bytes, std::string& error) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    close_locked();
+    m_capacity = max_bytes;
+    return open_locked(path, error);
+}
+
+bool ResponseCache::open_locked(const std::string& path, std::string& error) {
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (m_fd < 0) {
+        error = "cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    m_path = path;
+
+    struct stat info;
+    char header[kHeaderBytes] = {};
+    const bool has_header = ::fstat(m_fd, &info) == 0 && static_cast<uint64_t>(info.st_size) >= kHeaderBytes &&
+                            ::pread(m_fd, header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header));
+    uint32_t version = 0;
+    std::memcpy(&version, header + 4, sizeof(version));
+    if (!has_header || std::memcmp(header, kMagic, sizeof(kMagic)) != 0 || version != kVersion) {
+        if (has_header) {
+            NLOG_WARN("cache", "Discarding %s: not a version %u response log", path.c_str(), kVersion);
+        }
+        if (::ftruncate(m_fd, 0) != 0 || !write_header(m_fd)) {
+            error = "cannot initialize " + path;
+            close_locked();
+            return false;
+        }
+        m_file_size = kHeaderBytes;
+    } else {
+        m_file_size = static_cast<uint64_t>(info.st_size);
+    }
+
+    if (!map_locked(m_file_size) || !replay_locked()) {
+        error = "cannot map " + path;
+        close_locked();
+        return false;
+    }
+    evict_locked();
+    compact_locked();
+    return true;
+}
+
+void ResponseCache::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    close_locked();
+}
+
+void ResponseCache::close_locked() {
+    if (m_map) {
+        ::munmap(const_cast<char*>(m_map), m_map_length);
+        m_map = nullptr;
+        m_map_length = 0;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_lru.clear();
+    m_entries.clear();
+    m_file_size = 0;
+    m_live_bytes = 0;
+}
+
+bool ResponseCache::is_open() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_fd >= 0;
+}
+
+// Maps at least length bytes. The mapping may extend past the end of the
+// file; only bytes below m_file_size are ever read.
+bool ResponseCache::map_locked(uint64_t length) {
+    if (m_map && length <= m_map_length) {
+        return true;
+    }
+    uint64_t map_length = std::max(kMinMapBytes, m_map_length);
+    while (map_length < length) {
+        map_length *= 2;
+    }
+    if (m_map) {
+        ::munmap(const_cast<char*>(m_map), m_map_length);
+        m_map = nullptr;
+        m_map_length = 0;
+    }
+    void* map = ::mmap(nullptr, map_length, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    m_map = static_cast<const char*>(map);
+    m_map_length = map_length;
+    return true;
+}
+
+bool ResponseCache::replay_locked() {
+    uint64_t pos = kHeaderBytes;
+    while (pos + kRecordHeaderBytes <= m_file_size) {
+        uint32_t type, length;
+        ResponseKey key;
+        uint64_t sum;
+        std::memcpy(&type, m_map + pos, 4);
+        std::memcpy(&length, m_map + pos + 4, 4);
+        std::memcpy(&key.hi, m_map + pos + 8, 8);
+        std::memcpy(&key.lo, m_map + pos + 16, 8);
+        std::memcpy(&sum, m_map + pos + 24, 8);
+        const uint64_t end = pos + record_bytes(length);
+        if ((type != kPut && type != kErase) || (type == kErase && length != 0) || end > m_file_size ||
+            sum != checksum(type, key, m_map + pos + kRecordHeaderBytes, length)) {
+            break;
+        }
+
+        auto it = m_entries.find(key);
+        if (it != m_entries.end()) {
+            erase_locked(it->second, false);
+        }
+        if (type == kPut) {
+            m_lru.push_front({key, pos + kRecordHeaderBytes, length});
+            m_entries[key] = m_lru.begin();
+            m_live_bytes += record_bytes(length);
+        }
+        pos = end;
+    }
+
+    if (pos < m_file_size) {
+        NLOG_WARN("cache", "Dropping %llu bytes of torn or corrupt records from %s",
+                  static_cast<unsigned long long>(m_file_size - pos), m_path.c_str());
+        if (::ftruncate(m_fd, static_cast<off_t>(pos)) != 0) {
+            return false;
+        }
+        m_file_size = pos;
+    }
+    return true;
+}
+
+bool ResponseCache::append_locked(uint32_t type, const ResponseKey& key, const char* value, uint32_t length,
+                                  uint64_t& value_offset) {
+    const std::vector<char> record = encode_record(type, key, value, length);
+    if (!write_all(m_fd, record.data(), record.size(), m_file_size)) {
+        // Leave no partial record behind for the next append to follow
+        if (::ftruncate(m_fd, static_cast<off_t>(m_file_size)) != 0) {
+            NLOG_ERROR("cache", "Cannot truncate %s after a failed append", m_path.c_str());
+        }
+        return false;
+    }
+    value_offset = m_file_size + kRecordHeaderBytes;
+    m_file_size += record.size();
+    if (!map_locked(m_file_size)) {
+        NLOG_ERROR("cache", "Cannot remap %s, closing the response cache", m_path.c_str());
+        close_locked();
+        return false;
+    }
+    return true;
+}
+
+bool ResponseCache::lookup(const ResponseKey& key, std::string& value) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        m_misses++;
+        return false;
+    }
+    const Entry& entry = *it->second;
+    value.assign(m_map + entry.value_offset, entry.value_length);
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    m_hits++;
+    return true;
+}
+
+void ResponseCache::store(const ResponseKey& key, const std::string& value) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fd < 0 || value.size() > UINT32_MAX || record_bytes(static_cast<uint32_t>(value.size())) > m_capacity) {
+        return;
+    }
+    auto it = m_entries.find(key);
+    if (it != m_entries.end() && it->second->value_length == value.size() &&
+        std::memcmp(m_map + it->second->value_offset, value.data(), value.size()) == 0) {
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return;
+    }
+
+    const uint32_t length = static_cast<uint32_t>(value.size());
+    uint64_t offset;
+    if (!append_locked(kPut, key, value.data(), length, offset)) {
+        return;
+    }
+    // The new record supersedes the old one on replay, so no erase is logged
+    it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        erase_locked(it->second, false);
+    }
+    m_lru.push_front({key, offset, length});
+    m_entries[key] = m_lru.begin();
+    m_live_bytes += record_bytes(length);
+    evict_locked();
+    compact_locked();
+}
+
+void ResponseCache::erase_locked(std::list<Entry>::iterator it, bool log) {
+    if (log) {
+        uint64_t unused;
+        append_locked(kErase, it->key, nullptr, 0, unused);
+        if (m_fd < 0) {
+            return; // closed by a failed remap
+        }
+    }
+    m_live_bytes -= record_bytes(it->value_length);
+    m_entries.erase(it->key);
+    m_lru.erase(it);
+}
+
+void ResponseCache::evict_locked() {
+    while (m_fd >= 0 && m_live_bytes > m_capacity && !m_lru.empty()) {
+        erase_locked(std::prev(m_lru.end()), true);
+    }
+}
+
+// Rewrites the log with only the live entries, oldest first, once dead
+// records outweigh them. The new file replaces the old one atomically.
+void ResponseCache::compact_locked() {
+    if (m_fd < 0) {
+        return;
+    }
+    const uint64_t dead = m_file_size - kHeaderBytes - m_live_bytes;
+    if (dead < kMinCompactBytes || dead < m_live_bytes) {
+        return;
+    }
+
+    const std::string temp_path = m_path + ".tmp";
+    const int fd = ::open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    bool ok = fd >= 0 && write_header(fd);
+    uint64_t size = kHeaderBytes;
+    std::vector<uint64_t> offsets;
+    offsets.reserve(m_lru.size());
+    for (auto it = m_lru.rbegin(); ok && it != m_lru.rend(); ++it) {
+        const std::vector<char> record =
+            encode_record(kPut, it->key, m_map + it->value_offset, it->value_length);
+        ok = write_all(fd, record.data(), record.size(), size);
+        offsets.push_back(size + kRecordHeaderBytes);
+        size += record.size();
+    }
+    ok = ok && ::fsync(fd) == 0 && ::rename(temp_path.c_str(), m_path.c_str()) == 0;
+    if (!ok) {
+        NLOG_WARN("cache", "Compaction of %s failed: %s", m_path.c_str(), std::strerror(errno));
+        if (fd >= 0) {
+            ::close(fd);
+            ::unlink(temp_path.c_str());
+        }
+        return;
+    }
+
+    ::munmap(const_cast<char*>(m_map), m_map_length);
+    m_map = nullptr;
+    m_map_length = 0;
+    ::close(m_fd);
+    m_fd = fd;
+    m_file_size = size;
+    size_t index = 0;
+    for (auto it = m_lru.rbegin(); it != m_lru.rend(); ++it) {
+        it->value_offset = offsets[index++];
+    }
+    if (!map_locked(m_file_size)) {
+        NLOG_ERROR("cache", "Cannot map %s after compaction, closing the response cache", m_path.c_str());
+        close_locked();
+        return;
+    }
+    NLOG_INFO("cache", "Compacted %s to %llu bytes (%zu entries)", m_path.c_str(),
+              static_cast<unsigned long long>(size), m_lru.size());
+}
+
+void ResponseCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lru.clear();
+    m_entries.clear();
+    m_live_bytes = 0;
+    if (m_fd >= 0) {
+        if (::ftruncate(m_fd, static_cast<off_t>(kHeaderBytes)) != 0) {
+            NLOG_ERROR("cache", "Cannot truncate %s", m_path.c_str());
+            close_locked();
+            return;
+        }
+        m_file_size = kHeaderBytes;
+    }
+}
+
+void ResponseCache::set_capacity(uint64_t max_bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_capacity = max_bytes;
+    evict_locked();
+    compact_locked();
+}
+
+size_t ResponseCache::entry_count() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+uint64_t ResponseCache::live_bytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_live_bytes;
+}
+
+uint64_t ResponseCache::file_bytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_file_size;
+}
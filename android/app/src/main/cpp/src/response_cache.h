@@ -0,0 +1,95 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <string>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <cstdint>
+
+// 128-bit digest of everything that decides a generation
+struct ResponseKey {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+
+    bool operator==(const ResponseKey& other) const { return hi == other.hi && lo == other.lo; }
+};
+
+// Persistent exact-match cache of model answers. Entries live in an
+// append-only log that is mmapped for reads; an in-memory hash index maps
+// keys to their newest record. Storing past the byte cap evicts least
+// recently used entries, which is logged so they stay gone after a restart.
+// Once dead records make up half the file, it is rewritten with only the
+// live entries.
+//
+// On open the log is replayed, so entries survive restarts. A torn record
+// at the end (the app was killed mid-append) fails its checksum and is cut
+// off. Recency from lookups is not logged: after a restart, entries age
+// from when they were stored, or from the last compaction.
+//
+//   header: char magic[4] = "NRCL"; uint32 version = 1; uint64 reserved
+//   record: uint32 type (1 put, 2 erase); uint32 value_length;
+//           uint64 key_hi, key_lo; uint64 checksum; value; pad to 8 bytes
+class ResponseCache {
+public:
+    ResponseCache() = default;
+    ~ResponseCache();
+
+    // Opens or creates the log and replays it; reopening closes the old one
+    bool open(const std::string& path, uint64_t max_bytes, std::string& error);
+    void close();
+    bool is_open() const;
+
+    bool lookup(const ResponseKey& key, std::string& value);
+    void store(const ResponseKey& key, const std::string& value);
+    void clear();
+    void set_capacity(uint64_t max_bytes);
+
+    uint64_t hit_count() const { return m_hits; }
+    uint64_t miss_count() const { return m_misses; }
+    size_t entry_count() const;
+    uint64_t live_bytes() const;
+    uint64_t file_bytes() const;
+
+    // The prompt with surrounding whitespace trimmed and inner runs
+    // collapsed; case is kept because the model sees it. fingerprint names
+    // the model and sampling settings, scope the capsule set.
+    static ResponseKey make_key(const std::string& prompt, const std::string& fingerprint,
+                                const std::string& scope);
+
+private:
+    struct KeyHash {
+        size_t operator()(const ResponseKey& key) const { return static_cast<size_t>(key.lo); }
+    };
+    struct Entry {
+        ResponseKey key;
+        uint64_t value_offset = 0;
+        uint32_t value_length = 0;
+    };
+
+    mutable std::mutex m_mutex;
+    std::string m_path;
+    int m_fd = -1;
+    const char* m_map = nullptr;
+    uint64_t m_map_length = 0;
+    uint64_t m_file_size = 0;
+    uint64_t m_capacity = 0;
+    uint64_t m_live_bytes = 0;
+    std::list<Entry> m_lru; // most recently used first
+    std::unordered_map<ResponseKey, std::list<Entry>::iterator, KeyHash> m_entries;
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+
+    bool open_locked(const std::string& path, std::string& error);
+    void close_locked();
+    bool map_locked(uint64_t length);
+    bool replay_locked();
+    bool append_locked(uint32_t type, const ResponseKey& key, const char* value, uint32_t length,
+                       uint64_t& value_offset);
+    void erase_locked(std::list<Entry>::iterator it, bool log);
+    void evict_locked();
+    void compact_locked();
+};
+
+#endif // RESPONSE_CACHE_H
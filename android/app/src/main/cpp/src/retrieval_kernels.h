@@ -0,0 +1,71 @@
+#ifndef RETRIEVAL_KERNELS_H
+#define RETRIEVAL_KERNELS_H
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Inner loops shared by the capsule index. Plain loops are written so the
+// compiler can vectorize them at -O3; popcount uses NEON cnt on arm64 and
+// the popcnt instruction where the target enables it.
+namespace retrieval {
+
+inline void normalize(float* vec, int dim) {
+    float norm = 0.0f;
+    for (int i = 0; i < dim; ++i) {
+        norm += vec[i] * vec[i];
+    }
+    if (norm <= 0.0f) {
+        return;
+    }
+    float inv = 1.0f / std::sqrt(norm);
+    for (int i = 0; i < dim; ++i) {
+        vec[i] *= inv;
+    }
+}
+
+inline float dot_product(const float* a, const float* b, int dim) {
+    float sum = 0.0f;
+    for (int i = 0; i < dim; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+inline int code_words(int dim) {
+    return (dim + 63) / 64;
+}
+
+// 1-bit sign quantization: bit i is set when component i is positive
+inline void sign_quantize(const float* vec, int dim, uint64_t* code) {
+    for (int w = 0; w < code_words(dim); ++w) {
+        code[w] = 0;
+    }
+    for (int i = 0; i < dim; ++i) {
+        if (vec[i] > 0.0f) {
+            code[i >> 6] |= 1ULL << (i & 63);
+        }
+    }
+}
+
+inline int hamming_distance(const uint64_t* a, const uint64_t* b, int words) {
+    int distance = 0;
+    int w = 0;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    for (; w + 2 <= words; w += 2) {
+        uint64x2_t x = veorq_u64(vld1q_u64(a + w), vld1q_u64(b + w));
+        distance += vaddvq_u8(vcntq_u8(vreinterpretq_u8_u64(x)));
+    }
+#endif
+    for (; w < words; ++w) {
+        distance += __builtin_popcountll(a[w] ^ b[w]);
+    }
+    return distance;
+}
+
+} // namespace retrieval
+
+#endif // RETRIEVAL_KERNELS_H
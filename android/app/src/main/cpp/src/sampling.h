@@ -0,0 +1,38 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <cmath>
+
+// Logit kernels used for token selection and reranking. They take raw
+// arrays so they can be benchmarked and tested without a model.
+namespace sampling {
+
+// Index of the largest logit; the first one wins ties
+inline int argmax(const float* logits, int n_vocab) {
+    int best = 0;
+    float best_logit = logits[0];
+    for (int i = 1; i < n_vocab; ++i) {
+        if (logits[i] > best_logit) {
+            best_logit = logits[i];
+            best = i;
+        }
+    }
+    return best;
+}
+
+// log softmax(logits)[index], computed stably against the maximum logit
+inline float log_softmax_at(const float* logits, int n_vocab, int index) {
+    float max_logit = logits[0];
+    for (int i = 1; i < n_vocab; ++i) {
+        max_logit = std::fmax(max_logit, logits[i]);
+    }
+    double sum = 0.0;
+    for (int i = 0; i < n_vocab; ++i) {
+        sum += std::exp(logits[i] - max_logit);
+    }
+    return static_cast<float>(logits[index] - max_logit - std::log(sum));
+}
+
+} // namespace sampling
+
+#endif // SAMPLING_H
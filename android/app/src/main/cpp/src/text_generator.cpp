@@ -1,12 +1,79 @@
 #include "text_generator.h"
 #include "model_loader.h"
+#include "trace.h"
+#include "native_log.h"
+#include "op_profiler.h"
+#include "sampling.h"
+#include "retrieval_kernels.h"
 #include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <random>
 #include <ctime>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include "llama.h"
 
+namespace {
+
+// Reranking runs on its own context so it never disturbs the chat KV cache
+constexpr int kMaxRerankCandidates = 16;
+constexpr int kRerankSeqTokens = 192;       // per-candidate prompt budget
+constexpr int kRerankBatchTokens = 1024;    // tokens per decode call
+
+// Prompts are short; longer text is cut to keep the embedding context small
+constexpr int kEmbedTokens = 256;
+
+// Part of generation_fingerprint(); bump whenever an app update changes how
+// prompts are assembled or answers are cleaned up, so cached answers from
+// the old format are never served
+constexpr int kResponseFormatVersion = 1;
+
+void batch_add(llama_batch& batch, llama_token token, llama_pos pos, llama_seq_id seq_id, bool logits) {
+    batch.token[batch.n_tokens] = token;
+    batch.pos[batch.n_tokens] = pos;
+    batch.n_seq_id[batch.n_tokens] = 1;
+    batch.seq_id[batch.n_tokens][0] = seq_id;
+    batch.logits[batch.n_tokens] = logits;
+    batch.n_tokens++;
+}
+
+std::vector<llama_token> tokenize_text(const llama_vocab* vocab, const std::string& text, bool add_special) {
+    int n = llama_tokenize(vocab, text.c_str(), text.length(), nullptr, 0, add_special, true);
+    std::vector<llama_token> tokens(n < 0 ? -n : n);
+    n = llama_tokenize(vocab, text.c_str(), text.length(), tokens.data(), tokens.size(), add_special, true);
+    tokens.resize(n < 0 ? 0 : n);
+    return tokens;
+}
+
+// K and V rows for every cell of every layer, at the default f16 cache type
+uint64_t kv_cache_bytes(const llama_context* ctx) {
+    const llama_model* model = llama_get_model(ctx);
+    const int64_t n_head = llama_model_n_head(model);
+    if (n_head <= 0) {
+        return 0;
+    }
+    const int64_t n_embd_gqa = llama_model_n_embd(model) / n_head * llama_model_n_head_kv(model);
+    return 2 * static_cast<uint64_t>(llama_n_ctx(ctx)) * llama_model_n_layer(model)
+        * ggml_row_size(GGML_TYPE_F16, n_embd_gqa);
+}
+
+// The vocabulary keeps each piece twice, in the id table and the lookup map
+uint64_t vocab_bytes(const llama_vocab* vocab) {
+    const int n_vocab = llama_vocab_n_tokens(vocab);
+    uint64_t bytes = 0;
+    for (int i = 0; i < n_vocab; ++i) {
+        const char* text = llama_vocab_get_text(vocab, i);
+        bytes += 2 * (sizeof(std::string) + (text ? std::strlen(text) : 0));
+        bytes += sizeof(float) + 2 * sizeof(int32_t) + 2 * sizeof(void*);
+    }
+    return bytes;
+}
+
+} // namespace
+
 struct TextGenerator::ModelData {
     // Legacy fields for compatibility
     std::vector<float> weights;
@@ -19,10 +86,26 @@ struct TextGenerator::ModelData {
     // llama.cpp integration
     llama_model* llama_model = nullptr;
     llama_context* llama_context = nullptr;
+    struct llama_context* rerank_context = nullptr;
+    struct llama_context* embed_context = nullptr;
+    std::vector<llama_token> cached_tokens; // tokens currently in llama_context's KV cache
+    uint64_t compute_bytes = 0;             // scheduler buffers of llama_context
+    uint64_t rerank_compute_bytes = 0;
+    uint64_t embed_compute_bytes = 0;
+    uint64_t tokenizer_bytes = 0;           // measured once in load_model
+    int32_t kv_cells_used = 0;              // cached_tokens.size(), under m_memory_mutex
     std::string model_path;
     
     // Destructor to clean up llama.cpp resources
     ~ModelData() {
+        if (rerank_context) {
+            llama_free(rerank_context);
+            rerank_context = nullptr;
+        }
+        if (embed_context) {
+            llama_free(embed_context);
+            embed_context = nullptr;
+        }
         if (llama_context) {
             llama_free(llama_context);
             llama_context = nullptr;
@@ -41,6 +124,7 @@ TextGenerator::TextGenerator() : m_data(std::make_unique<ModelData>()) {
 TextGenerator::~TextGenerator() = default;
 
 bool TextGenerator::load_model(const std::string& model_path) {
+    TRACE_SCOPE("model_load");
     try {
         // Use ModelLoader to load the model with llama.cpp support
         ModelLoader loader;
@@ -61,6 +145,9 @@ bool TextGenerator::load_model(const std::string& model_path) {
             // Prevent double cleanup by nullifying in the temporary object
             model_data.llama_model = nullptr;
             model_data.llama_context = nullptr;
+            if (m_data->llama_model) {
+                m_data->tokenizer_bytes = vocab_bytes(llama_model_get_vocab(m_data->llama_model));
+            }
             
             m_loaded = true;
             return true;
@@ -79,6 +166,7 @@ bool TextGenerator::load_model(const std::string& model_path) {
 }
 
 std::string TextGenerator::generate(const std::string& prompt, int max_tokens) {
+    m_last_stop_reason = StopReason::None;
     if (!m_loaded) {
         return "Error: Model not loaded";
     }
@@ -91,6 +179,7 @@ std::string TextGenerator::generate(const std::string& prompt, int max_tokens) {
     try {
         return generate_with_llama(prompt, max_tokens);
     } catch (const std::exception& e) {
+        NLOG_ERROR("generate", "Inference failed: %s", e.what());
         return "Error during inference: " + std::string(e.what());
     }
 }
@@ -100,55 +189,111 @@ std::string TextGenerator::generate_with_llama(const std::string& prompt, int ma
         return "Error: llama model not loaded";
     }
     
+    using Clock = std::chrono::steady_clock;
+    auto ms_since = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+    TRACE_SCOPE("generate");
+    const auto request_start = Clock::now();
+    RequestMetrics metrics;
+    auto finish = [&](StopReason reason) {
+        metrics.stop_reason = reason;
+        m_last_stop_reason = reason;
+        metrics.total_ms = ms_since(request_start);
+        m_metrics.record(metrics);
+    };
+    
     // Create context if not exists
     if (!m_data->llama_context) {
+        TRACE_SCOPE("context_create");
         llama_context_params ctx_params = llama_context_default_params();
-        ctx_params.n_ctx = 2048;        // Context size
-        ctx_params.n_batch = 512;       // Batch size for prompt processing
-        ctx_params.n_threads = 4;       // Number of threads (good for mobile)
-        
-        m_data->llama_context = llama_init_from_model(m_data->llama_model, ctx_params);
+        ctx_params.n_ctx = m_n_ctx;       // Context size
+        ctx_params.n_batch = m_n_batch;   // Batch size for prompt processing
+        ctx_params.n_threads = m_n_threads; // Number of threads (good for mobile)
+#if NASEER_OP_PROFILER
+        ctx_params.cb_eval = OpProfiler::eval_callback;
+#endif
         
-        if (!m_data->llama_context) {
+        m_data->cached_tokens.clear();
+        if (!create_context(ctx_params, m_data->llama_context, m_data->compute_bytes)) {
+            NLOG_ERROR("generate", "Failed to create context (n_ctx %d, n_batch %d)", m_n_ctx, m_n_batch);
             return "Error: Failed to create llama context";
         }
     }
+    struct llama_context* ctx = m_data->llama_context;
     
     // Tokenize the prompt
+    auto tokenize_start = Clock::now();
     std::vector<llama_token> tokens_list;
-    tokens_list.resize(prompt.length() + 1);
-    
-    const llama_vocab* vocab = llama_model_get_vocab(m_data->llama_model);
-    int n_tokens = llama_tokenize(vocab, prompt.c_str(), prompt.length(), 
-                                  tokens_list.data(), tokens_list.size(), true, true);
-    
-    if (n_tokens < 0) {
-        tokens_list.resize(-n_tokens);
-        n_tokens = llama_tokenize(vocab, prompt.c_str(), prompt.length(), 
-                                  tokens_list.data(), tokens_list.size(), true, true);
-        if (n_tokens < 0) {
-            return "Error: Failed to tokenize prompt";
-        }
+    {
+        TRACE_SCOPE("tokenize");
+        tokens_list = tokenize_prompt(prompt);
+    }
+    metrics.tokenize_ms = ms_since(tokenize_start);
+    const int n_tokens = static_cast<int>(tokens_list.size());
+    metrics.prompt_tokens = n_tokens;
+    if (n_tokens == 0) {
+        finish(StopReason::DecodeError);
+        NLOG_ERROR("generate", "Failed to tokenize prompt of %zu bytes", prompt.size());
+        return "Error: Failed to tokenize prompt";
+    }
+    const int n_ctx = static_cast<int>(llama_n_ctx(ctx));
+    if (n_tokens >= n_ctx) {
+        finish(StopReason::ContextFull);
+        NLOG_WARN("generate", "Prompt of %d tokens exceeds context size %d", n_tokens, n_ctx);
+        return "Error: Prompt exceeds context size";
     }
     
-    tokens_list.resize(n_tokens);
+    std::vector<llama_token>& cached = m_data->cached_tokens;
+    llama_memory_t memory = llama_get_memory(ctx);
+    const size_t n_reuse = reuse_kv_prefix(ctx, tokens_list);
+    metrics.reused_tokens = static_cast<int>(n_reuse);
     
-    // Process the prompt
-    if (llama_decode(m_data->llama_context, llama_batch_get_one(tokens_list.data(), n_tokens))) {
-        return "Error: Failed to process prompt";
+    // Process the prompt in n_batch chunks
+    PerfCounters counters;
+    counters.start();
+    OP_PROFILER_PHASE(Prefill);
+    auto prefill_start = Clock::now();
+    for (size_t pos = n_reuse; pos < tokens_list.size(); pos += m_n_batch) {
+        int chunk = static_cast<int>(std::min<size_t>(m_n_batch, tokens_list.size() - pos));
+        TRACE_SCOPE_ARG("prefill_chunk", chunk);
+        if (llama_decode(ctx, llama_batch_get_one(tokens_list.data() + pos, chunk))) {
+            llama_memory_clear(memory, true);
+            cached.clear();
+            publish_kv_cells();
+            metrics.prefill_counters = counters.stop();
+            finish(StopReason::DecodeError);
+            NLOG_ERROR("generate", "Prefill decode failed at position %zu", pos);
+            return "Error: Failed to process prompt";
+        }
+        cached.insert(cached.end(), tokens_list.begin() + pos, tokens_list.begin() + pos + chunk);
+        publish_kv_cells();
     }
+    metrics.prefill_tokens = n_tokens - static_cast<int>(n_reuse);
+    metrics.prefill_ms = ms_since(prefill_start);
+    metrics.prefill_counters = counters.stop();
     
     // Generate response
     std::string response;
     int n_generated = 0;
+    const llama_vocab* vocab = llama_model_get_vocab(m_data->llama_model);
+    StopReason stop_reason = StopReason::MaxTokens;
+    counters.start();
+    OP_PROFILER_PHASE(Decode);
+    auto decode_start = Clock::now();
     
     while (n_generated < max_tokens) {
         // Sample next token
-        llama_token next_token = sample_token(m_data->llama_context);
+        auto sample_start = Clock::now();
+        llama_token next_token = sample_token(ctx);
+        metrics.sample_ms += ms_since(sample_start);
+        if (n_generated == 0) {
+            metrics.ttft_ms = ms_since(request_start);
+        }
         
         // Check for end of sequence
-        const llama_vocab* vocab = llama_model_get_vocab(m_data->llama_model);
         if (next_token == llama_vocab_eos(vocab)) {
+            stop_reason = StopReason::EndOfSequence;
             break;
         }
         
@@ -160,18 +305,112 @@ std::string TextGenerator::generate_with_llama(const std::string& prompt, int ma
             response.append(token_str, token_len);
         }
         
+        if (static_cast<int>(cached.size()) >= n_ctx) {
+            stop_reason = StopReason::ContextFull;
+            break;
+        }
+        
         // Process the new token
-        if (llama_decode(m_data->llama_context, llama_batch_get_one(&next_token, 1))) {
+        int decode_status;
+        {
+            TRACE_SCOPE("decode");
+            decode_status = llama_decode(ctx, llama_batch_get_one(&next_token, 1));
+        }
+        if (decode_status) {
+            NLOG_ERROR("generate", "Decode failed after %d tokens (status %d)", n_generated, decode_status);
+            llama_memory_clear(memory, true);
+            cached.clear();
+            publish_kv_cells();
+            stop_reason = StopReason::DecodeError;
             break;
         }
+        cached.push_back(next_token);
+        publish_kv_cells();
         
         n_generated++;
     }
     
+    metrics.generated_tokens = n_generated;
+    metrics.decode_ms = ms_since(decode_start);
+    metrics.decode_counters = counters.stop();
+    finish(stop_reason);
     return response;
 }
 
+// Keeps the KV entries of the prefix shared with the previous request
+// (system prompt, earlier turns) and drops the rest; returns how many
+// tokens are kept. At least one prompt token is always left to decode so
+// there are fresh logits to sample from.
+size_t TextGenerator::reuse_kv_prefix(llama_context* ctx, const std::vector<llama_token>& tokens) {
+    std::vector<llama_token>& cached = m_data->cached_tokens;
+    llama_memory_t memory = llama_get_memory(ctx);
+    size_t n_reuse = 0;
+    if (m_prefix_reuse) {
+        while (n_reuse < cached.size() && n_reuse < tokens.size() && cached[n_reuse] == tokens[n_reuse]) {
+            n_reuse++;
+        }
+        n_reuse = std::min(n_reuse, tokens.size() - 1);
+    }
+    if (n_reuse == 0 || !llama_memory_seq_rm(memory, 0, static_cast<llama_pos>(n_reuse), -1)) {
+        llama_memory_clear(memory, true);
+        n_reuse = 0;
+    }
+    cached.resize(n_reuse);
+    publish_kv_cells();
+    return n_reuse;
+}
+
+std::string TextGenerator::generation_fingerprint(int max_tokens) const {
+    if (m_data->use_pattern_fallback || !m_data->llama_model) {
+        return "";
+    }
+    char desc[128] = {};
+    llama_model_desc(m_data->llama_model, desc, sizeof(desc));
+    char fingerprint[384];
+    std::snprintf(fingerprint, sizeof(fingerprint), "v%d %s/%llu/%llu ctx=%d batch=%d t=%.3f k=%d p=%.3f max=%d",
+                  kResponseFormatVersion, desc,
+                  static_cast<unsigned long long>(llama_model_size(m_data->llama_model)),
+                  static_cast<unsigned long long>(llama_model_n_params(m_data->llama_model)), m_n_ctx, m_n_batch,
+                  m_temperature, m_top_k, m_top_p, max_tokens);
+    return fingerprint;
+}
+
+void TextGenerator::record_cache_hit(double total_ms) {
+    m_last_stop_reason = StopReason::CacheHit;
+    RequestMetrics metrics;
+    metrics.stop_reason = StopReason::CacheHit;
+    metrics.total_ms = total_ms;
+    m_metrics.record(metrics);
+}
+
+void TextGenerator::discard_packed_context() {
+    m_pending_context.clear();
+    m_pending_context_tokens.clear();
+}
+
+std::vector<llama_token> TextGenerator::tokenize_prompt(const std::string& prompt) {
+    const llama_vocab* vocab = llama_model_get_vocab(m_data->llama_model);
+    
+    // Reuse the ids of a packed context instead of tokenizing it again
+    size_t context_pos = m_pending_context.empty() ? std::string::npos : prompt.find(m_pending_context);
+    std::vector<llama_token> tokens;
+    if (context_pos == std::string::npos) {
+        tokens = tokenize_text(vocab, prompt, true);
+    } else {
+        tokens = tokenize_text(vocab, prompt.substr(0, context_pos), true);
+        tokens.insert(tokens.end(), m_pending_context_tokens.begin(), m_pending_context_tokens.end());
+        std::vector<llama_token> suffix = tokenize_text(
+            vocab, prompt.substr(context_pos + m_pending_context.size()), false);
+        tokens.insert(tokens.end(), suffix.begin(), suffix.end());
+    }
+    
+    m_pending_context.clear();
+    m_pending_context_tokens.clear();
+    return tokens;
+}
+
 llama_token TextGenerator::sample_token(llama_context* ctx) {
+    TRACE_SCOPE("sample");
     // Get logits for the last token
     float* logits = llama_get_logits_ith(ctx, -1);
     const llama_vocab* vocab = llama_model_get_vocab(llama_get_model(ctx));
@@ -179,132 +418,299 @@ llama_token TextGenerator::sample_token(llama_context* ctx) {
     
     // Simple greedy sampling (take the most likely token)
     // For better results, you could implement temperature sampling, top-k, or top-p
-    llama_token max_token = 0;
-    float max_logit = logits[0];
-    
-    for (int i = 1; i < n_vocab; i++) {
-        if (logits[i] > max_logit) {
-            max_logit = logits[i];
-            max_token = i;
-        }
-    }
-    
-    return max_token;
+    return sampling::argmax(logits, n_vocab);
 }
 
 std::string TextGenerator::generate_pattern_response(const std::string& prompt) {
-    std::string lower_prompt = prompt;
-    std::transform(lower_prompt.begin(), lower_prompt.end(), lower_prompt.begin(), ::tolower);
-    
-    // Emergency and safety responses (highest priority for Gaza context)
-    if (lower_prompt.find("emergency") != std::string::npos ||
-        lower_prompt.find("danger") != std::string::npos ||
-        lower_prompt.find("help") != std::string::npos) {
-        return "I understand this may be an emergency situation. For immediate safety:\n\n1. Move to the safest available location\n2. Stay low if there's debris or smoke\n3. Check for injuries and provide basic first aid\n4. Signal for help if possible\n5. Conserve water, food, and battery power\n\nWhat specific emergency assistance do you need?";
+    std::string answer = m_fallback_table->answer(prompt);
+    if (answer.empty()) {
+        answer = m_fallback_table->default_response(FallbackTable::detect_language(prompt));
     }
-    
-    // Water purification (critical for survival)
-    if (lower_prompt.find("water") != std::string::npos && 
-        (lower_prompt.find("clean") != std::string::npos || lower_prompt.find("purify") != std::string::npos)) {
-        return "Water purification methods using available materials:\n\n**Immediate options:**\n• Boiling: Use any heat source for 1-3 minutes\n• Solar disinfection: Clear bottles in direct sunlight for 6+ hours\n• Sand filtration: Layer fine sand, gravel, cloth in container\n\n**Materials needed:**\n• Cloth or fabric for initial filtering\n• Sand and gravel (if available)\n• Clear containers or bottles\n• Heat source (wood, solar cooker)\n\nThese methods remove most harmful bacteria and particles. Always use the clearest water source available as starting point.";
+    return answer;
+}
+
+bool TextGenerator::create_rerank_context(size_t candidates) {
+    TRACE_SCOPE("context_create");
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = static_cast<uint32_t>(candidates * kRerankSeqTokens);
+    ctx_params.n_batch = std::min<uint32_t>(kRerankBatchTokens, ctx_params.n_ctx);
+    ctx_params.n_seq_max = static_cast<uint32_t>(candidates);
+    ctx_params.n_threads = m_n_threads;
+    ctx_params.n_threads_batch = m_n_threads;
+    return create_context(ctx_params, m_data->rerank_context, m_data->rerank_compute_bytes);
+}
+
+void TextGenerator::free_rerank_context() {
+    std::lock_guard<std::mutex> lock(m_memory_mutex);
+    if (m_data->rerank_context) {
+        llama_free(m_data->rerank_context);
+        m_data->rerank_context = nullptr;
     }
-    
-    // Medical and first aid
-    if (lower_prompt.find("medical") != std::string::npos ||
-        lower_prompt.find("injury") != std::string::npos ||
-        lower_prompt.find("first aid") != std::string::npos) {
-        return "Basic first aid using available materials:\n\n**For wounds:**\n• Clean cloth or fabric for bandages\n• Clean water for washing\n• Apply direct pressure to stop bleeding\n• Elevate injured area if possible\n\n**For burns:**\n• Cool running water or clean wet cloth\n• Avoid ice or very cold water\n• Cover with clean, dry cloth\n\n**Important:** These are emergency measures. Seek professional medical help when possible.";
+    m_data->rerank_compute_bytes = 0;
+}
+
+bool TextGenerator::ensure_embed_context() {
+    if (m_data->embed_context) {
+        return true;
     }
-    
-    // Shelter and protection
-    if (lower_prompt.find("shelter") != std::string::npos ||
-        lower_prompt.find("protection") != std::string::npos) {
-        return "Creating protective shelter with available materials:\n\n**Basic structure:**\n• Use walls, debris, or natural features\n• Create windbreaks with fabric, tarps, or boards\n• Insulate from ground with blankets, cardboard, or clothing\n\n**For weather protection:**\n• Slope roof materials to shed water\n• Block wind from dominant direction\n• Create small, enclosed space to retain body heat\n\n**Safety priorities:**\n• Avoid unstable structures\n• Ensure ventilation\n• Have clear exit routes";
+    TRACE_SCOPE("context_create");
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = kEmbedTokens;
+    ctx_params.n_batch = kEmbedTokens;
+    ctx_params.n_ubatch = kEmbedTokens;
+    ctx_params.n_seq_max = 1;
+    ctx_params.n_threads = m_n_threads;
+    ctx_params.n_threads_batch = m_n_threads;
+    ctx_params.embeddings = true;
+    ctx_params.pooling_type = LLAMA_POOLING_TYPE_MEAN;
+    return create_context(ctx_params, m_data->embed_context, m_data->embed_compute_bytes);
+}
+
+bool TextGenerator::create_context(const llama_context_params& params, llama_context*& slot,
+                                   uint64_t& compute_bytes) {
+    // llama.cpp does not report its compute buffer sizes, so they are taken
+    // as the address space the context allocated beyond its KV cache
+    const uint64_t data_before = memory_probe::data_bytes();
+    llama_context* ctx = llama_init_from_model(m_data->llama_model, params);
+    uint64_t bytes = 0;
+    if (ctx) {
+        const uint64_t data_after = memory_probe::data_bytes();
+        const uint64_t allocated = data_after > data_before ? data_after - data_before : 0;
+        const uint64_t kv_bytes = kv_cache_bytes(ctx);
+        bytes = allocated > kv_bytes ? allocated - kv_bytes : 0;
     }
-    
-    // Communication and coordination
-    if (lower_prompt.find("communication") != std::string::npos ||
-        lower_prompt.find("signal") != std::string::npos ||
-        lower_prompt.find("contact") != std::string::npos) {
-        return "Communication methods when networks are down:\n\n**Visual signals:**\n• Mirrors or reflective surfaces for sunlight signals\n• Bright cloth or clothing as markers\n• Smoke signals (safely controlled fires)\n\n**Audio signals:**\n• Whistles, horns, or loud objects\n• Rhythmic patterns (3 blasts = distress)\n• Shouting at regular intervals\n\n**Written messages:**\n• Leave notes in visible locations\n• Use improvised writing materials\n• Include date, time, direction of travel";
+    std::lock_guard<std::mutex> lock(m_memory_mutex);
+    slot = ctx;
+    compute_bytes = bytes;
+    if (&slot == &m_data->llama_context) {
+        m_data->kv_cells_used = 0;
     }
-    
-    // Standard conversational responses
-    if (lower_prompt.find("hello") != std::string::npos ||
-        lower_prompt.find("hi") != std::string::npos) {
-        return "Hello! I'm NaseerAI, running locally on your device. I'm designed to provide assistance even without internet connectivity. How can I help you today?";
+    return ctx != nullptr;
+}
+
+void TextGenerator::publish_kv_cells() {
+    std::lock_guard<std::mutex> lock(m_memory_mutex);
+    m_data->kv_cells_used = static_cast<int32_t>(m_data->cached_tokens.size());
+}
+
+int TextGenerator::rerank(const std::string& query, const std::vector<std::string>& passages,
+                          int time_budget_ms, std::vector<float>& scores) {
+    TRACE_SCOPE("rerank");
+    std::lock_guard<std::mutex> lock(m_rerank_mutex);
+    scores.clear();
+    if (m_data->use_pattern_fallback || !m_data->llama_model) {
+        return -1;
     }
-    
-    if (lower_prompt.find("how are you") != std::string::npos) {
-        return "I'm functioning well and ready to assist you. As a local AI model, I can help with information, problem-solving, and guidance even when you're offline. What do you need help with?";
+
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed_ms = [&]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    const llama_vocab* vocab = llama_model_get_vocab(m_data->llama_model);
+    const int n_vocab = llama_vocab_n_tokens(vocab);
+    const std::vector<llama_token> yes_tokens = tokenize_text(vocab, " yes", false);
+    if (yes_tokens.empty()) {
+        return -1;
     }
-    
-    if (lower_prompt.find("what") != std::string::npos && lower_prompt.find("ai") != std::string::npos) {
-        return "I'm an AI assistant running locally on your device using a lightweight language model. I can help with explanations, problem-solving, emergency guidance, and general questions without requiring an internet connection.";
+    const llama_token yes_token = yes_tokens.front();
+
+    // Build every candidate prompt up front; passages are clipped so the
+    // question and answer cue always fit the per-sequence budget
+    const std::vector<llama_token> question = tokenize_text(
+        vocab, "\nQuestion: " + query + "\nIs the passage relevant to the question? Answer yes or no.\nAnswer:", false);
+    const size_t count = std::min(passages.size(), static_cast<size_t>(kMaxRerankCandidates));
+    std::vector<std::vector<llama_token>> prompts(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::vector<llama_token> tokens = tokenize_text(vocab, "Passage: " + passages[i], true);
+        size_t limit = kRerankSeqTokens > static_cast<int>(question.size())
+            ? kRerankSeqTokens - question.size() : 0;
+        if (tokens.size() > limit) {
+            tokens.resize(limit);
+        }
+        tokens.insert(tokens.end(), question.begin(), question.end());
+        prompts[i] = std::move(tokens);
     }
-    
-    // Technical questions
-    if (lower_prompt.find("programming") != std::string::npos ||
-        lower_prompt.find("code") != std::string::npos) {
-        return "I can help with programming concepts and coding questions. What specific programming language or problem are you working with? I can explain concepts, help debug issues, or suggest approaches.";
+
+    // Reranking is opt-in and rare, so its context is sized to this call's
+    // candidates and freed again before returning
+    if (count == 0) {
+        return 0;
     }
-    
-    // Math and calculations
-    if (lower_prompt.find("+") != std::string::npos ||
-        lower_prompt.find("-") != std::string::npos ||
-        lower_prompt.find("calculate") != std::string::npos) {
-        // Simple math handling
-        std::string math_result = handle_basic_math(prompt);
-        if (!math_result.empty()) {
-            return math_result;
+    if (!create_rerank_context(count)) {
+        return -1;
+    }
+    llama_context* ctx = m_data->rerank_context;
+    const int batch_tokens = std::min(kRerankBatchTokens, static_cast<int>(count) * kRerankSeqTokens);
+    llama_batch batch = llama_batch_init(batch_tokens, 0, 1);
+
+    size_t next = 0;
+    double ms_per_token = 0.0;
+    while (next < count) {
+        // Pack as many whole candidates as fit into this decode
+        batch.n_tokens = 0;
+        std::vector<std::pair<size_t, int>> logit_rows; // candidate, batch row
+        size_t end = next;
+        while (end < count && batch.n_tokens + prompts[end].size() <= static_cast<size_t>(batch_tokens)) {
+            const auto& tokens = prompts[end];
+            for (size_t t = 0; t < tokens.size(); ++t) {
+                batch_add(batch, tokens[t], static_cast<llama_pos>(t), static_cast<llama_seq_id>(end),
+                          t + 1 == tokens.size());
+            }
+            logit_rows.emplace_back(end, batch.n_tokens - 1);
+            end++;
+        }
+        if (end == next) {
+            break;
+        }
+
+        // Stop before a decode that would overrun the budget
+        if (time_budget_ms > 0 && next > 0 &&
+            elapsed_ms() + ms_per_token * batch.n_tokens > time_budget_ms) {
+            break;
+        }
+
+        const double decode_start = elapsed_ms();
+        int decode_status;
+        {
+            TRACE_SCOPE_ARG("rerank_decode", batch.n_tokens);
+            decode_status = llama_decode(ctx, batch);
+        }
+        if (decode_status) {
+            break;
+        }
+        ms_per_token = (elapsed_ms() - decode_start) / std::max(1, batch.n_tokens);
+
+        for (const auto& entry : logit_rows) {
+            const float* logits = llama_get_logits_ith(ctx, entry.second);
+            scores.push_back(sampling::log_softmax_at(logits, n_vocab, yes_token));
+        }
+        next = end;
+
+        if (time_budget_ms > 0 && elapsed_ms() >= time_budget_ms) {
+            break;
         }
     }
-    
-    // Default helpful response
-    return "I'm here to help with a wide range of topics including emergency guidance, technical questions, explanations, and problem-solving. I work completely offline, so you can rely on me even without internet access. What specific information or assistance do you need?";
+
+    llama_batch_free(batch);
+    free_rerank_context();
+    return static_cast<int>(scores.size());
 }
 
-std::string TextGenerator::handle_basic_math(const std::string& expression) {
-    // Very basic math parser for common operations
-    std::string clean_expr = expression;
-    // Remove spaces
-    clean_expr.erase(std::remove(clean_expr.begin(), clean_expr.end(), ' '), clean_expr.end());
-    
-    // Simple addition
-    size_t plus_pos = clean_expr.find('+');
-    if (plus_pos != std::string::npos) {
-        std::string left = clean_expr.substr(0, plus_pos);
-        std::string right = clean_expr.substr(plus_pos + 1);
-        try {
-            int a = std::stoi(left);
-            int b = std::stoi(right);
-            return std::to_string(a + b);
-        } catch (...) {
-            return "";
-        }
+bool TextGenerator::embed(const std::string& text, std::vector<float>& embedding) {
+    TRACE_SCOPE("embed");
+    std::lock_guard<std::mutex> lock(m_embed_mutex);
+    embedding.clear();
+    if (m_data->use_pattern_fallback || !m_data->llama_model || !ensure_embed_context()) {
+        return false;
     }
-    
-    // Simple subtraction
-    size_t minus_pos = clean_expr.find('-');
-    if (minus_pos != std::string::npos && minus_pos > 0) {
-        std::string left = clean_expr.substr(0, minus_pos);
-        std::string right = clean_expr.substr(minus_pos + 1);
-        try {
-            int a = std::stoi(left);
-            int b = std::stoi(right);
-            return std::to_string(a - b);
-        } catch (...) {
-            return "";
-        }
+    llama_context* ctx = m_data->embed_context;
+    std::vector<llama_token> tokens = tokenize_text(llama_model_get_vocab(m_data->llama_model), text, true);
+    if (tokens.empty()) {
+        return false;
+    }
+    if (tokens.size() > static_cast<size_t>(kEmbedTokens)) {
+        tokens.resize(kEmbedTokens);
+    }
+
+    llama_memory_clear(llama_get_memory(ctx), true);
+    llama_batch batch = llama_batch_init(kEmbedTokens, 0, 1);
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        batch_add(batch, tokens[i], static_cast<llama_pos>(i), 0, true);
+    }
+    int decode_status;
+    {
+        TRACE_SCOPE_ARG("embed_decode", batch.n_tokens);
+        decode_status = llama_decode(ctx, batch);
+    }
+    llama_batch_free(batch);
+
+    const float* pooled = decode_status == 0 ? llama_get_embeddings_seq(ctx, 0) : nullptr;
+    if (pooled) {
+        const int dim = llama_model_n_embd(m_data->llama_model);
+        embedding.assign(pooled, pooled + dim);
+        retrieval::normalize(embedding.data(), dim);
+    }
+    llama_memory_clear(llama_get_memory(ctx), true);
+    return !embedding.empty();
+}
+
+ModelMemory TextGenerator::memory_usage() const {
+    ModelMemory memory;
+    if (!m_data->llama_model) {
+        return memory;
+    }
+    memory_probe::mapped_file(m_data->model_path, memory.model_file_bytes, memory.model_resident_bytes);
+    memory.tokenizer_bytes = m_data->tokenizer_bytes;
+    if (memory.model_file_bytes == 0) {
+        // Not mmapped: the weights live in anonymous memory
+        memory.model_file_bytes = llama_model_size(m_data->llama_model);
+        memory.model_resident_bytes = memory.model_file_bytes;
     }
     
-    return "";
+    // Contexts are created and freed by generation, possibly on another thread
+    std::lock_guard<std::mutex> lock(m_memory_mutex);
+    if (m_data->llama_context) {
+        memory.kv_cache_bytes += kv_cache_bytes(m_data->llama_context);
+        memory.kv_cells_used = m_data->kv_cells_used;
+        memory.kv_cells_total = static_cast<int32_t>(llama_n_ctx(m_data->llama_context));
+        memory.compute_buffer_bytes += m_data->compute_bytes;
+    }
+    if (m_data->rerank_context) {
+        memory.kv_cache_bytes += kv_cache_bytes(m_data->rerank_context);
+        memory.compute_buffer_bytes += m_data->rerank_compute_bytes;
+    }
+    if (m_data->embed_context) {
+        memory.kv_cache_bytes += kv_cache_bytes(m_data->embed_context);
+        memory.compute_buffer_bytes += m_data->embed_compute_bytes;
+    }
+    return memory;
 }
 
 bool TextGenerator::is_loaded() const {
     return m_loaded;
 }
 
+bool TextGenerator::has_llama_model() const {
+    return m_loaded && !m_data->use_pattern_fallback && m_data->llama_model;
+}
+
+int TextGenerator::count_tokens(const std::string& text) const {
+    if (!m_data->llama_model) {
+        return -1;
+    }
+    // With no output buffer llama_tokenize returns the negated token count
+    const llama_vocab* vocab = llama_model_get_vocab(m_data->llama_model);
+    int n_tokens = llama_tokenize(vocab, text.c_str(), text.length(), nullptr, 0, false, false);
+    return n_tokens < 0 ? -n_tokens : n_tokens;
+}
+
+bool TextGenerator::pack_context(const std::string& system_prompt, const std::string& history,
+                                 const std::string& user_message, const std::vector<PackCandidate>& candidates,
+                                 int reserved_tokens, DedupPolicy dedup, PackedContext& packed) {
+    if (!m_data->llama_model) {
+        return false;
+    }
+    TRACE_SCOPE("context_pack");
+    
+    const llama_vocab* vocab = llama_model_get_vocab(m_data->llama_model);
+    ContextPacker packer([vocab](const std::string& text) {
+        return tokenize_text(vocab, text, false);
+    });
+    
+    // Whatever the fixed parts of the prompt leave over goes to context
+    PackOptions options;
+    options.dedup = dedup;
+    options.token_budget = m_n_ctx - std::max(0, reserved_tokens)
+        - count_tokens(system_prompt) - count_tokens(history) - count_tokens(user_message)
+        - 16; // role markers and framing text
+    
+    packed = packer.pack(candidates, options);
+    m_pending_context = packed.text;
+    m_pending_context_tokens.assign(packed.token_ids.begin(), packed.token_ids.end());
+    return true;
+}
+
 void TextGenerator::set_temperature(float temperature) {
     m_temperature = std::max(0.1f, std::min(2.0f, temperature));
 }
@@ -317,6 +723,46 @@ void TextGenerator::set_top_p(float top_p) {
     m_top_p = std::max(0.1f, std::min(1.0f, top_p));
 }
 
+void TextGenerator::set_context_size(int n_ctx) {
+    n_ctx = std::max(256, n_ctx);
+    if (n_ctx == m_n_ctx) {
+        return;
+    }
+    m_n_ctx = n_ctx;
+    if (m_data->llama_context) {
+        std::lock_guard<std::mutex> lock(m_memory_mutex);
+        llama_free(m_data->llama_context);
+        m_data->llama_context = nullptr;
+        m_data->cached_tokens.clear();
+        m_data->kv_cells_used = 0;
+    }
+}
+
+void TextGenerator::set_prefix_reuse(bool enabled) {
+    m_prefix_reuse = enabled;
+}
+
+void TextGenerator::set_threads(int n_threads) {
+    m_n_threads = std::max(1, n_threads);
+    if (m_data->llama_context) {
+        llama_set_n_threads(m_data->llama_context, m_n_threads, m_n_threads);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_embed_mutex);
+        if (m_data->embed_context) {
+            llama_set_n_threads(m_data->embed_context, m_n_threads, m_n_threads);
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_rerank_mutex);
+    if (m_data->rerank_context) {
+        llama_set_n_threads(m_data->rerank_context, m_n_threads, m_n_threads);
+    }
+}
+
+void TextGenerator::set_fallback_table(std::shared_ptr<const FallbackTable> table) {
+    m_fallback_table = table ? std::move(table) : FallbackTable::builtin();
+}
+
 std::vector<std::string> TextGenerator::tokenize(const std::string& text) {
     std::vector<std::string> tokens;
     std::istringstream iss(text);
@@ -4,9 +4,15 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include "context_packer.h"
+#include "inference_metrics.h"
+#include "memory_stats.h"
+#include "fallback_table.h"
 
 // Forward declarations for llama.cpp types
 struct llama_context;
+struct llama_context_params;
 typedef int32_t llama_token;
 
 class TextGenerator {
@@ -17,10 +23,66 @@ public:
     bool load_model(const std::string& model_path);
     std::string generate(const std::string& prompt, int max_tokens);
     bool is_loaded() const;
+    bool has_llama_model() const;
+    int count_tokens(const std::string& text) const;
+
+    // Scores retrieval candidates by the model's log-probability of judging
+    // them relevant. All candidates share one batch, each on its own sequence
+    // id; candidates that do not fit the time budget are left unscored.
+    // Returns how many leading candidates were scored, or -1 without a model.
+    // Runs on its own context, sized to the candidates and freed before
+    // returning, so it may overlap a generation on another thread and holds
+    // no memory between calls; rerank calls themselves are serialized.
+    int rerank(const std::string& query, const std::vector<std::string>& passages,
+               int time_budget_ms, std::vector<float>& scores);
+    
+    // Mean-pooled, unit-length sentence embedding of text from the loaded
+    // model, computed on a context of its own so the chat KV cache is kept.
+    // Text beyond the embedding window is cut. Returns false without a model.
+    // Safe alongside a generation on another thread; embed calls are serialized.
+    bool embed(const std::string& text, std::vector<float>& embedding);
+    
+    // Packs retrieval passages into whatever the context window has left
+    // after the system prompt, history, user message and reserved_tokens of
+    // generation. The packed ids are kept and spliced into the next prompt
+    // that contains the packed text, so the passages are tokenized once.
+    bool pack_context(const std::string& system_prompt, const std::string& history,
+                      const std::string& user_message, const std::vector<PackCandidate>& candidates,
+                      int reserved_tokens, DedupPolicy dedup, PackedContext& packed);
+    
+    // Names everything besides the prompt that decides a llama generation:
+    // response format version, model, context and batch size, sampling
+    // settings and max_tokens.
+    // Empty when answers come from the pattern fallback, which is cheap.
+    std::string generation_fingerprint(int max_tokens) const;
+    // How the last generate() call ended; None if it never reached decoding
+    StopReason last_stop_reason() const { return m_last_stop_reason; }
+    // Drops context packed by pack_context() when the generation it was
+    // meant for is answered some other way
+    void discard_packed_context();
+    
+    // Per-request timings of llama generations
+    MetricsRecorder& metrics() { return m_metrics; }
+    // Records a request answered from the response cache, so metrics and
+    // last_stop_reason() describe it rather than the previous generation
+    void record_cache_hit(double total_ms);
+    
+    // Model weights, KV cache, compute buffers and vocabulary tables
+    ModelMemory memory_usage() const;
     
     void set_temperature(float temperature);
     void set_top_k(int top_k);
     void set_top_p(float top_p);
+    // A new context size takes effect on the next generation, which
+    // recreates the context; thread counts apply immediately
+    void set_context_size(int n_ctx);
+    void set_threads(int n_threads);
+    // Keeps the KV entries of the prefix a prompt shares with the previous
+    // one and decodes only the rest (on by default). Off, the KV cache is
+    // cleared before every generation and the whole prompt is prefilled.
+    void set_prefix_reuse(bool enabled);
+    // Answers used without a model; the built-in English table by default
+    void set_fallback_table(std::shared_ptr<const FallbackTable> table);
 
 private:
     struct ModelData;
@@ -30,13 +92,36 @@ private:
     float m_temperature = 0.7f;
     int m_top_k = 40;
     float m_top_p = 0.95f;
+    int m_n_ctx = 2048;
+    int m_n_batch = 512;
+    int m_n_threads = 4;
+    bool m_prefix_reuse = true;
+    std::mutex m_rerank_mutex; // guards the rerank context
+    std::mutex m_embed_mutex;  // guards the embedding context
+    // Guards context pointers and the KV cell count that memory_usage()
+    // reads, which may run while another thread generates
+    mutable std::mutex m_memory_mutex;
+    MetricsRecorder m_metrics;
+    StopReason m_last_stop_reason = StopReason::None;
+    std::shared_ptr<const FallbackTable> m_fallback_table = FallbackTable::builtin();
+    
+    // Context packed by pack_context(), consumed by the next generation
+    std::string m_pending_context;
+    std::vector<int32_t> m_pending_context_tokens;
     
     std::string generate_pattern_response(const std::string& prompt);
     std::string generate_with_llama(const std::string& prompt, int max_tokens);
     llama_token sample_token(llama_context* ctx);
+    bool create_rerank_context(size_t candidates);
+    void free_rerank_context();
+    bool ensure_embed_context();
+    // Publishes the new context into slot under m_memory_mutex
+    bool create_context(const llama_context_params& params, llama_context*& slot, uint64_t& compute_bytes);
+    void publish_kv_cells();
+    size_t reuse_kv_prefix(llama_context* ctx, const std::vector<llama_token>& tokens);
+    std::vector<llama_token> tokenize_prompt(const std::string& prompt);
     std::vector<std::string> tokenize(const std::string& text);
     std::string detokenize(const std::vector<int>& tokens);
-    std::string handle_basic_math(const std::string& expression);
 };
 
 #endif // TEXT_GENERATOR_H
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "trace.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+constexpr size_t kSpansPerThread = 8192;
+// About 256 KiB each; threads past the cap record nothing until one exits
+constexpr size_t kMaxThreadBuffers = 16;
+
+struct Span {
+    const char* name;
+    int64_t start_ns;
+    int64_t end_ns;
+    int64_t arg;
+};
+
+// Written only by its owning thread. m_count is published with release
+// ordering so a reader sees complete spans below it. A reset for a new
+// trace bumps generation before overwriting spans, so a reader that finds
+// generation unchanged after copying knows the copy is not torn.
+struct ThreadBuffer {
+    int tid = 0;
+    std::atomic<bool> in_use{false};
+    std::atomic<uint64_t> generation{0};
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> dropped{0};
+    Span spans[kSpansPerThread];
+};
+
+std::atomic<uint64_t> g_generation{1};
+
+// Buffers outlive their threads so spans from finished threads still dump,
+// and are handed to new threads once released
+std::mutex g_registry_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> g_registry;
+int g_next_tid = 1;
+
+ThreadBuffer* acquire_buffer() {
+    const uint64_t generation = g_generation.load(std::memory_order_acquire);
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+    ThreadBuffer* reusable = nullptr;
+    for (const auto& buffer : g_registry) {
+        if (buffer->in_use.load(std::memory_order_acquire)) {
+            continue;
+        }
+        // Prefer a buffer whose spans were already cleared
+        if (!reusable || buffer->generation.load(std::memory_order_relaxed) != generation) {
+            reusable = buffer.get();
+        }
+    }
+    if (!reusable || (reusable->generation.load(std::memory_order_relaxed) == generation &&
+                      g_registry.size() < kMaxThreadBuffers)) {
+        if (g_registry.size() >= kMaxThreadBuffers) {
+            return nullptr;
+        }
+        g_registry.push_back(std::make_unique<ThreadBuffer>());
+        reusable = g_registry.back().get();
+    }
+    // dump_json() holds the lock, so nothing is reading this buffer; the
+    // stale generation makes the first record() reset it
+    reusable->tid = g_next_tid++;
+    reusable->generation.store(0, std::memory_order_relaxed);
+    reusable->count.store(0, std::memory_order_relaxed);
+    reusable->dropped.store(0, std::memory_order_relaxed);
+    reusable->in_use.store(true, std::memory_order_release);
+    return reusable;
+}
+
+// Returns the thread's buffer to the registry when the thread exits
+struct BufferLease {
+    ThreadBuffer* buffer = nullptr;
+    uint64_t denied_generation = 0;
+
+    ~BufferLease() {
+        if (buffer) {
+            buffer->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+ThreadBuffer* thread_buffer() {
+    thread_local BufferLease lease;
+    if (!lease.buffer) {
+        // After a refusal, retry only once a new trace starts
+        const uint64_t generation = g_generation.load(std::memory_order_relaxed);
+        if (lease.denied_generation == generation) {
+            return nullptr;
+        }
+        lease.buffer = acquire_buffer();
+        if (!lease.buffer) {
+            lease.denied_generation = generation;
+        }
+    }
+    return lease.buffer;
+}
+
+void append_escaped(std::string& out, const char* text) {
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out.push_back('\\');
+        }
+        out.push_back(*c);
+    }
+}
+
+} // namespace
+
+std::atomic<bool> Tracer::s_enabled{false};
+
+void Tracer::set_enabled(bool enabled) {
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Tracer::clear() {
+    g_generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+int64_t Tracer::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::record(const char* name, int64_t start_ns, int64_t end_ns, int64_t arg) {
+    ThreadBuffer* buffer = thread_buffer();
+    if (!buffer) {
+        return;
+    }
+
+    uint64_t generation = g_generation.load(std::memory_order_acquire);
+    if (buffer->generation.load(std::memory_order_relaxed) != generation) {
+        buffer->generation.store(generation, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        buffer->count.store(0, std::memory_order_relaxed);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+    }
+
+    size_t index = buffer->count.load(std::memory_order_relaxed);
+    if (index >= kSpansPerThread) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer->spans[index] = {name, start_ns, end_ns, arg};
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+std::string Tracer::dump_json() {
+    const uint64_t generation = g_generation.load(std::memory_order_acquire);
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    char line[256];
+    std::vector<Span> spans;
+
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+    for (const auto& buffer : g_registry) {
+        if (buffer->generation.load(std::memory_order_acquire) != generation) {
+            continue;
+        }
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        if (count == 0) {
+            continue;
+        }
+        // The owner keeps appending while we copy; a reset for a newer
+        // trace shows up as a changed generation and discards the copy
+        spans.assign(buffer->spans, buffer->spans + count);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (buffer->generation.load(std::memory_order_relaxed) != generation) {
+            continue;
+        }
+
+        std::snprintf(line, sizeof(line),
+                      "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                      "\"args\":{\"name\":\"naseer-%d\",\"dropped_spans\":%zu}}",
+                      first ? "" : ",", buffer->tid, buffer->tid,
+                      buffer->dropped.load(std::memory_order_relaxed));
+        out += line;
+        first = false;
+
+        for (const Span& span : spans) {
+            out += ",{\"name\":\"";
+            append_escaped(out, span.name);
+            std::snprintf(line, sizeof(line),
+                          "\",\"cat\":\"naseer\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                          buffer->tid, span.start_ns / 1000.0, (span.end_ns - span.start_ns) / 1000.0);
+            out += line;
+            if (span.arg >= 0) {
+                std::snprintf(line, sizeof(line), ",\"args\":{\"n\":%lld}", static_cast<long long>(span.arg));
+                out += line;
+            }
+            out += "}";
+        }
+    }
+    out += "]}";
+    return out;
+}
+
+bool Tracer::dump_to_file(const std::string& path) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << dump_json();
+    return file.good();
+}
@@ -0,0 +1,71 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+// Scoped trace spans exported as Chrome/Perfetto trace JSON. While tracing
+// is off a span costs one relaxed atomic load. Each thread appends to its
+// own fixed-size buffer without locks; a full buffer drops further spans
+// until the trace is cleared. Buffers are pooled: an exiting thread hands
+// its buffer to the next new one, and past a fixed number of live threads
+// spans are not recorded.
+//
+// Span names must be string literals: only the pointer is stored.
+#ifndef NASEER_TRACING
+#define NASEER_TRACING 1
+#endif
+
+class Tracer {
+public:
+    static void set_enabled(bool enabled);
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    // Drops every recorded span; buffers reset lazily on their next write
+    static void clear();
+
+    static std::string dump_json();
+    static bool dump_to_file(const std::string& path);
+
+    static int64_t now_ns();
+    static void record(const char* name, int64_t start_ns, int64_t end_ns, int64_t arg);
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+class ScopedSpan {
+public:
+    explicit ScopedSpan(const char* name, int64_t arg = -1)
+        : m_name(Tracer::enabled() ? name : nullptr),
+          m_arg(arg),
+          m_start(m_name ? Tracer::now_ns() : 0) {}
+
+    ~ScopedSpan() {
+        if (m_name) {
+            Tracer::record(m_name, m_start, Tracer::now_ns(), m_arg);
+        }
+    }
+
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+private:
+    const char* m_name;
+    int64_t m_arg;
+    int64_t m_start;
+};
+
+#define NASEER_TRACE_CONCAT_INNER(a, b) a##b
+#define NASEER_TRACE_CONCAT(a, b) NASEER_TRACE_CONCAT_INNER(a, b)
+
+#if NASEER_TRACING
+#define TRACE_SCOPE(name) ScopedSpan NASEER_TRACE_CONCAT(trace_span_, __LINE__)(name)
+#define TRACE_SCOPE_ARG(name, arg) ScopedSpan NASEER_TRACE_CONCAT(trace_span_, __LINE__)(name, arg)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SCOPE_ARG(name, arg) ((void)0)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,216 @@
+// Builds the intent centroid file that routes prompts before generation
+// (see intent_classifier.h) from labelled example prompts:
+//
+//   intent_centroids --model model.gguf --examples intent_examples.json
+//                    --out intent_centroids.bin [--threads 4]
+//
+//   {"centroids": [{"intent": "greeting", "min_similarity": 0.80,
+//                   "examples": ["hello", "hi there", "السلام عليكم"]}, ...]}
+//
+// Each entry becomes one centroid, the mean of its examples' embeddings.
+// Several entries may share an intent when its prompts form distinct
+// clusters (e.g. English and Arabic). Embeddings come from the same model
+// and code path the app uses, so the file only fits that model; rebuild it
+// whenever the chat model changes.
+//
+// Afterwards every example is classified against the finished centroids
+// and per-entry recall is printed, along with the lowest similarity an
+// example had to its own centroid, as a guide for min_similarity.
+
+#include "text_generator.h"
+#include "intent_classifier.h"
+#include "json_reader.h"
+#include "retrieval_kernels.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string model_path;
+    std::string examples_path;
+    std::string out_path;
+    int threads = 4;
+};
+
+struct Entry {
+    int intent = -1;
+    float min_similarity = 0.0f;
+    std::vector<std::string> examples;
+};
+
+bool read_entry(JsonReader& reader, Entry& entry) {
+    std::string key, text;
+    if (!reader.begin_object()) {
+        return false;
+    }
+    while (reader.next_key(key)) {
+        if (key == "intent") {
+            if (!reader.read_string(text)) {
+                return false;
+            }
+            entry.intent = IntentClassifier::from_name(text);
+            if (entry.intent < 0) {
+                std::fprintf(stderr, "unknown intent \"%s\"\n", text.c_str());
+                return false;
+            }
+        } else if (key == "min_similarity") {
+            double value;
+            if (!reader.read_number(value)) {
+                return false;
+            }
+            entry.min_similarity = static_cast<float>(value);
+        } else if (key == "examples") {
+            if (!reader.begin_array()) {
+                return false;
+            }
+            while (reader.next_element()) {
+                if (!reader.read_string(text)) {
+                    return false;
+                }
+                entry.examples.push_back(text);
+            }
+        } else if (!reader.skip_value()) {
+            return false;
+        }
+    }
+    return !reader.failed() && entry.intent >= 0 && !entry.examples.empty();
+}
+
+bool read_examples(const std::string& path, std::vector<Entry>& entries) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    JsonReader reader(data.data(), data.size());
+    std::string key;
+    if (!reader.begin_object()) {
+        return false;
+    }
+    while (reader.next_key(key)) {
+        if (key != "centroids") {
+            if (!reader.skip_value()) {
+                return false;
+            }
+            continue;
+        }
+        if (!reader.begin_array()) {
+            return false;
+        }
+        while (reader.next_element()) {
+            Entry entry;
+            if (!read_entry(reader, entry)) {
+                return false;
+            }
+            entries.push_back(std::move(entry));
+        }
+    }
+    return !reader.failed() && !entries.empty();
+}
+
+bool parse_args(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--model") {
+            options.model_path = value;
+        } else if (arg == "--examples") {
+            options.examples_path = value;
+        } else if (arg == "--out") {
+            options.out_path = value;
+        } else if (arg == "--threads") {
+            options.threads = std::atoi(value.c_str());
+        } else {
+            return false;
+        }
+    }
+    return !options.model_path.empty() && !options.examples_path.empty() && !options.out_path.empty() &&
+           options.threads > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_args(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s --model FILE.gguf --examples FILE.json --out FILE.bin [--threads N]\n",
+                     argv[0]);
+        return 1;
+    }
+    std::vector<Entry> entries;
+    if (!read_examples(options.examples_path, entries)) {
+        std::fprintf(stderr, "failed to read examples from %s\n", options.examples_path.c_str());
+        return 1;
+    }
+
+    TextGenerator generator;
+    generator.set_threads(options.threads);
+    generator.load_model(options.model_path);
+    if (!generator.has_llama_model()) {
+        std::fprintf(stderr, "failed to load %s\n", options.model_path.c_str());
+        return 1;
+    }
+
+    // Embed every example once; centroids are the means of unit vectors
+    std::vector<std::vector<std::vector<float>>> embeddings(entries.size());
+    std::vector<IntentCentroid> centroids;
+    for (size_t e = 0; e < entries.size(); ++e) {
+        IntentCentroid centroid;
+        centroid.intent = static_cast<PromptIntent>(entries[e].intent);
+        centroid.min_similarity = entries[e].min_similarity;
+        for (const auto& example : entries[e].examples) {
+            std::vector<float> embedding;
+            if (!generator.embed(example, embedding)) {
+                std::fprintf(stderr, "failed to embed \"%s\"\n", example.c_str());
+                return 1;
+            }
+            if (centroid.values.empty()) {
+                centroid.values.assign(embedding.size(), 0.0f);
+            }
+            for (size_t d = 0; d < embedding.size(); ++d) {
+                centroid.values[d] += embedding[d];
+            }
+            embeddings[e].push_back(std::move(embedding));
+        }
+        centroids.push_back(std::move(centroid));
+    }
+
+    IntentClassifier classifier;
+    std::string error;
+    if (!classifier.set_centroids(centroids, error) ||
+        !IntentClassifier::write_file(options.out_path, centroids, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    int total = 0, correct = 0;
+    for (size_t e = 0; e < entries.size(); ++e) {
+        const PromptIntent expected = static_cast<PromptIntent>(entries[e].intent);
+        std::vector<float> own = centroids[e].values;
+        const int dim = static_cast<int>(own.size());
+        retrieval::normalize(own.data(), dim);
+        int hits = 0;
+        float lowest = 1.0f;
+        for (const auto& embedding : embeddings[e]) {
+            hits += classifier.classify(embedding.data(), dim).intent == expected;
+            lowest = std::min(lowest, retrieval::dot_product(embedding.data(), own.data(), dim));
+        }
+        total += static_cast<int>(embeddings[e].size());
+        correct += hits;
+        std::fprintf(stderr, "%-15s %3d/%-3zu recalled, lowest own similarity %.3f (threshold %.3f)\n",
+                     IntentClassifier::name(expected), hits, embeddings[e].size(), lowest,
+                     entries[e].min_similarity);
+    }
+    std::fprintf(stderr, "%zu centroids of dimension %d written to %s; %d/%d examples recalled\n",
+                 centroids.size(), classifier.dim(), options.out_path.c_str(), correct, total);
+    return 0;
+}
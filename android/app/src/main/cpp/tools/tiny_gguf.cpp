@@ -0,0 +1,343 @@
+// Writes a tiny, randomly initialized llama-architecture GGUF so the
+// loader and generation path can be exercised end to end without a
+// downloaded model. The same seed and shape always give the same file.
+//
+//   tiny_gguf --out tiny.gguf [--seed 42] [--layers 2] [--embd 64] [--heads 4]
+//             [--kv-heads 2] [--ff 128] [--vocab 512] [--ctx 512]
+//
+// The vocabulary is SentencePiece-style: <unk>, <s>, </s>, 256 byte-fallback
+// tokens, then word-prefix pieces, so any text tokenizes. Weights are F32.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kGgufVersion = 3;
+constexpr uint64_t kAlignment = 32;
+
+// GGUF metadata value types
+enum ValueType : uint32_t {
+    kUint32 = 4,
+    kInt32 = 5,
+    kFloat32 = 6,
+    kBool = 7,
+    kString = 8,
+    kArray = 9,
+};
+
+// SentencePiece token types as llama.cpp reads them
+enum TokenType : int32_t {
+    kNormal = 1,
+    kUnknown = 2,
+    kControl = 3,
+    kByte = 6,
+};
+
+constexpr uint32_t kTensorF32 = 0;
+
+struct Options {
+    std::string out_path;
+    uint32_t seed = 42;
+    int layers = 2;
+    int embd = 64;
+    int heads = 4;
+    int kv_heads = 2;
+    int ff = 128;
+    int vocab = 512;
+    int ctx = 512;
+};
+
+struct Tensor {
+    std::string name;
+    std::vector<uint64_t> dims; // ne0 first: the row length
+    std::vector<float> data;
+};
+
+// Little-endian serialization into one buffer
+class Writer {
+public:
+    void u8(uint8_t v) { m_bytes.push_back(v); }
+    void u32(uint32_t v) { raw(&v, sizeof(v)); }
+    void i32(int32_t v) { raw(&v, sizeof(v)); }
+    void u64(uint64_t v) { raw(&v, sizeof(v)); }
+    void f32(float v) { raw(&v, sizeof(v)); }
+    void str(const std::string& s) {
+        u64(s.size());
+        raw(s.data(), s.size());
+    }
+    void raw(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        m_bytes.insert(m_bytes.end(), bytes, bytes + size);
+    }
+    void pad(uint64_t alignment) {
+        while (m_bytes.size() % alignment) {
+            m_bytes.push_back(0);
+        }
+    }
+
+    // Metadata entries; array elements follow kv_array() directly
+    void kv_u32(const std::string& key, uint32_t v) { kv(key, kUint32); u32(v); }
+    void kv_f32(const std::string& key, float v) { kv(key, kFloat32); f32(v); }
+    void kv_bool(const std::string& key, bool v) { kv(key, kBool); u8(v ? 1 : 0); }
+    void kv_str(const std::string& key, const std::string& v) { kv(key, kString); str(v); }
+    void kv_array(const std::string& key, ValueType element_type, uint64_t count) {
+        kv(key, kArray);
+        u32(element_type);
+        u64(count);
+    }
+
+    uint64_t entries() const { return m_entries; }
+    size_t size() const { return m_bytes.size(); }
+    const std::vector<uint8_t>& bytes() const { return m_bytes; }
+
+private:
+    std::vector<uint8_t> m_bytes;
+    uint64_t m_entries = 0;
+
+    void kv(const std::string& key, ValueType type) {
+        str(key);
+        u32(type);
+        m_entries++;
+    }
+};
+
+struct Vocabulary {
+    std::vector<std::string> tokens;
+    std::vector<float> scores;
+    std::vector<int32_t> types;
+
+    void add(const std::string& token, float score, TokenType type) {
+        tokens.push_back(token);
+        scores.push_back(score);
+        types.push_back(type);
+    }
+};
+
+// Word prefixes let SentencePiece merge characters up to whole words;
+// longer pieces score higher so merges prefer them
+Vocabulary build_vocabulary(int size) {
+    static const char* kWords[] = {
+        "the", "and", "to", "of", "a", "in", "is", "you", "that", "it", "for", "with", "water",
+        "help", "safe", "emergency", "medical", "shelter", "clean", "burn", "wound", "cloth",
+        "boil", "minutes", "signal", "first", "aid", "what", "how", "do", "i", "should", "hello",
+    };
+    const std::string space = "\xe2\x96\x81"; // U+2581, SentencePiece word boundary
+
+    Vocabulary vocab;
+    vocab.add("<unk>", 0.0f, kUnknown);
+    vocab.add("<s>", 0.0f, kControl);
+    vocab.add("</s>", 0.0f, kControl);
+    for (int b = 0; b < 256; ++b) {
+        char piece[8];
+        std::snprintf(piece, sizeof(piece), "<0x%02X>", b);
+        vocab.add(piece, 0.0f, kByte);
+    }
+
+    std::set<std::string> seen(vocab.tokens.begin(), vocab.tokens.end());
+    auto add_piece = [&](const std::string& piece) {
+        if (static_cast<int>(vocab.tokens.size()) < size && seen.insert(piece).second) {
+            vocab.add(piece, static_cast<float>(piece.size()) - 0.001f * vocab.tokens.size(), kNormal);
+        }
+    };
+    add_piece(space);
+    for (char c = 'a'; c <= 'z'; ++c) {
+        add_piece(std::string(1, c));
+        add_piece(space + c);
+    }
+    for (const char* word : kWords) {
+        for (size_t length = 2; length <= std::strlen(word); ++length) {
+            add_piece(space + std::string(word, length));
+        }
+    }
+    // Letter pairs fill whatever is left
+    for (char a = 'a'; a <= 'z'; ++a) {
+        for (char b = 'a'; b <= 'z'; ++b) {
+            add_piece(std::string{a, b});
+        }
+    }
+    return vocab;
+}
+
+Tensor make_tensor(const std::string& name, std::vector<uint64_t> dims, std::mt19937& rng, float scale) {
+    Tensor tensor{name, std::move(dims), {}};
+    uint64_t count = 1;
+    for (uint64_t d : tensor.dims) {
+        count *= d;
+    }
+    tensor.data.resize(count);
+    if (scale == 0.0f) {
+        // Norm weights start at one, as in a freshly initialized model
+        std::fill(tensor.data.begin(), tensor.data.end(), 1.0f);
+    } else {
+        // Uniform with standard deviation `scale`, drawn from the raw
+        // generator output; the <random> distributions differ between
+        // standard libraries, mt19937 itself does not
+        const float half_width = scale * 1.7320508f;
+        for (float& v : tensor.data) {
+            v = ((rng() >> 8) * (2.0f / 16777216.0f) - 1.0f) * half_width;
+        }
+    }
+    return tensor;
+}
+
+std::vector<Tensor> build_tensors(const Options& options, int vocab_size) {
+    std::mt19937 rng(options.seed);
+    const uint64_t embd = options.embd;
+    const uint64_t embd_kv = embd / options.heads * options.kv_heads;
+    const uint64_t ff = options.ff;
+    const uint64_t vocab = vocab_size;
+    const float scale = 0.02f;
+
+    std::vector<Tensor> tensors;
+    tensors.push_back(make_tensor("token_embd.weight", {embd, vocab}, rng, scale));
+    for (int layer = 0; layer < options.layers; ++layer) {
+        const std::string prefix = "blk." + std::to_string(layer) + ".";
+        tensors.push_back(make_tensor(prefix + "attn_norm.weight", {embd}, rng, 0.0f));
+        tensors.push_back(make_tensor(prefix + "attn_q.weight", {embd, embd}, rng, scale));
+        tensors.push_back(make_tensor(prefix + "attn_k.weight", {embd, embd_kv}, rng, scale));
+        tensors.push_back(make_tensor(prefix + "attn_v.weight", {embd, embd_kv}, rng, scale));
+        tensors.push_back(make_tensor(prefix + "attn_output.weight", {embd, embd}, rng, scale));
+        tensors.push_back(make_tensor(prefix + "ffn_norm.weight", {embd}, rng, 0.0f));
+        tensors.push_back(make_tensor(prefix + "ffn_gate.weight", {embd, ff}, rng, scale));
+        tensors.push_back(make_tensor(prefix + "ffn_up.weight", {embd, ff}, rng, scale));
+        tensors.push_back(make_tensor(prefix + "ffn_down.weight", {ff, embd}, rng, scale));
+    }
+    tensors.push_back(make_tensor("output_norm.weight", {embd}, rng, 0.0f));
+    tensors.push_back(make_tensor("output.weight", {embd, vocab}, rng, scale));
+    return tensors;
+}
+
+bool write_gguf(const Options& options) {
+    const Vocabulary vocab = build_vocabulary(options.vocab);
+    const int vocab_size = static_cast<int>(vocab.tokens.size());
+    const std::vector<Tensor> tensors = build_tensors(options, vocab_size);
+
+    Writer meta;
+    meta.kv_str("general.architecture", "llama");
+    meta.kv_str("general.name", "naseer-tiny-" + std::to_string(options.seed));
+    meta.kv_u32("general.alignment", kAlignment);
+    meta.kv_u32("llama.context_length", options.ctx);
+    meta.kv_u32("llama.embedding_length", options.embd);
+    meta.kv_u32("llama.block_count", options.layers);
+    meta.kv_u32("llama.feed_forward_length", options.ff);
+    meta.kv_u32("llama.attention.head_count", options.heads);
+    meta.kv_u32("llama.attention.head_count_kv", options.kv_heads);
+    meta.kv_u32("llama.rope.dimension_count", options.embd / options.heads);
+    meta.kv_f32("llama.attention.layer_norm_rms_epsilon", 1e-5f);
+    meta.kv_u32("llama.vocab_size", vocab_size);
+
+    meta.kv_str("tokenizer.ggml.model", "llama");
+    meta.kv_array("tokenizer.ggml.tokens", kString, vocab.tokens.size());
+    for (const auto& token : vocab.tokens) {
+        meta.str(token);
+    }
+    meta.kv_array("tokenizer.ggml.scores", kFloat32, vocab.scores.size());
+    for (float score : vocab.scores) {
+        meta.f32(score);
+    }
+    meta.kv_array("tokenizer.ggml.token_type", kInt32, vocab.types.size());
+    for (int32_t type : vocab.types) {
+        meta.i32(type);
+    }
+    meta.kv_u32("tokenizer.ggml.unknown_token_id", 0);
+    meta.kv_u32("tokenizer.ggml.bos_token_id", 1);
+    meta.kv_u32("tokenizer.ggml.eos_token_id", 2);
+    meta.kv_bool("tokenizer.ggml.add_bos_token", true);
+
+    Writer out;
+    out.raw("GGUF", 4);
+    out.u32(kGgufVersion);
+    out.u64(tensors.size());
+    out.u64(meta.entries());
+    out.raw(meta.bytes().data(), meta.size());
+
+    // Tensor infos; offsets are relative to the aligned data section
+    uint64_t offset = 0;
+    for (const auto& tensor : tensors) {
+        out.str(tensor.name);
+        out.u32(static_cast<uint32_t>(tensor.dims.size()));
+        for (uint64_t dim : tensor.dims) {
+            out.u64(dim);
+        }
+        out.u32(kTensorF32);
+        out.u64(offset);
+        offset += (tensor.data.size() * sizeof(float) + kAlignment - 1) / kAlignment * kAlignment;
+    }
+    out.pad(kAlignment);
+    for (const auto& tensor : tensors) {
+        out.raw(tensor.data.data(), tensor.data.size() * sizeof(float));
+        out.pad(kAlignment);
+    }
+
+    FILE* file = std::fopen(options.out_path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fwrite(out.bytes().data(), 1, out.size(), file) == out.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (ok) {
+        std::fprintf(stderr, "wrote %s: %d layers, %d embd, %d vocab, %zu bytes\n", options.out_path.c_str(),
+                     options.layers, options.embd, vocab_size, out.size());
+    }
+    return ok;
+}
+
+bool parse_args(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        int number = std::atoi(value.c_str());
+        if (arg == "--out") {
+            options.out_path = value;
+        } else if (arg == "--seed") {
+            options.seed = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+        } else if (arg == "--layers") {
+            options.layers = number;
+        } else if (arg == "--embd") {
+            options.embd = number;
+        } else if (arg == "--heads") {
+            options.heads = number;
+        } else if (arg == "--kv-heads") {
+            options.kv_heads = number;
+        } else if (arg == "--ff") {
+            options.ff = number;
+        } else if (arg == "--vocab") {
+            options.vocab = number;
+        } else if (arg == "--ctx") {
+            options.ctx = number;
+        } else {
+            return false;
+        }
+    }
+    // Byte fallback alone takes 259 tokens
+    return !options.out_path.empty() && options.layers > 0 && options.heads > 0 && options.kv_heads > 0 &&
+           options.embd % options.heads == 0 && options.heads % options.kv_heads == 0 &&
+           options.ff > 0 && options.vocab >= 300 && options.ctx > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_args(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s --out FILE.gguf [--seed N] [--layers N] [--embd N] [--heads N] "
+                             "[--kv-heads N] [--ff N] [--vocab N>=300] [--ctx N]\n", argv[0]);
+        return 1;
+    }
+    if (!write_gguf(options)) {
+        std::fprintf(stderr, "failed to write %s\n", options.out_path.c_str());
+        return 1;
+    }
+    return 0;
+}
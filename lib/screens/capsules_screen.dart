@@ -1,6 +1,7 @@
 import 'package:flutter/material.dart';
 import 'package:http/http.dart' as http;
 import 'dart:io';
+import 'package:path/path.dart' as path;
 import '../services/capsule_search_service.dart';
 
 class Capsule {
@@ -140,7 +141,7 @@ class _CapsulesScreenState extends State<CapsulesScreen> {
         final file = File('${directory.path}/$fileName');
         await file.writeAsBytes(response.bodyBytes);
 
-        CapsuleSearchService().refresh();
+        await CapsuleSearchService().addCapsule(file.path);
 
         if (!mounted) return;
         ScaffoldMessenger.of(context).showSnackBar(
@@ -172,13 +173,13 @@ class _CapsulesScreenState extends State<CapsulesScreen> {
         for (final file in files) {
           if (file is File && file.path.contains('__${capsule.uid}__.json')) {
             await file.delete();
+            CapsuleSearchService()
+                .removeCapsule(path.basenameWithoutExtension(file.path));
             break;
           }
         }
       }
 
-      CapsuleSearchService().refresh();
-
       if (!mounted) return;
       ScaffoldMessenger.of(context).showSnackBar(
         SnackBar(
@@ -5,14 +5,18 @@ import 'dart:io';
 import 'package:path/path.dart' as path;
 import '../models/search_result.dart';
 import '../utils/constants.dart';
+import 'native_capsule_index.dart';
 
 class CapsuleSearchService {
   static const String _capsulesPath = 'capsules/';
   static const double _similarityThreshold =
       0.05; // Lower threshold for our approach
   static const int _maxResults = 5;
+  static const int _rerankCandidates = 12;
 
   final Map<String, List<Map<String, dynamic>>> _embeddingsCache = {};
+  final Map<String, String> _capsuleFilePaths = {};
+  final NativeCapsuleIndex _nativeIndex = NativeCapsuleIndex.instance;
   bool _isInitialized = false;
 
   static final CapsuleSearchService _instance =
@@ -24,10 +28,11 @@ class CapsuleSearchService {
     if (_isInitialized) return;
 
     try {
+      _nativeIndex.initialize();
       await _loadAllEmbeddings();
       _isInitialized = true;
       print(
-          'CapsuleSearchService initialized with ${_embeddingsCache.length} capsules');
+          'CapsuleSearchService initialized with ${_capsuleFilePaths.length} capsules');
     } catch (e) {
       print('Failed to initialize CapsuleSearchService: $e');
     }
@@ -42,7 +47,8 @@ class CapsuleSearchService {
         capsuleFiles = dir
             .listSync()
             .whereType<File>()
-            .where((f) => f.path.endsWith('.json'))
+            .where(
+                (f) => f.path.endsWith('.json') || f.path.endsWith('.ncap'))
             .map((f) => f.path)
             .toList();
         print(
@@ -67,6 +73,24 @@ class CapsuleSearchService {
 
   Future<void> _loadEmbeddingFile(String filePath, {bool isFile = true}) async {
     try {
+      final fileName = path.basenameWithoutExtension(filePath);
+
+      // Native ingestion cleans, filters and chunks off the UI thread
+      if (_nativeIndex.isAvailable) {
+        final passages = await _nativeIndex.addCapsuleFile(filePath);
+        if (passages >= 0) {
+          _capsuleFilePaths[fileName] = filePath;
+          print('Indexed $passages passages from: $fileName');
+          return;
+        }
+      }
+
+      // Compressed capsules can only be read natively
+      if (filePath.endsWith('.ncap')) {
+        print('Skipping compressed capsule without native index: $fileName');
+        return;
+      }
+
       final jsonContent = await File(filePath).readAsString();
       final Map<String, dynamic> data = json.decode(jsonContent);
 
@@ -78,7 +102,6 @@ class CapsuleSearchService {
         return;
       }
 
-      final fileName = path.basenameWithoutExtension(filePath);
       final processedEmbeddings = <Map<String, dynamic>>[];
 
       for (int i = 0; i < embeddings.length; i++) {
@@ -108,14 +131,30 @@ class CapsuleSearchService {
       }
 
       _embeddingsCache[fileName] = processedEmbeddings;
+      _capsuleFilePaths[fileName] = filePath;
+      _nativeIndex.addCapsule(
+        fileName,
+        processedEmbeddings.map((e) => e['content'] as String).toList(),
+        processedEmbeddings
+            .map((e) => e['metadata']['index'] as int)
+            .toList(),
+        processedEmbeddings
+            .map((e) => e['embedding'] as List<double>)
+            .toList(),
+      );
       print('Loaded ${processedEmbeddings.length} embeddings from: $fileName');
     } catch (e) {
       print('Error loading embedding file $filePath: $e');
     }
   }
 
+  /// Search installed capsules. Pass [capsules] to restrict the search to
+  /// specific capsule names (as listed by [getAvailableCapsules]). With
+  /// [rerank], the top candidates are re-scored by the loaded chat model.
   Future<CapsuleSearchResult> search(String query,
-      {int maxResults = _maxResults}) async {
+      {int maxResults = _maxResults,
+      List<String>? capsules,
+      bool rerank = false}) async {
     await initialize();
 
     if (query.trim().isEmpty) {
@@ -127,11 +166,44 @@ class CapsuleSearchService {
     }
 
     final queryEmbedding = await _generateQueryEmbedding(query);
+
+    final candidateCount =
+        rerank ? math.max(maxResults, _rerankCandidates) : maxResults;
+    final nativeResult = _nativeIndex
+        .search(query, queryEmbedding, candidateCount, capsules: capsules);
+    if (nativeResult != null) {
+      final hits = rerank
+          ? (await _rerankHits(query, nativeResult.hits))
+              .take(maxResults)
+              .toList()
+          : nativeResult.hits;
+      return CapsuleSearchResult(
+        results: hits
+            .map((hit) => SearchResult(
+                  content: hit.content,
+                  similarity: hit.score,
+                  source: hit.source,
+                  metadata: {
+                    'source': hit.source,
+                    'index': hit.sentenceIndex,
+                    'file_path': _capsuleFilePaths[hit.source],
+                    'semantic_score': hit.semanticScore,
+                    'keyword_score': hit.keywordScore,
+                    'combined_score': hit.score,
+                  },
+                ))
+            .toList(),
+        query: query,
+        totalResults: nativeResult.totalResults,
+      );
+    }
+
     final allResults = <SearchResult>[];
 
     // Search through all loaded capsules using hybrid approach
     for (final entry in _embeddingsCache.entries) {
       final capsuleName = entry.key;
+      if (capsules != null && !capsules.contains(capsuleName)) continue;
       final embeddings = entry.value;
 
       for (final item in embeddings) {
@@ -175,6 +247,22 @@ class CapsuleSearchService {
     );
   }
 
+  /// Reorder hits by model relevance; hits the model had no time for keep
+  /// their retrieval order after the scored ones
+  Future<List<NativeSearchHit>> _rerankHits(
+      String query, List<NativeSearchHit> hits) async {
+    final scores = await _nativeIndex.rerank(
+        query, hits.map((hit) => hit.content).toList());
+    if (scores == null || scores.isEmpty) return hits;
+
+    final scored = List.generate(scores.length, (i) => i)
+      ..sort((a, b) => scores[b].compareTo(scores[a]));
+    return [
+      ...scored.map((i) => hits[i]),
+      ...hits.skip(scores.length),
+    ];
+  }
+
   Future<List<double>> _generateQueryEmbedding(String query) async {
     // Simple approximation of query embedding using TF-IDF-like approach
     // In a production system, you'd use the same embedding model that was used for the documents
@@ -349,11 +437,29 @@ class CapsuleSearchService {
 
   void refresh() {
     _embeddingsCache.clear();
+    _capsuleFilePaths.clear();
+    _nativeIndex.clear();
     _isInitialized = false;
   }
 
+  /// Load a single newly installed capsule without reloading the others
+  Future<void> addCapsule(String filePath) async {
+    if (!_isInitialized) {
+      await initialize();
+      return;
+    }
+    await _loadEmbeddingFile(filePath, isFile: true);
+  }
+
+  /// Drop a single capsule; the native index tombstones its passages
+  void removeCapsule(String capsuleName) {
+    _embeddingsCache.remove(capsuleName);
+    _capsuleFilePaths.remove(capsuleName);
+    _nativeIndex.removeCapsule(capsuleName);
+  }
+
   // Get list of available capsule names
   List<String> getAvailableCapsules() {
-    return _embeddingsCache.keys.toList();
+    return _capsuleFilePaths.keys.toList();
   }
 }
@@ -4,7 +4,9 @@ import '../models/chat_message.dart';
 import '../models/ai_model.dart';
 import '../models/search_result.dart';
 import 'native_model_service.dart';
+import 'llama_service.dart';
 import 'capsule_search_service.dart';
+import 'native_capsule_index.dart';
 
 class ChatService {
   static final ChatService _instance = ChatService._internal();
@@ -282,6 +284,37 @@ class ChatService {
   /// Optimized response generation with semantic search integration
   Future<String> _generateOptimizedResponse(String userMessage) async {
     try {
+      // Step 0: Arithmetic is answered exactly and instantly, without
+      // spending decode steps on a model that may get it wrong. Only a
+      // message that asks for it is computed before routing
+      final mathAnswer = _nativeModelService.llamaService
+          .evaluateMath(userMessage, requireCue: true);
+      if (mathAnswer != null) {
+        print('🧮 Answered math question natively: $mathAnswer');
+        return mathAnswer;
+      }
+
+      // Step 0b: Ensure the model is loaded; routing embeds with it
+      if (!_modelPersistentlyLoaded) {
+        await _loadAndPersistModel();
+      }
+
+      // Step 0c: Route by intent; a greeting needs no retrieval or decoding
+      final intent =
+          await _nativeModelService.llamaService.classifyIntent(userMessage);
+      if (intent == PromptIntent.greeting) {
+        final curated =
+            _nativeModelService.llamaService.curatedResponse(userMessage);
+        if (curated != null) return curated;
+      } else if (intent == PromptIntent.math) {
+        final routedAnswer =
+            _nativeModelService.llamaService.evaluateMath(userMessage);
+        if (routedAnswer != null) {
+          print('🧮 Answered math question natively: $routedAnswer');
+          return routedAnswer;
+        }
+      }
+
       // Step 1: Search capsules for relevant knowledge FIRST
       print('🔍 Searching local knowledge capsules for: "$userMessage"');
       final capsuleResults =
@@ -323,9 +356,21 @@ class ChatService {
             '📊 Capsule results not highly relevant. HasResults: ${capsuleResults.hasResults}, HighlyRelevant: ${_hasHighlyRelevantResults(capsuleResults)}');
       }
 
-      // Step 2: Ensure model is loaded and ready
-      if (!_modelPersistentlyLoaded) {
-        await _loadAndPersistModel();
+      // Step 1b: Lookups and urgent questions are answered from retrieval
+      // or curated guidance when either covers them; only the rest decode
+      if (intent == PromptIntent.capsuleLookup ||
+          intent == PromptIntent.emergency ||
+          intent == PromptIntent.medical) {
+        if (capsuleResults.hasResults && _hasRelevantResults(capsuleResults)) {
+          print('🧭 ${intent!.name} prompt answered from retrieval');
+          return await _addEmergencyContextWithCapsules(
+              userMessage, capsuleResults);
+        }
+        if (intent != PromptIntent.capsuleLookup) {
+          final curated =
+              _nativeModelService.llamaService.curatedResponse(userMessage);
+          if (curated != null) return curated;
+        }
       }
 
       // Step 3: If we have relevant capsule data, enhance the prompt with context
@@ -410,6 +455,47 @@ class ChatService {
     // Start with optimized system prompt for small models
     String fullPrompt = assistantSystemPrompt + '\n\n';
 
+    // Add conversation history for context (last 2 messages max)
+    String history = '';
+    final session = _sessions.values.firstWhere(
+        (s) => s.messages.any((m) => m.content == userMessage),
+        orElse: () => ChatSession(
+            id: '',
+            createdAt: DateTime.now(),
+            lastActivity: DateTime.now(),
+            messages: []));
+
+    if (session.messages.length > 2) {
+      final recentMessages = session.messages.length > 4
+          ? session.messages.sublist(session.messages.length - 4)
+          : session.messages; // Last 2 exchanges
+      for (int i = 0; i < recentMessages.length - 1; i += 2) {
+        if (i + 1 < recentMessages.length) {
+          final userMsg = recentMessages[i];
+          final aiMsg = recentMessages[i + 1];
+          if (userMsg.type == MessageType.user &&
+              aiMsg.type == MessageType.assistant) {
+            history +=
+                'User: ${userMsg.content.length > 100 ? userMsg.content.substring(0, 100) + "..." : userMsg.content}\n';
+            history +=
+                'NaseerAI: ${aiMsg.content.length > 100 ? aiMsg.content.substring(0, 100) + "..." : aiMsg.content}\n\n';
+          }
+        }
+      }
+    }
+
+    final userTurn = 'User: $userMessage\n\nNaseerAI: ';
+
+    // Fill the remaining token budget natively when the model is loaded
+    final packed = _packCapsuleContext(
+        fullPrompt, history, userTurn, capsuleResults.results);
+    if (packed != null) {
+      if (packed.isNotEmpty) {
+        fullPrompt += 'CONTEXT: $packed\n\n';
+      }
+      return fullPrompt + history + userTurn;
+    }
+
     // Add capsule context if available - but keep it concise for small models
     if (capsuleResults.results.isNotEmpty) {
       final relevantInfo = <String>[];
@@ -439,40 +525,33 @@ class ChatService {
       }
     }
 
-    // Add conversation history for context (last 2 messages max)
-    final session = _sessions.values.firstWhere(
-        (s) => s.messages.any((m) => m.content == userMessage),
-        orElse: () => ChatSession(
-            id: '',
-            createdAt: DateTime.now(),
-            lastActivity: DateTime.now(),
-            messages: []));
-
-    if (session.messages.length > 2) {
-      final recentMessages = session.messages.length > 4
-          ? session.messages.sublist(session.messages.length - 4)
-          : session.messages; // Last 2 exchanges
-      for (int i = 0; i < recentMessages.length - 1; i += 2) {
-        if (i + 1 < recentMessages.length) {
-          final userMsg = recentMessages[i];
-          final aiMsg = recentMessages[i + 1];
-          if (userMsg.type == MessageType.user &&
-              aiMsg.type == MessageType.assistant) {
-            fullPrompt +=
-                'User: ${userMsg.content.length > 100 ? userMsg.content.substring(0, 100) + "..." : userMsg.content}\n';
-            fullPrompt +=
-                'NaseerAI: ${aiMsg.content.length > 100 ? aiMsg.content.substring(0, 100) + "..." : aiMsg.content}\n\n';
-          }
-        }
-      }
-    }
+    fullPrompt += history;
 
     // Add current user message with clear formatting
-    fullPrompt += 'User: $userMessage\n\nNaseerAI: ';
+    fullPrompt += userTurn;
 
     return fullPrompt;
   }
 
+  /// Pack relevant capsule passages by token budget; null when the native
+  /// packer is unavailable
+  String? _packCapsuleContext(String systemPrompt, String history,
+      String userTurn, List<SearchResult> results) {
+    final relevant = results.where((r) => r.similarity > 0.3).toList();
+    if (relevant.isEmpty) return null;
+
+    final nativeIndex = NativeCapsuleIndex.instance;
+    if (!nativeIndex.initialize()) return null;
+
+    return nativeIndex.packContext(
+      systemPrompt: systemPrompt,
+      history: history,
+      userMessage: userTurn,
+      passages: relevant.map((r) => _cleanTextContent(r.content)).toList(),
+      scores: relevant.map((r) => r.similarity).toList(),
+    );
+  }
+
   /// Load model once and keep it loaded for better performance
   Future<void> _loadAndPersistModel() async {
     try {
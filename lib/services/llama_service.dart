@@ -3,12 +3,15 @@ import 'dart:io';
 import 'dart:isolate';
 import 'dart:typed_data';
 import 'package:ffi/ffi.dart';
+import 'package:path_provider/path_provider.dart';
 import '../models/ai_model.dart';
 import 'model_manager.dart';
 import '../utils/device_info.dart';
 import '../utils/memory_monitor.dart';
 import '../utils/model_config_optimizer.dart';
 import '../utils/crash_recovery.dart';
+import '../utils/constants.dart';
+import 'native_diagnostics.dart';
 
 // C function signatures for llama.cpp integration
 typedef InitModelC = Int32 Function(Pointer<Utf8> modelPath);
@@ -40,6 +43,38 @@ typedef SetTopPDart = void Function(double topP);
 typedef CleanupModelC = Void Function();
 typedef CleanupModelDart = void Function();
 
+typedef LoadFallbackResponsesC = Int32 Function(Pointer<Utf8> path);
+typedef LoadFallbackResponsesDart = int Function(Pointer<Utf8> path);
+
+typedef EvaluateMathC = Pointer<Utf8> Function(
+    Pointer<Utf8> text, Int32 requireCue);
+typedef EvaluateMathDart = Pointer<Utf8> Function(
+    Pointer<Utf8> text, int requireCue);
+
+typedef CuratedResponseC = Pointer<Utf8> Function(Pointer<Utf8> prompt);
+typedef CuratedResponseDart = Pointer<Utf8> Function(Pointer<Utf8> prompt);
+
+typedef LoadIntentCentroidsC = Int32 Function(Pointer<Utf8> path);
+typedef LoadIntentCentroidsDart = int Function(Pointer<Utf8> path);
+
+typedef ResponseCacheOpenC = Int32 Function(Pointer<Utf8> path, Int64 maxBytes);
+typedef ResponseCacheOpenDart = int Function(Pointer<Utf8> path, int maxBytes);
+
+typedef ClassifyIntentC = Int32 Function(
+    Pointer<Utf8> text, Pointer<Float> similarity);
+typedef ClassifyIntentDart = int Function(
+    Pointer<Utf8> text, Pointer<Float> similarity);
+
+/// Prompt routes of the native intent classifier, in native id order
+enum PromptIntent {
+  emergency,
+  medical,
+  math,
+  greeting,
+  capsuleLookup,
+  openEnded,
+}
+
 class LlamaService {
   static LlamaService? _instance;
   static LlamaService get instance => _instance ??= LlamaService._();
@@ -61,6 +96,11 @@ class LlamaService {
   late SetTopKDart _setTopK;
   late SetTopPDart _setTopP;
   late CleanupModelDart _cleanupModel;
+  late LoadFallbackResponsesDart _loadFallbackResponses;
+  late EvaluateMathDart _evaluateMath;
+  late CuratedResponseDart _curatedResponse;
+  late LoadIntentCentroidsDart _loadIntentCentroids;
+  late ResponseCacheOpenDart _responseCacheOpen;
 
   /// Initialize the Llama service and load the native library
   Future<bool> initialize() async {
@@ -122,6 +162,16 @@ class LlamaService {
         _setTopP = _lib!.lookupFunction<SetTopPC, SetTopPDart>('set_top_p');
         _cleanupModel = _lib!
             .lookupFunction<CleanupModelC, CleanupModelDart>('cleanup_model');
+        _loadFallbackResponses = _lib!.lookupFunction<LoadFallbackResponsesC,
+            LoadFallbackResponsesDart>('load_fallback_responses');
+        _evaluateMath = _lib!
+            .lookupFunction<EvaluateMathC, EvaluateMathDart>('evaluate_math');
+        _curatedResponse = _lib!.lookupFunction<CuratedResponseC,
+            CuratedResponseDart>('curated_response');
+        _loadIntentCentroids = _lib!.lookupFunction<LoadIntentCentroidsC,
+            LoadIntentCentroidsDart>('load_intent_centroids');
+        _responseCacheOpen = _lib!.lookupFunction<ResponseCacheOpenC,
+            ResponseCacheOpenDart>('response_cache_open');
 
         _isInitialized = true;
         await CrashRecovery.clearRecoveryState(); // Clear any previous crash state
@@ -270,8 +320,13 @@ class LlamaService {
         // Convert path to C string
         pathPtr = modelPath.toNativeUtf8();
 
+        _applyFallbackResponses();
+        _applyIntentCentroids();
+        await _openResponseCache();
+
         print('🔄 Loading model into memory...');
         final result = _initModel(pathPtr!);
+        _printNativeLogs();
 
         if (result == 0) {
           _activeModel = AIModel(
@@ -402,9 +457,10 @@ class LlamaService {
         return "Please provide a question or prompt.";
       }
 
-      // Limit prompt length to prevent memory issues
-      final trimmedPrompt = prompt.length > 2048 
-          ? prompt.substring(0, 2048) + "..."
+      // Limit prompt length to prevent memory issues; packed capsule
+      // context is already bounded by the native token budget
+      final trimmedPrompt = prompt.length > 8192
+          ? prompt.substring(0, 8192) + "..."
           : prompt;
 
       // Adjust maxTokens based on available memory
@@ -455,6 +511,8 @@ class LlamaService {
           final finalResponse = _correctIdentityIssues(cleanedResponse);
           
           _memoryMonitor.logCurrentUsage('After inference');
+          _logInferenceMetrics();
+          _printNativeLogs();
           print('✅ Generated response (${finalResponse.length} chars)');
           return finalResponse;
           
@@ -520,6 +578,164 @@ class LlamaService {
     }
   }
 
+  /// Exact answer to a math question such as "what is 15% of 80?", computed
+  /// natively without the model; null when the message is not one. With
+  /// [requireCue], the message must also ask for arithmetic ("calculate",
+  /// "what is", "=", or an operator with spaces around it), so "24/7" or a
+  /// date is left to the model
+  String? evaluateMath(String text, {bool requireCue = false}) {
+    if (!_isInitialized) return null;
+    final textPtr = text.toNativeUtf8();
+    try {
+      final resultPtr = _evaluateMath(textPtr, requireCue ? 1 : 0);
+      if (resultPtr == nullptr) return null;
+      try {
+        return resultPtr.toDartString();
+      } finally {
+        _freeString(resultPtr);
+      }
+    } finally {
+      malloc.free(textPtr);
+    }
+  }
+
+  /// Answer from the offline response table (greetings, emergency
+  /// guidance), or null when no entry matches the prompt
+  String? curatedResponse(String text) {
+    if (!_isInitialized) return null;
+    final textPtr = text.toNativeUtf8();
+    try {
+      final resultPtr = _curatedResponse(textPtr);
+      if (resultPtr == nullptr) return null;
+      try {
+        return resultPtr.toDartString();
+      } finally {
+        _freeString(resultPtr);
+      }
+    } finally {
+      malloc.free(textPtr);
+    }
+  }
+
+  /// Nearest-centroid intent of a prompt over the loaded model's sentence
+  /// embeddings; null without a model or centroid file
+  Future<PromptIntent?> classifyIntent(String text) async {
+    if (!_isInitialized || !isModelLoaded) return null;
+    // Embedding the prompt is a full decode; keep it off the UI isolate
+    final intent = await Isolate.run(() => _classifyIntentInIsolate(text));
+    if (intent == null) return null;
+    return PromptIntent.values[intent];
+  }
+
+  static int? _classifyIntentInIsolate(String text) {
+    // Each isolate binds the library itself; the model is process-wide
+    final DynamicLibrary lib;
+    if (Platform.isAndroid || Platform.isLinux) {
+      lib = DynamicLibrary.open('libnaseer_model.so');
+    } else if (Platform.isWindows) {
+      lib = DynamicLibrary.open('naseer_model.dll');
+    } else {
+      return null;
+    }
+    final classify = lib.lookupFunction<ClassifyIntentC, ClassifyIntentDart>(
+        'classify_intent');
+
+    final textPtr = text.toNativeUtf8();
+    final similarityPtr = malloc<Float>();
+    try {
+      final intent = classify(textPtr, similarityPtr);
+      if (intent < 0 || intent >= PromptIntent.values.length) return null;
+      print('🧭 Intent ${PromptIntent.values[intent].name} '
+          '(similarity ${similarityPtr.value.toStringAsFixed(2)})');
+      return intent;
+    } finally {
+      malloc.free(textPtr);
+      malloc.free(similarityPtr);
+    }
+  }
+
+  /// Use the field-updatable offline answers when the device has them;
+  /// otherwise the native side keeps its built-in table
+  void _applyFallbackResponses() {
+    final file = File(AppConstants.fallbackResponsesPath);
+    if (!file.existsSync()) return;
+    final pathPtr = file.path.toNativeUtf8();
+    try {
+      final intents = _loadFallbackResponses(pathPtr);
+      if (intents < 0) {
+        print('⚠️ Invalid fallback responses in ${file.path}, keeping built-in ones');
+      } else {
+        print('📋 Loaded $intents fallback intents from ${file.path}');
+      }
+    } finally {
+      malloc.free(pathPtr);
+    }
+  }
+
+  /// Load the intent centroids built for the chat model, if present;
+  /// without them every prompt goes to generation
+  void _applyIntentCentroids() {
+    final file = File(AppConstants.intentCentroidsPath);
+    if (!file.existsSync()) return;
+    final pathPtr = file.path.toNativeUtf8();
+    try {
+      final centroids = _loadIntentCentroids(pathPtr);
+      if (centroids < 0) {
+        print('⚠️ Invalid intent centroids in ${file.path}, routing disabled');
+      } else {
+        print('🧭 Loaded $centroids intent centroids from ${file.path}');
+      }
+    } finally {
+      malloc.free(pathPtr);
+    }
+  }
+
+  /// Open the persistent answer cache in the app's private support
+  /// directory; entries are keyed by model and sampling settings, so
+  /// switching models never serves a stale answer
+  Future<void> _openResponseCache() async {
+    Pointer<Utf8>? pathPtr;
+    try {
+      final dir = await getApplicationSupportDirectory();
+      final file = File('${dir.path}/${AppConstants.responseCacheFileName}');
+      pathPtr = file.path.toNativeUtf8();
+      final entries =
+          _responseCacheOpen(pathPtr, AppConstants.responseCacheMaxBytes);
+      if (entries < 0) {
+        print('⚠️ Could not open response cache at ${file.path}');
+      } else {
+        print('💾 Response cache holds $entries answers');
+      }
+    } catch (e) {
+      print('⚠️ Response cache unavailable: $e');
+    } finally {
+      if (pathPtr != null) malloc.free(pathPtr);
+    }
+  }
+
+  /// Log the native timings of the request that just finished
+  void _logInferenceMetrics() {
+    final metrics = NativeDiagnostics.instance.lastMetrics(count: 1);
+    if (metrics.isEmpty) return;
+    final m = metrics.first;
+    if (m.stopReason == StopReason.cacheHit) {
+      print('⏱️ Answered from the response cache in ${m.totalMs.toStringAsFixed(1)}ms');
+      return;
+    }
+    print('⏱️ TTFT ${m.ttftMs.toStringAsFixed(0)}ms, '
+        'prefill ${m.prefillTokens} tokens in ${m.prefillMs.toStringAsFixed(0)}ms '
+        '(${m.reusedTokens} cached), '
+        'decode ${m.decodeTokensPerSec.toStringAsFixed(1)} tok/s, '
+        'stop: ${m.stopReason.name}');
+  }
+
+  /// Print what the native side logged since the last drain
+  void _printNativeLogs() {
+    for (final event in NativeDiagnostics.instance.drainLogs()) {
+      print('🧩 $event');
+    }
+  }
+
   /// Clean and improve response quality
   String _cleanAndImproveResponse(String rawResponse, String originalPrompt) {
     try {
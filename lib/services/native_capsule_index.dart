@@ -0,0 +1,488 @@
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:isolate';
+import 'package:ffi/ffi.dart';
+
+// C structures and function signatures for the native capsule index
+final class CapsuleSearchHitC extends Struct {
+  @Uint32()
+  external int passageId;
+
+  @Int32()
+  external int sentenceIndex;
+
+  @Float()
+  external double score;
+
+  @Float()
+  external double semanticScore;
+
+  @Float()
+  external double keywordScore;
+}
+
+typedef CapsuleIndexAddC = Int32 Function(
+    Pointer<Utf8> name,
+    Pointer<Pointer<Utf8>> sentences,
+    Pointer<Int32> sentenceIndices,
+    Pointer<Float> embeddings,
+    Int32 count,
+    Int32 dim);
+typedef CapsuleIndexAddDart = int Function(
+    Pointer<Utf8> name,
+    Pointer<Pointer<Utf8>> sentences,
+    Pointer<Int32> sentenceIndices,
+    Pointer<Float> embeddings,
+    int count,
+    int dim);
+
+typedef CapsuleIndexAddFileC = Int32 Function(
+    Pointer<Utf8> filePath, Int32 maxPassageTokens);
+typedef CapsuleIndexAddFileDart = int Function(
+    Pointer<Utf8> filePath, int maxPassageTokens);
+
+typedef CapsuleCompressFileC = Int64 Function(Pointer<Utf8> jsonPath,
+    Pointer<Utf8> archivePath, Int32 maxPassageTokens);
+typedef CapsuleCompressFileDart = int Function(
+    Pointer<Utf8> jsonPath, Pointer<Utf8> archivePath, int maxPassageTokens);
+
+typedef CapsuleIndexRemoveC = Int32 Function(Pointer<Utf8> name);
+typedef CapsuleIndexRemoveDart = int Function(Pointer<Utf8> name);
+
+typedef CapsuleIndexClearC = Void Function();
+typedef CapsuleIndexClearDart = void Function();
+
+typedef CapsuleIndexSearchC = Int32 Function(
+    Pointer<Utf8> query,
+    Pointer<Float> queryEmbedding,
+    Int32 dim,
+    Pointer<Pointer<Utf8>> capsules,
+    Int32 capsuleCount,
+    Pointer<CapsuleSearchHitC> hits,
+    Int32 maxResults,
+    Pointer<Int32> totalResults);
+typedef CapsuleIndexSearchDart = int Function(
+    Pointer<Utf8> query,
+    Pointer<Float> queryEmbedding,
+    int dim,
+    Pointer<Pointer<Utf8>> capsules,
+    int capsuleCount,
+    Pointer<CapsuleSearchHitC> hits,
+    int maxResults,
+    Pointer<Int32> totalResults);
+
+typedef CapsuleIndexPassageC = Pointer<Utf8> Function(Uint32 passageId);
+typedef CapsuleIndexPassageDart = Pointer<Utf8> Function(int passageId);
+
+typedef CapsuleIndexPassageRefsC = Int32 Function(
+    Uint32 passageId, Pointer<Int32> refs, Int32 maxRefs);
+typedef CapsuleIndexPassageRefsDart = int Function(
+    int passageId, Pointer<Int32> refs, int maxRefs);
+
+typedef RerankPassagesC = Int32 Function(Pointer<Utf8> query,
+    Pointer<Pointer<Utf8>> passages, Int32 count, Pointer<Float> scores,
+    Int32 timeBudgetMs);
+typedef RerankPassagesDart = int Function(Pointer<Utf8> query,
+    Pointer<Pointer<Utf8>> passages, int count, Pointer<Float> scores,
+    int timeBudgetMs);
+
+typedef PackContextC = Pointer<Utf8> Function(
+    Pointer<Utf8> systemPrompt,
+    Pointer<Utf8> history,
+    Pointer<Utf8> userMessage,
+    Pointer<Pointer<Utf8>> passages,
+    Pointer<Float> scores,
+    Int32 count,
+    Int32 reservedTokens,
+    Int32 dedupPolicy,
+    Pointer<Int32> tokensUsed);
+typedef PackContextDart = Pointer<Utf8> Function(
+    Pointer<Utf8> systemPrompt,
+    Pointer<Utf8> history,
+    Pointer<Utf8> userMessage,
+    Pointer<Pointer<Utf8>> passages,
+    Pointer<Float> scores,
+    int count,
+    int reservedTokens,
+    int dedupPolicy,
+    Pointer<Int32> tokensUsed);
+
+typedef FreeStringC = Void Function(Pointer<Utf8> str);
+typedef FreeStringDart = void Function(Pointer<Utf8> str);
+
+/// A single scored passage returned by the native index
+class NativeSearchHit {
+  final int passageId;
+  final int sentenceIndex;
+  final String content;
+  final String source;
+  final double score;
+  final double semanticScore;
+  final double keywordScore;
+
+  /// Source sentence indices this passage stands for; near-duplicate
+  /// sentences are collapsed into a single passage at ingest
+  final List<int> sourceRefs;
+
+  const NativeSearchHit({
+    required this.passageId,
+    required this.sentenceIndex,
+    required this.content,
+    required this.source,
+    required this.score,
+    required this.semanticScore,
+    required this.keywordScore,
+    this.sourceRefs = const [],
+  });
+}
+
+/// Dart binding for the segment-based capsule index in libnaseer_model.
+/// Each capsule is stored as its own segment, so adding or removing one
+/// capsule never touches the others.
+class NativeCapsuleIndex {
+  static NativeCapsuleIndex? _instance;
+  static NativeCapsuleIndex get instance =>
+      _instance ??= NativeCapsuleIndex._();
+  NativeCapsuleIndex._();
+
+  DynamicLibrary? _lib;
+  bool _isInitialized = false;
+  bool _isAvailable = false;
+
+  late CapsuleIndexAddDart _add;
+  late CapsuleIndexAddFileDart _addFile;
+  late CapsuleCompressFileDart _compressFile;
+  late CapsuleIndexRemoveDart _remove;
+  late CapsuleIndexClearDart _clear;
+  late CapsuleIndexSearchDart _search;
+  late CapsuleIndexPassageDart _passageText;
+  late CapsuleIndexPassageDart _passageSource;
+  late CapsuleIndexPassageRefsDart _passageRefs;
+  late RerankPassagesDart _rerank;
+  late PackContextDart _packContext;
+  late FreeStringDart _freeString;
+
+  bool get isAvailable => _isAvailable;
+
+  /// Load the native library; returns false if it is not available
+  bool initialize() {
+    if (_isInitialized) return _isAvailable;
+    _isInitialized = true;
+
+    try {
+      if (Platform.isAndroid || Platform.isLinux) {
+        _lib = DynamicLibrary.open('libnaseer_model.so');
+      } else if (Platform.isWindows) {
+        _lib = DynamicLibrary.open('naseer_model.dll');
+      } else {
+        return false;
+      }
+
+      _add = _lib!.lookupFunction<CapsuleIndexAddC, CapsuleIndexAddDart>(
+          'capsule_index_add');
+      _addFile = _lib!
+          .lookupFunction<CapsuleIndexAddFileC, CapsuleIndexAddFileDart>(
+              'capsule_index_add_file');
+      _compressFile = _lib!
+          .lookupFunction<CapsuleCompressFileC, CapsuleCompressFileDart>(
+              'capsule_compress_file');
+      _remove = _lib!
+          .lookupFunction<CapsuleIndexRemoveC, CapsuleIndexRemoveDart>(
+              'capsule_index_remove');
+      _clear = _lib!.lookupFunction<CapsuleIndexClearC, CapsuleIndexClearDart>(
+          'capsule_index_clear');
+      _search = _lib!
+          .lookupFunction<CapsuleIndexSearchC, CapsuleIndexSearchDart>(
+              'capsule_index_search_filtered');
+      _passageText = _lib!
+          .lookupFunction<CapsuleIndexPassageC, CapsuleIndexPassageDart>(
+              'capsule_index_passage_text');
+      _passageSource = _lib!
+          .lookupFunction<CapsuleIndexPassageC, CapsuleIndexPassageDart>(
+              'capsule_index_passage_source');
+      _passageRefs = _lib!.lookupFunction<CapsuleIndexPassageRefsC,
+          CapsuleIndexPassageRefsDart>('capsule_index_passage_refs');
+      _rerank = _lib!.lookupFunction<RerankPassagesC, RerankPassagesDart>(
+          'rerank_passages');
+      _packContext = _lib!.lookupFunction<PackContextC, PackContextDart>(
+          'pack_context');
+      _freeString =
+          _lib!.lookupFunction<FreeStringC, FreeStringDart>('free_string');
+
+      _isAvailable = true;
+      print('✅ Native capsule index available');
+    } catch (e) {
+      print('⚠️ Native capsule index unavailable, using Dart search: $e');
+      _isAvailable = false;
+    }
+    return _isAvailable;
+  }
+
+  /// Add or replace one capsule segment
+  bool addCapsule(String name, List<String> sentences,
+      List<int> sentenceIndices, List<List<double>> embeddings) {
+    if (!_isAvailable || sentences.length != embeddings.length) return false;
+
+    final count = sentences.length;
+    final dim = count > 0 ? embeddings.first.length : 0;
+    final namePtr = name.toNativeUtf8();
+    final sentencePtrs = calloc<Pointer<Utf8>>(count > 0 ? count : 1);
+    final indicesPtr = calloc<Int32>(count > 0 ? count : 1);
+    final embeddingsPtr = calloc<Float>(count * dim > 0 ? count * dim : 1);
+
+    try {
+      for (int i = 0; i < count; i++) {
+        sentencePtrs[i] = sentences[i].toNativeUtf8();
+        indicesPtr[i] = sentenceIndices[i];
+        final embedding = embeddings[i];
+        if (embedding.length != dim) return false;
+        for (int d = 0; d < dim; d++) {
+          embeddingsPtr[i * dim + d] = embedding[d];
+        }
+      }
+      return _add(namePtr, sentencePtrs, indicesPtr, embeddingsPtr, count,
+              dim > 0 ? dim : 1) ==
+          0;
+    } finally {
+      for (int i = 0; i < count; i++) {
+        if (sentencePtrs[i].address != 0) malloc.free(sentencePtrs[i]);
+      }
+      calloc.free(sentencePtrs);
+      calloc.free(indicesPtr);
+      calloc.free(embeddingsPtr);
+      malloc.free(namePtr);
+    }
+  }
+
+  /// Parse, clean and chunk a capsule JSON file (or open a compressed .ncap
+  /// archive) natively and add it as one segment. Runs on a background isolate so the UI thread never parses
+  /// capsule files. Returns the number of passages indexed, or -1.
+  Future<int> addCapsuleFile(String filePath,
+      {int maxPassageTokens = 0}) async {
+    if (!_isAvailable) return -1;
+    return Isolate.run(
+        () => _addCapsuleFileInIsolate(filePath, maxPassageTokens));
+  }
+
+  static int _addCapsuleFileInIsolate(String filePath, int maxPassageTokens) {
+    // Each isolate has its own binding; the index itself is process-wide
+    final index = NativeCapsuleIndex.instance;
+    if (!index.initialize()) return -1;
+
+    final pathPtr = filePath.toNativeUtf8();
+    try {
+      return index._addFile(pathPtr, maxPassageTokens);
+    } finally {
+      malloc.free(pathPtr);
+    }
+  }
+
+  /// Write a JSON capsule as a compressed .ncap archive for sharing.
+  /// Returns the archive size in bytes, or -1 on failure.
+  Future<int> compressCapsuleFile(String jsonPath, String archivePath,
+      {int maxPassageTokens = 0}) async {
+    if (!_isAvailable) return -1;
+    return Isolate.run(() =>
+        _compressCapsuleFileInIsolate(jsonPath, archivePath, maxPassageTokens));
+  }
+
+  static int _compressCapsuleFileInIsolate(
+      String jsonPath, String archivePath, int maxPassageTokens) {
+    final index = NativeCapsuleIndex.instance;
+    if (!index.initialize()) return -1;
+
+    final jsonPtr = jsonPath.toNativeUtf8();
+    final archivePtr = archivePath.toNativeUtf8();
+    try {
+      return index._compressFile(jsonPtr, archivePtr, maxPassageTokens);
+    } finally {
+      malloc.free(jsonPtr);
+      malloc.free(archivePtr);
+    }
+  }
+
+  /// Tombstone every passage of one capsule
+  bool removeCapsule(String name) {
+    if (!_isAvailable) return false;
+    final namePtr = name.toNativeUtf8();
+    try {
+      return _remove(namePtr) == 0;
+    } finally {
+      malloc.free(namePtr);
+    }
+  }
+
+  void clear() {
+    if (_isAvailable) _clear();
+  }
+
+  /// Hybrid semantic + keyword search; returns null if the call failed.
+  /// When [capsules] is given only those capsules are searched.
+  ({List<NativeSearchHit> hits, int totalResults})? search(
+      String query, List<double> queryEmbedding, int maxResults,
+      {List<String>? capsules}) {
+    if (!_isAvailable || maxResults <= 0) return null;
+
+    final queryPtr = query.toNativeUtf8();
+    final embeddingPtr = calloc<Float>(queryEmbedding.length);
+    final hitsPtr = calloc<CapsuleSearchHitC>(maxResults);
+    final totalPtr = calloc<Int32>();
+    final capsuleCount = capsules?.length ?? 0;
+    final capsulePtrs =
+        calloc<Pointer<Utf8>>(capsuleCount > 0 ? capsuleCount : 1);
+
+    try {
+      for (int i = 0; i < queryEmbedding.length; i++) {
+        embeddingPtr[i] = queryEmbedding[i];
+      }
+      for (int i = 0; i < capsuleCount; i++) {
+        capsulePtrs[i] = capsules![i].toNativeUtf8();
+      }
+      final count = _search(
+          queryPtr,
+          embeddingPtr,
+          queryEmbedding.length,
+          capsulePtrs,
+          capsules == null ? -1 : capsuleCount,
+          hitsPtr,
+          maxResults,
+          totalPtr);
+      if (count < 0) return null;
+
+      final hits = <NativeSearchHit>[];
+      for (int i = 0; i < count; i++) {
+        final hit = hitsPtr[i];
+        final content = _takeString(_passageText(hit.passageId));
+        final source = _takeString(_passageSource(hit.passageId));
+        if (content == null || source == null) continue;
+        hits.add(NativeSearchHit(
+          passageId: hit.passageId,
+          sentenceIndex: hit.sentenceIndex,
+          content: content,
+          source: source,
+          score: hit.score,
+          semanticScore: hit.semanticScore,
+          keywordScore: hit.keywordScore,
+          sourceRefs: _readRefs(hit.passageId),
+        ));
+      }
+      return (hits: hits, totalResults: totalPtr.value);
+    } finally {
+      for (int i = 0; i < capsuleCount; i++) {
+        if (capsulePtrs[i].address != 0) malloc.free(capsulePtrs[i]);
+      }
+      calloc.free(capsulePtrs);
+      malloc.free(queryPtr);
+      calloc.free(embeddingPtr);
+      calloc.free(hitsPtr);
+      calloc.free(totalPtr);
+    }
+  }
+
+  /// Score passages with the loaded chat model. Returns scores for the
+  /// leading passages that fit in [timeBudgetMs], or null if no model.
+  /// Runs on a background isolate so scoring never blocks UI frames.
+  Future<List<double>?> rerank(String query, List<String> passages,
+      {int timeBudgetMs = 1500}) async {
+    if (!_isAvailable || passages.isEmpty) return null;
+    return Isolate.run(() => _rerankInIsolate(query, passages, timeBudgetMs));
+  }
+
+  static List<double>? _rerankInIsolate(
+      String query, List<String> passages, int timeBudgetMs) {
+    final index = NativeCapsuleIndex.instance;
+    if (!index.initialize()) return null;
+
+    final queryPtr = query.toNativeUtf8();
+    final passagePtrs = calloc<Pointer<Utf8>>(passages.length);
+    final scoresPtr = calloc<Float>(passages.length);
+
+    try {
+      for (int i = 0; i < passages.length; i++) {
+        passagePtrs[i] = passages[i].toNativeUtf8();
+      }
+      final scored = index._rerank(
+          queryPtr, passagePtrs, passages.length, scoresPtr, timeBudgetMs);
+      if (scored < 0) return null;
+      return List<double>.generate(scored, (i) => scoresPtr[i]);
+    } finally {
+      for (int i = 0; i < passages.length; i++) {
+        if (passagePtrs[i].address != 0) malloc.free(passagePtrs[i]);
+      }
+      calloc.free(passagePtrs);
+      calloc.free(scoresPtr);
+      malloc.free(queryPtr);
+    }
+  }
+
+  /// Pack passages into the prompt's remaining token budget using the
+  /// loaded model's tokenizer. [dedupPolicy]: 0 none, 1 exact, 2 near.
+  /// Returns null when no model is loaded.
+  String? packContext(
+      {required String systemPrompt,
+      required String history,
+      required String userMessage,
+      required List<String> passages,
+      required List<double> scores,
+      int reservedTokens = 256,
+      int dedupPolicy = 2}) {
+    if (!_isAvailable || passages.isEmpty) return null;
+
+    final systemPtr = systemPrompt.toNativeUtf8();
+    final historyPtr = history.toNativeUtf8();
+    final userPtr = userMessage.toNativeUtf8();
+    final passagePtrs = calloc<Pointer<Utf8>>(passages.length);
+    final scoresPtr = calloc<Float>(passages.length);
+    final tokensUsedPtr = calloc<Int32>();
+
+    try {
+      for (int i = 0; i < passages.length; i++) {
+        passagePtrs[i] = passages[i].toNativeUtf8();
+        scoresPtr[i] = scores[i];
+      }
+      final packed = _takeString(_packContext(
+          systemPtr,
+          historyPtr,
+          userPtr,
+          passagePtrs,
+          scoresPtr,
+          passages.length,
+          reservedTokens,
+          dedupPolicy,
+          tokensUsedPtr));
+      if (packed != null) {
+        print('📦 Packed ${tokensUsedPtr.value} context tokens');
+      }
+      return packed;
+    } finally {
+      for (int i = 0; i < passages.length; i++) {
+        if (passagePtrs[i].address != 0) malloc.free(passagePtrs[i]);
+      }
+      calloc.free(passagePtrs);
+      calloc.free(scoresPtr);
+      calloc.free(tokensUsedPtr);
+      malloc.free(systemPtr);
+      malloc.free(historyPtr);
+      malloc.free(userPtr);
+    }
+  }
+
+  List<int> _readRefs(int passageId) {
+    final count = _passageRefs(passageId, nullptr, 0);
+    if (count <= 0) return const [];
+    final refsPtr = calloc<Int32>(count);
+    try {
+      _passageRefs(passageId, refsPtr, count);
+      return List<int>.generate(count, (i) => refsPtr[i]);
+    } finally {
+      calloc.free(refsPtr);
+    }
+  }
+
+  String? _takeString(Pointer<Utf8> ptr) {
+    if (ptr.address == 0) return null;
+    final value = ptr.toDartString();
+    _freeString(ptr);
+    return value;
+  }
+}
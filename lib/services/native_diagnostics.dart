@@ -0,0 +1,625 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:io';
+import 'package:ffi/ffi.dart';
+
+// C structures and function signatures for native inference diagnostics
+final class InferenceMetricsC extends Struct {
+  @Uint64()
+  external int requestId;
+
+  @Double()
+  external double tokenizeMs;
+
+  @Int32()
+  external int promptTokens;
+
+  @Int32()
+  external int reusedTokens;
+
+  @Int32()
+  external int prefillTokens;
+
+  @Double()
+  external double prefillMs;
+
+  @Double()
+  external double ttftMs;
+
+  @Int32()
+  external int generatedTokens;
+
+  @Double()
+  external double decodeMs;
+
+  @Double()
+  external double decodeTokensPerSec;
+
+  @Double()
+  external double sampleMs;
+
+  @Double()
+  external double totalMs;
+
+  @Int32()
+  external int stopReason;
+
+  @Int64()
+  external int prefillCycles;
+
+  @Int64()
+  external int prefillInstructions;
+
+  @Int64()
+  external int prefillCacheMisses;
+
+  @Int64()
+  external int prefillLlcLoads;
+
+  @Double()
+  external double prefillTaskClockMs;
+
+  @Int64()
+  external int decodeCycles;
+
+  @Int64()
+  external int decodeInstructions;
+
+  @Int64()
+  external int decodeCacheMisses;
+
+  @Int64()
+  external int decodeLlcLoads;
+
+  @Double()
+  external double decodeTaskClockMs;
+}
+
+final class MemoryStatsC extends Struct {
+  @Uint64()
+  external int modelFileBytes;
+
+  @Uint64()
+  external int modelResidentBytes;
+
+  @Uint64()
+  external int kvCacheBytes;
+
+  @Int32()
+  external int kvCellsUsed;
+
+  @Int32()
+  external int kvCellsTotal;
+
+  @Uint64()
+  external int computeBufferBytes;
+
+  @Uint64()
+  external int indexBytes;
+
+  @Uint64()
+  external int tokenizerBytes;
+
+  @Uint64()
+  external int rssBytes;
+
+  @Uint64()
+  external int peakRssBytes;
+}
+
+typedef GetMemoryStatsC = Int32 Function(Pointer<MemoryStatsC> stats);
+typedef GetMemoryStatsDart = int Function(Pointer<MemoryStatsC> stats);
+
+final class ResponseCacheStatsC extends Struct {
+  @Uint64()
+  external int hits;
+
+  @Uint64()
+  external int misses;
+
+  @Uint64()
+  external int entries;
+
+  @Uint64()
+  external int liveBytes;
+
+  @Uint64()
+  external int fileBytes;
+}
+
+typedef ResponseCacheGetStatsC = Int32 Function(
+    Pointer<ResponseCacheStatsC> stats);
+typedef ResponseCacheGetStatsDart = int Function(
+    Pointer<ResponseCacheStatsC> stats);
+
+typedef GetLastMetricsC = Int32 Function(
+    Pointer<InferenceMetricsC> records, Int32 maxRecords);
+typedef GetLastMetricsDart = int Function(
+    Pointer<InferenceMetricsC> records, int maxRecords);
+
+typedef GetLatencyHistogramC = Int32 Function(Int32 metric,
+    Pointer<Uint64> counts, Pointer<Double> upperBoundsMs, Int32 maxBuckets);
+typedef GetLatencyHistogramDart = int Function(int metric,
+    Pointer<Uint64> counts, Pointer<Double> upperBoundsMs, int maxBuckets);
+
+typedef ResetMetricsC = Void Function();
+typedef ResetMetricsDart = void Function();
+
+typedef PerfCountersSetEnabledC = Int32 Function(Int32 enabled);
+typedef PerfCountersSetEnabledDart = int Function(int enabled);
+
+typedef TraceSetEnabledC = Void Function(Int32 enabled);
+typedef TraceSetEnabledDart = void Function(int enabled);
+
+typedef TraceClearC = Void Function();
+typedef TraceClearDart = void Function();
+
+typedef TraceDumpToFileC = Int32 Function(Pointer<Utf8> path);
+typedef TraceDumpToFileDart = int Function(Pointer<Utf8> path);
+
+typedef LogSetLevelC = Void Function(Int32 level);
+typedef LogSetLevelDart = void Function(int level);
+
+typedef LogSetLogcatC = Void Function(Int32 enabled);
+typedef LogSetLogcatDart = void Function(int enabled);
+
+typedef LogDrainJsonC = Pointer<Utf8> Function(Int32 maxEvents);
+typedef LogDrainJsonDart = Pointer<Utf8> Function(int maxEvents);
+
+typedef FreeStringC = Void Function(Pointer<Utf8> str);
+typedef FreeStringDart = void Function(Pointer<Utf8> str);
+
+enum StopReason { none, endOfSequence, maxTokens, contextFull, decodeError, cacheHit }
+
+enum LatencyMetric { timeToFirstToken, prefill, decodePerToken, total }
+
+enum NativeLogLevel { debug, info, warn, error, off }
+
+/// One event from the native log ring
+class NativeLogEvent {
+  final int sequence;
+  final DateTime time;
+  final NativeLogLevel level;
+  final int threadId;
+  final String tag;
+  final String message;
+
+  const NativeLogEvent({
+    required this.sequence,
+    required this.time,
+    required this.level,
+    required this.threadId,
+    required this.tag,
+    required this.message,
+  });
+
+  factory NativeLogEvent.fromJson(Map<String, dynamic> json) => NativeLogEvent(
+        sequence: json['seq'] as int,
+        time: DateTime.fromMillisecondsSinceEpoch(json['time_ms'] as int),
+        level: NativeLogLevel.values.firstWhere(
+            (l) => l.name == json['level'],
+            orElse: () => NativeLogLevel.info),
+        threadId: json['tid'] as int,
+        tag: json['tag'] as String,
+        message: json['message'] as String,
+      );
+
+  Map<String, dynamic> toJson() => {
+        'seq': sequence,
+        'time_ms': time.millisecondsSinceEpoch,
+        'level': level.name,
+        'tid': threadId,
+        'tag': tag,
+        'message': message,
+      };
+
+  @override
+  String toString() => '[${level.name}] $tag: $message';
+}
+
+/// Hardware counters of one phase, summed over all native threads.
+/// A counter the device does not provide is -1.
+class PhaseCounters {
+  final int cycles;
+  final int instructions;
+  final int cacheMisses;
+  final int llcLoads;
+  final double taskClockMs;
+
+  const PhaseCounters({
+    required this.cycles,
+    required this.instructions,
+    required this.cacheMisses,
+    required this.llcLoads,
+    required this.taskClockMs,
+  });
+
+  bool get isRecorded => taskClockMs >= 0 || cycles >= 0;
+
+  /// Instructions per cycle; low values on a busy core point at memory stalls
+  double? get ipc =>
+      cycles > 0 && instructions >= 0 ? instructions / cycles : null;
+
+  Map<String, dynamic> toJson() => {
+        'cycles': cycles,
+        'instructions': instructions,
+        'cache_misses': cacheMisses,
+        'llc_loads': llcLoads,
+        'task_clock_ms': taskClockMs,
+      };
+}
+
+/// Timings of one native generation request
+class InferenceMetrics {
+  final int requestId;
+  final double tokenizeMs;
+  final int promptTokens;
+  final int reusedTokens;
+  final int prefillTokens;
+  final double prefillMs;
+  final double ttftMs;
+  final int generatedTokens;
+  final double decodeMs;
+  final double decodeTokensPerSec;
+  final double sampleMs;
+  final double totalMs;
+  final StopReason stopReason;
+  final PhaseCounters prefillCounters;
+  final PhaseCounters decodeCounters;
+
+  const InferenceMetrics({
+    required this.requestId,
+    required this.tokenizeMs,
+    required this.promptTokens,
+    required this.reusedTokens,
+    required this.prefillTokens,
+    required this.prefillMs,
+    required this.ttftMs,
+    required this.generatedTokens,
+    required this.decodeMs,
+    required this.decodeTokensPerSec,
+    required this.sampleMs,
+    required this.totalMs,
+    required this.stopReason,
+    required this.prefillCounters,
+    required this.decodeCounters,
+  });
+
+  Map<String, dynamic> toJson() => {
+        'request_id': requestId,
+        'tokenize_ms': tokenizeMs,
+        'prompt_tokens': promptTokens,
+        'reused_tokens': reusedTokens,
+        'prefill_tokens': prefillTokens,
+        'prefill_ms': prefillMs,
+        'ttft_ms': ttftMs,
+        'generated_tokens': generatedTokens,
+        'decode_ms': decodeMs,
+        'decode_tokens_per_sec': decodeTokensPerSec,
+        'sample_ms': sampleMs,
+        'total_ms': totalMs,
+        'stop_reason': stopReason.name,
+        if (prefillCounters.isRecorded)
+          'prefill_counters': prefillCounters.toJson(),
+        if (decodeCounters.isRecorded)
+          'decode_counters': decodeCounters.toJson(),
+      };
+}
+
+/// Native memory broken down by owner, in bytes
+class NativeMemoryStats {
+  final int modelFileBytes;
+  final int modelResidentBytes;
+  final int kvCacheBytes;
+  final int kvCellsUsed;
+  final int kvCellsTotal;
+  final int computeBufferBytes;
+  final int indexBytes;
+  final int tokenizerBytes;
+  final int rssBytes;
+  final int peakRssBytes;
+
+  const NativeMemoryStats({
+    required this.modelFileBytes,
+    required this.modelResidentBytes,
+    required this.kvCacheBytes,
+    required this.kvCellsUsed,
+    required this.kvCellsTotal,
+    required this.computeBufferBytes,
+    required this.indexBytes,
+    required this.tokenizerBytes,
+    required this.rssBytes,
+    required this.peakRssBytes,
+  });
+
+  Map<String, dynamic> toJson() => {
+        'model_file_bytes': modelFileBytes,
+        'model_resident_bytes': modelResidentBytes,
+        'kv_cache_bytes': kvCacheBytes,
+        'kv_cells_used': kvCellsUsed,
+        'kv_cells_total': kvCellsTotal,
+        'compute_buffer_bytes': computeBufferBytes,
+        'index_bytes': indexBytes,
+        'tokenizer_bytes': tokenizerBytes,
+        'rss_bytes': rssBytes,
+        'peak_rss_bytes': peakRssBytes,
+      };
+}
+
+/// Persistent response cache counters; hits and misses count since launch
+class ResponseCacheStats {
+  final int hits;
+  final int misses;
+  final int entries;
+  final int liveBytes;
+  final int fileBytes;
+
+  const ResponseCacheStats({
+    required this.hits,
+    required this.misses,
+    required this.entries,
+    required this.liveBytes,
+    required this.fileBytes,
+  });
+
+  Map<String, dynamic> toJson() => {
+        'hits': hits,
+        'misses': misses,
+        'entries': entries,
+        'live_bytes': liveBytes,
+        'file_bytes': fileBytes,
+      };
+}
+
+/// One histogram bucket: requests at or below [upperBoundMs]
+class LatencyBucket {
+  final double upperBoundMs;
+  final int count;
+
+  const LatencyBucket(this.upperBoundMs, this.count);
+}
+
+/// Dart binding for the diagnostics exported by libnaseer_model
+class NativeDiagnostics {
+  static NativeDiagnostics? _instance;
+  static NativeDiagnostics get instance =>
+      _instance ??= NativeDiagnostics._();
+  NativeDiagnostics._();
+
+  static const int _maxBuckets = 32;
+
+  DynamicLibrary? _lib;
+  bool _isInitialized = false;
+  bool _isAvailable = false;
+
+  late GetLastMetricsDart _getLastMetrics;
+  late GetLatencyHistogramDart _getLatencyHistogram;
+  late ResetMetricsDart _resetMetrics;
+  late GetMemoryStatsDart _getMemoryStats;
+  late ResponseCacheGetStatsDart _responseCacheGetStats;
+  late PerfCountersSetEnabledDart _perfCountersSetEnabled;
+  late TraceSetEnabledDart _traceSetEnabled;
+  late TraceClearDart _traceClear;
+  late TraceDumpToFileDart _traceDumpToFile;
+  late LogSetLevelDart _logSetLevel;
+  late LogSetLogcatDart _logSetLogcat;
+  late LogDrainJsonDart _logDrainJson;
+  late FreeStringDart _freeString;
+
+  bool get isAvailable => _isAvailable;
+
+  /// Load the native library; returns false if it is not available
+  bool initialize() {
+    if (_isInitialized) return _isAvailable;
+    _isInitialized = true;
+
+    try {
+      if (Platform.isAndroid || Platform.isLinux) {
+        _lib = DynamicLibrary.open('libnaseer_model.so');
+      } else if (Platform.isWindows) {
+        _lib = DynamicLibrary.open('naseer_model.dll');
+      } else {
+        return false;
+      }
+
+      _getLastMetrics = _lib!.lookupFunction<GetLastMetricsC,
+          GetLastMetricsDart>('get_last_metrics');
+      _getLatencyHistogram = _lib!.lookupFunction<GetLatencyHistogramC,
+          GetLatencyHistogramDart>('get_latency_histogram');
+      _resetMetrics =
+          _lib!.lookupFunction<ResetMetricsC, ResetMetricsDart>('reset_metrics');
+      _getMemoryStats = _lib!.lookupFunction<GetMemoryStatsC,
+          GetMemoryStatsDart>('get_memory_stats');
+      _responseCacheGetStats = _lib!.lookupFunction<ResponseCacheGetStatsC,
+          ResponseCacheGetStatsDart>('response_cache_get_stats');
+      _perfCountersSetEnabled = _lib!.lookupFunction<PerfCountersSetEnabledC,
+          PerfCountersSetEnabledDart>('perf_counters_set_enabled');
+      _traceSetEnabled = _lib!.lookupFunction<TraceSetEnabledC,
+          TraceSetEnabledDart>('trace_set_enabled');
+      _traceClear =
+          _lib!.lookupFunction<TraceClearC, TraceClearDart>('trace_clear');
+      _traceDumpToFile = _lib!.lookupFunction<TraceDumpToFileC,
+          TraceDumpToFileDart>('trace_dump_to_file');
+      _logSetLevel =
+          _lib!.lookupFunction<LogSetLevelC, LogSetLevelDart>('log_set_level');
+      _logSetLogcat = _lib!
+          .lookupFunction<LogSetLogcatC, LogSetLogcatDart>('log_set_logcat');
+      _logDrainJson = _lib!
+          .lookupFunction<LogDrainJsonC, LogDrainJsonDart>('log_drain_json');
+      _freeString =
+          _lib!.lookupFunction<FreeStringC, FreeStringDart>('free_string');
+
+      _isAvailable = true;
+    } catch (e) {
+      print('⚠️ Native diagnostics unavailable: $e');
+      _isAvailable = false;
+    }
+    return _isAvailable;
+  }
+
+  /// The most recent generation requests, newest first
+  List<InferenceMetrics> lastMetrics({int count = 16}) {
+    if (!initialize() || count <= 0) return const [];
+
+    final records = calloc<InferenceMetricsC>(count);
+    try {
+      final written = _getLastMetrics(records, count);
+      return List<InferenceMetrics>.generate(written, (i) {
+        final r = records[i];
+        return InferenceMetrics(
+          requestId: r.requestId,
+          tokenizeMs: r.tokenizeMs,
+          promptTokens: r.promptTokens,
+          reusedTokens: r.reusedTokens,
+          prefillTokens: r.prefillTokens,
+          prefillMs: r.prefillMs,
+          ttftMs: r.ttftMs,
+          generatedTokens: r.generatedTokens,
+          decodeMs: r.decodeMs,
+          decodeTokensPerSec: r.decodeTokensPerSec,
+          sampleMs: r.sampleMs,
+          totalMs: r.totalMs,
+          stopReason: r.stopReason >= 0 && r.stopReason < StopReason.values.length
+              ? StopReason.values[r.stopReason]
+              : StopReason.none,
+          prefillCounters: PhaseCounters(
+            cycles: r.prefillCycles,
+            instructions: r.prefillInstructions,
+            cacheMisses: r.prefillCacheMisses,
+            llcLoads: r.prefillLlcLoads,
+            taskClockMs: r.prefillTaskClockMs,
+          ),
+          decodeCounters: PhaseCounters(
+            cycles: r.decodeCycles,
+            instructions: r.decodeInstructions,
+            cacheMisses: r.decodeCacheMisses,
+            llcLoads: r.decodeLlcLoads,
+            taskClockMs: r.decodeTaskClockMs,
+          ),
+        );
+      });
+    } finally {
+      calloc.free(records);
+    }
+  }
+
+  /// Log-scale latency histogram over every request since the last reset
+  List<LatencyBucket> latencyHistogram(LatencyMetric metric) {
+    if (!initialize()) return const [];
+
+    final counts = calloc<Uint64>(_maxBuckets);
+    final bounds = calloc<Double>(_maxBuckets);
+    try {
+      final buckets =
+          _getLatencyHistogram(metric.index, counts, bounds, _maxBuckets);
+      if (buckets < 0) return const [];
+      return List<LatencyBucket>.generate(
+          buckets, (i) => LatencyBucket(bounds[i], counts[i]));
+    } finally {
+      calloc.free(counts);
+      calloc.free(bounds);
+    }
+  }
+
+  void resetMetrics() {
+    if (initialize()) _resetMetrics();
+  }
+
+  /// Record hardware counters around prefill and decode; returns whether
+  /// the device allows it
+  bool setPerfCountersEnabled(bool enabled) {
+    if (!initialize()) return false;
+    return _perfCountersSetEnabled(enabled ? 1 : 0) == 1;
+  }
+
+  /// Current native memory breakdown, or null without the native library
+  NativeMemoryStats? memoryStats() {
+    if (!initialize()) return null;
+
+    final stats = calloc<MemoryStatsC>();
+    try {
+      if (_getMemoryStats(stats) != 0) return null;
+      final s = stats.ref;
+      return NativeMemoryStats(
+        modelFileBytes: s.modelFileBytes,
+        modelResidentBytes: s.modelResidentBytes,
+        kvCacheBytes: s.kvCacheBytes,
+        kvCellsUsed: s.kvCellsUsed,
+        kvCellsTotal: s.kvCellsTotal,
+        computeBufferBytes: s.computeBufferBytes,
+        indexBytes: s.indexBytes,
+        tokenizerBytes: s.tokenizerBytes,
+        rssBytes: s.rssBytes,
+        peakRssBytes: s.peakRssBytes,
+      );
+    } finally {
+      calloc.free(stats);
+    }
+  }
+
+  /// Response cache counters, or null without the native library
+  ResponseCacheStats? responseCacheStats() {
+    if (!initialize()) return null;
+
+    final stats = calloc<ResponseCacheStatsC>();
+    try {
+      if (_responseCacheGetStats(stats) != 0) return null;
+      final s = stats.ref;
+      return ResponseCacheStats(
+        hits: s.hits,
+        misses: s.misses,
+        entries: s.entries,
+        liveBytes: s.liveBytes,
+        fileBytes: s.fileBytes,
+      );
+    } finally {
+      calloc.free(stats);
+    }
+  }
+
+  /// Start or stop recording native trace spans
+  void setTracingEnabled(bool enabled) {
+    if (initialize()) _traceSetEnabled(enabled ? 1 : 0);
+  }
+
+  void clearTrace() {
+    if (initialize()) _traceClear();
+  }
+
+  /// Write recorded spans as Chrome trace JSON, viewable in Perfetto
+  bool dumpTrace(String path) {
+    if (!initialize()) return false;
+    final pathPtr = path.toNativeUtf8();
+    try {
+      return _traceDumpToFile(pathPtr) == 0;
+    } finally {
+      malloc.free(pathPtr);
+    }
+  }
+
+  /// Lowest level kept in the native log ring (info by default)
+  void setLogLevel(NativeLogLevel level) {
+    if (initialize()) _logSetLevel(level.index);
+  }
+
+  /// Mirror native log events to logcat as they are written
+  void setLogcatForwarding(bool enabled) {
+    if (initialize()) _logSetLogcat(enabled ? 1 : 0);
+  }
+
+  /// Remove and return the pending native log events, oldest first
+  List<NativeLogEvent> drainLogs({int maxEvents = 512}) {
+    if (!initialize()) return const [];
+
+    final jsonPtr = _logDrainJson(maxEvents);
+    if (jsonPtr == nullptr) return const [];
+    try {
+      final decoded = jsonDecode(jsonPtr.toDartString()) as Map<String, dynamic>;
+      return (decoded['events'] as List)
+          .map((e) => NativeLogEvent.fromJson(e as Map<String, dynamic>))
+          .toList();
+    } finally {
+      _freeString(jsonPtr);
+    }
+  }
+}
@@ -76,6 +76,18 @@ class AppConstants {
   static const String chatModelDir =
       '/storage/emulated/0/naseerai/models/chat/';
   static const String capsulesDir = '/storage/emulated/0/naseerai/capsules';
+  // Offline answers used without a model; see sample_fallback/
+  static const String fallbackResponsesPath =
+      '/storage/emulated/0/naseerai/fallback_responses.json';
+  // Intent centroids for the chat model; built by tools/intent_centroids
+  // from sample_intents/
+  static const String intentCentroidsPath =
+      '/storage/emulated/0/naseerai/intent_centroids.bin';
+  // Answers to repeated prompts, kept across restarts in the app's private
+  // support directory; they can hold medical answers, so never on shared
+  // storage
+  static const String responseCacheFileName = 'response_cache.log';
+  static const int responseCacheMaxBytes = 4 * 1024 * 1024;
 
   // Additional constants for model management
   static const String defaultModelFileName = chatModelName;
@@ -1,5 +1,6 @@
 import 'dart:async';
 import 'dart:io';
+import '../services/native_diagnostics.dart';
 
 /// Memory monitoring utility for tracking memory usage during model operations
 class MemoryMonitor {
@@ -40,10 +41,13 @@ class MemoryMonitor {
     if (!_isMonitoring) return;
     
     try {
+      final native = NativeDiagnostics.instance.memoryStats();
       final snapshot = MemorySnapshot(
         timestamp: DateTime.now(),
         label: label,
-        memoryUsageMB: _getCurrentMemoryUsage(),
+        memoryUsageMB:
+            native != null ? _toMB(native.rssBytes) : _getCurrentMemoryUsage(),
+        native: native,
       );
       
       _snapshots.add(snapshot);
@@ -61,8 +65,12 @@ class MemoryMonitor {
     }
   }
 
+  static int _toMB(int bytes) => (bytes / (1024 * 1024)).round();
+
   /// Get current memory usage in MB
   int _getCurrentMemoryUsage() {
+    final native = NativeDiagnostics.instance.memoryStats();
+    if (native != null) return _toMB(native.rssBytes);
     try {
       if (Platform.isAndroid || Platform.isLinux) {
         return _getLinuxProcessMemory();
@@ -74,7 +82,7 @@ class MemoryMonitor {
     }
   }
 
-  /// Get process memory usage on Linux/Android
+  /// Get process memory usage on Linux/Android without the native library
   int _getLinuxProcessMemory() {
     try {
       final currentPid = Platform.isAndroid ? 'self' : 'self';
@@ -119,8 +127,19 @@ class MemoryMonitor {
 
   /// Log current memory usage with optional label
   void logCurrentUsage(String label) {
-    final currentUsage = _getCurrentMemoryUsage();
-    print('📊 Memory usage ($label): ${currentUsage}MB');
+    final native = NativeDiagnostics.instance.memoryStats();
+    if (native != null) {
+      print('📊 Memory usage ($label): ${_toMB(native.rssBytes)}MB '
+          '(peak ${_toMB(native.peakRssBytes)}MB) | '
+          'weights ${_toMB(native.modelResidentBytes)}/${_toMB(native.modelFileBytes)}MB resident, '
+          'KV ${_toMB(native.kvCacheBytes)}MB '
+          '(${native.kvCellsUsed}/${native.kvCellsTotal} cells), '
+          'compute ${_toMB(native.computeBufferBytes)}MB, '
+          'index ${_toMB(native.indexBytes)}MB, '
+          'tokenizer ${_toMB(native.tokenizerBytes)}MB');
+    } else {
+      print('📊 Memory usage ($label): ${_getCurrentMemoryUsage()}MB');
+    }
     
     if (_isMonitoring) {
       _takeSnapshot(label);
@@ -134,6 +153,10 @@ class MemoryMonitor {
     print('📊 Memory Monitoring Summary:');
     print('   Total snapshots: ${_snapshots.length}');
     print('   Peak memory usage: ${_maxMemoryUsageMB}MB');
+    final nativePeak = _snapshots.last.native?.peakRssBytes;
+    if (nativePeak != null) {
+      print('   Process peak RSS: ${_toMB(nativePeak)}MB');
+    }
     
     if (_snapshots.length >= 2) {
       final first = _snapshots.first;
@@ -159,6 +182,7 @@ class MemoryMonitor {
       'currentUsageMB': _getCurrentMemoryUsage(),
       'maxUsageMB': _maxMemoryUsageMB,
       'snapshotCount': _snapshots.length,
+      'native': NativeDiagnostics.instance.memoryStats()?.toJson(),
     };
   }
 
@@ -174,11 +198,13 @@ class MemorySnapshot {
   final DateTime timestamp;
   final String? label;
   final int memoryUsageMB;
+  final NativeMemoryStats? native;
 
   MemorySnapshot({
     required this.timestamp,
     this.label,
     required this.memoryUsageMB,
+    this.native,
   });
 
   @override